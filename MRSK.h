@@ -4,7 +4,17 @@
 
 typedef struct MRSK_Interpreter_tag MRSK_Interpreter;
 
+typedef enum {
+    MRSK_BYTECODE_MODE = 1,
+    MRSK_AST_MODE
+} MRSK_ExecuteMode;
+
 MRSK_Interpreter *MRSK_create_interpreter(void);
+void MRSK_set_execute_mode(MRSK_Interpreter *interpreter,
+                           MRSK_ExecuteMode mode);
+void MRSK_set_dump_tree(MRSK_Interpreter *interpreter, FILE *fp);
+void MRSK_set_gc_stat(MRSK_Interpreter *interpreter, FILE *fp);
+void MRSK_set_gc_slice_work(MRSK_Interpreter *interpreter, int work);
 void MRSK_compile(MRSK_Interpreter *interpreter, FILE *fp);
 void MRSK_interpret(MRSK_Interpreter *interpreter);
 void MRSK_dispose_interpreter(MRSK_Interpreter *interpreter);
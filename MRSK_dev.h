@@ -23,7 +23,9 @@ typedef enum {
     MRSK_STRING_VALUE,
     MRSK_NATIVE_POINTER_VALUE,
     MRSK_NONE_VALUE,
-    MRSK_ARRAY_VALUE
+    MRSK_ARRAY_VALUE,
+    MRSK_MAP_VALUE,
+    MRSK_RECORD_VALUE
 } MRSK_ValueType;
 
 typedef struct {
@@ -46,8 +48,18 @@ typedef MRSK_Value MRSK_NativeFunctionProc(MRSK_Interpreter *interpreter,
                                            MRSK_LocalEnvironment *env,
                                            int arg_count, MRSK_Value *args);
 
+typedef MRSK_Value MRSK_MethodProc(MRSK_Interpreter *interpreter,
+                                   MRSK_LocalEnvironment *env,
+                                   MRSK_Value *receiver,
+                                   int arg_count, MRSK_Value *args,
+                                   int line_number);
+
 void MRSK_add_nativefunction(MRSK_Interpreter *interpreter,
                              char *name, MRSK_NativeFunctionProc *proc);
+/* arg_count < 0 means the method checks its arguments by itself. */
+void MRSK_add_method(MRSK_Interpreter *interpreter,
+                     MRSK_ValueType receiver_type, char *name,
+                     int arg_count, MRSK_MethodProc *proc);
 void MRSK_add_global_variable(MRSK_Interpreter *inter,
                               char *identifier, MRSK_Value *value);
 MRSK_Object * MRSK_create_murasaki_string(MRSK_Interpreter *inter,
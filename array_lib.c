@@ -0,0 +1,1330 @@
+#include <string.h>
+#include "DBG.h"
+#include "MRSK_dev.h"
+#include "murasaki.h"
+
+/*
+ * Bulk operations over whole arrays.  On an int_array or double_array
+ * the loops run over the packed storage, a vector of elements at a time
+ * when the compiler targets SSE2 or AVX2 (build with -mavx2 for the
+ * wider one), with a scalar loop for the tail.  Other arrays, and
+ * targets without either, take the scalar path.
+ */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_ENABLED
+#define INT_LANES       (8)
+#define DOUBLE_LANES    (4)
+typedef __m256i IntVector;
+typedef __m256d DoubleVector;
+#define iv_load(p)          _mm256_loadu_si256((__m256i*)(p))
+#define iv_store(p, v)      _mm256_storeu_si256((__m256i*)(p), (v))
+#define iv_set1(x)          _mm256_set1_epi32(x)
+#define iv_add(a, b)        _mm256_add_epi32((a), (b))
+#define iv_sub(a, b)        _mm256_sub_epi32((a), (b))
+#define iv_mul(a, b)        _mm256_mullo_epi32((a), (b))
+#define iv_min(a, b)        _mm256_min_epi32((a), (b))
+#define iv_max(a, b)        _mm256_max_epi32((a), (b))
+#define iv_cmpeq(a, b)      _mm256_cmpeq_epi32((a), (b))
+#define iv_any(v)           (_mm256_movemask_epi8(v) != 0)
+#define dv_load(p)          _mm256_loadu_pd(p)
+#define dv_store(p, v)      _mm256_storeu_pd((p), (v))
+#define dv_set1(x)          _mm256_set1_pd(x)
+#define dv_add(a, b)        _mm256_add_pd((a), (b))
+#define dv_mul(a, b)        _mm256_mul_pd((a), (b))
+#define dv_min(a, b)        _mm256_min_pd((a), (b))
+#define dv_max(a, b)        _mm256_max_pd((a), (b))
+#define dv_eq_mask(a, b)    _mm256_movemask_pd(_mm256_cmp_pd((a), (b), \
+                                                             _CMP_EQ_OQ))
+#define IV_MUL_ENABLED
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_ENABLED
+#define INT_LANES       (4)
+#define DOUBLE_LANES    (2)
+typedef __m128i IntVector;
+typedef __m128d DoubleVector;
+#define iv_load(p)          _mm_loadu_si128((__m128i*)(p))
+#define iv_store(p, v)      _mm_storeu_si128((__m128i*)(p), (v))
+#define iv_set1(x)          _mm_set1_epi32(x)
+#define iv_add(a, b)        _mm_add_epi32((a), (b))
+#define iv_sub(a, b)        _mm_sub_epi32((a), (b))
+#define iv_cmpeq(a, b)      _mm_cmpeq_epi32((a), (b))
+#define iv_any(v)           (_mm_movemask_epi8(v) != 0)
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#define iv_mul(a, b)        _mm_mullo_epi32((a), (b))
+#define iv_min(a, b)        _mm_min_epi32((a), (b))
+#define iv_max(a, b)        _mm_max_epi32((a), (b))
+#define IV_MUL_ENABLED
+#else
+/* SSE2 has no 32 bit min/max; select through a compare mask. */
+#define iv_select(mask, a, b) \
+    _mm_or_si128(_mm_and_si128((mask), (a)), _mm_andnot_si128((mask), (b)))
+#define iv_min(a, b)        iv_select(_mm_cmpgt_epi32((a), (b)), (b), (a))
+#define iv_max(a, b)        iv_select(_mm_cmpgt_epi32((a), (b)), (a), (b))
+#endif
+#define dv_load(p)          _mm_loadu_pd(p)
+#define dv_store(p, v)      _mm_storeu_pd((p), (v))
+#define dv_set1(x)          _mm_set1_pd(x)
+#define dv_add(a, b)        _mm_add_pd((a), (b))
+#define dv_mul(a, b)        _mm_mul_pd((a), (b))
+#define dv_min(a, b)        _mm_min_pd((a), (b))
+#define dv_max(a, b)        _mm_max_pd((a), (b))
+#define dv_eq_mask(a, b)    _mm_movemask_pd(_mm_cmpeq_pd((a), (b)))
+#endif
+
+/*
+ * Int arithmetic wraps around as the interpreter's does; it is done
+ * unsigned so that the scalar loops don't overflow a signed int.
+ */
+static int int_sum(int *p, int n)
+{
+    unsigned int sum = 0;
+    int i = 0;
+#ifdef SIMD_ENABLED
+    IntVector acc;
+    int lane[INT_LANES];
+    int j;
+
+    acc = iv_set1(0);
+    for (; i + INT_LANES <= n; i += INT_LANES) {
+        acc = iv_add(acc, iv_load(p + i));
+    }
+    iv_store(lane, acc);
+    for (j = 0; j < INT_LANES; j++) {
+        sum += (unsigned int)lane[j];
+    }
+#endif
+    for (; i < n; i++) {
+        sum += (unsigned int)p[i];
+    }
+    return (int)sum;
+}
+
+/* int_min() and int_max() need n > 0. */
+static int int_min(int *p, int n)
+{
+    int ret = p[0];
+    int i = 0;
+#ifdef SIMD_ENABLED
+    IntVector acc;
+    int lane[INT_LANES];
+    int j;
+
+    if (n >= INT_LANES) {
+        acc = iv_load(p);
+        for (i = INT_LANES; i + INT_LANES <= n; i += INT_LANES) {
+            acc = iv_min(acc, iv_load(p + i));
+        }
+        iv_store(lane, acc);
+        for (j = 0; j < INT_LANES; j++) {
+            if (lane[j] < ret) {
+                ret = lane[j];
+            }
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (p[i] < ret) {
+            ret = p[i];
+        }
+    }
+    return ret;
+}
+
+static int int_max(int *p, int n)
+{
+    int ret = p[0];
+    int i = 0;
+#ifdef SIMD_ENABLED
+    IntVector acc;
+    int lane[INT_LANES];
+    int j;
+
+    if (n >= INT_LANES) {
+        acc = iv_load(p);
+        for (i = INT_LANES; i + INT_LANES <= n; i += INT_LANES) {
+            acc = iv_max(acc, iv_load(p + i));
+        }
+        iv_store(lane, acc);
+        for (j = 0; j < INT_LANES; j++) {
+            if (lane[j] > ret) {
+                ret = lane[j];
+            }
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (p[i] > ret) {
+            ret = p[i];
+        }
+    }
+    return ret;
+}
+
+static void int_fill(int *p, int n, int x)
+{
+    int i = 0;
+#ifdef SIMD_ENABLED
+    IntVector v;
+
+    v = iv_set1(x);
+    for (; i + INT_LANES <= n; i += INT_LANES) {
+        iv_store(p + i, v);
+    }
+#endif
+    for (; i < n; i++) {
+        p[i] = x;
+    }
+}
+
+static int int_index_of(int *p, int n, int x)
+{
+    int i = 0;
+#ifdef SIMD_ENABLED
+    IntVector v;
+
+    v = iv_set1(x);
+    for (; i + INT_LANES <= n; i += INT_LANES) {
+        if (iv_any(iv_cmpeq(iv_load(p + i), v))) {
+            break;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (p[i] == x) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int int_count(int *p, int n, int x)
+{
+    int count = 0;
+    int i = 0;
+#ifdef SIMD_ENABLED
+    IntVector v;
+    IntVector acc;
+    int lane[INT_LANES];
+    int j;
+
+    /* A matching lane compares as -1, so subtracting counts it. */
+    v = iv_set1(x);
+    acc = iv_set1(0);
+    for (; i + INT_LANES <= n; i += INT_LANES) {
+        acc = iv_sub(acc, iv_cmpeq(iv_load(p + i), v));
+    }
+    iv_store(lane, acc);
+    for (j = 0; j < INT_LANES; j++) {
+        count += lane[j];
+    }
+#endif
+    for (; i < n; i++) {
+        if (p[i] == x) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static int int_dot(int *a, int *b, int n)
+{
+    unsigned int sum = 0;
+    int i = 0;
+#ifdef IV_MUL_ENABLED
+    IntVector acc;
+    int lane[INT_LANES];
+    int j;
+
+    acc = iv_set1(0);
+    for (; i + INT_LANES <= n; i += INT_LANES) {
+        acc = iv_add(acc, iv_mul(iv_load(a + i), iv_load(b + i)));
+    }
+    iv_store(lane, acc);
+    for (j = 0; j < INT_LANES; j++) {
+        sum += (unsigned int)lane[j];
+    }
+#endif
+    for (; i < n; i++) {
+        sum += (unsigned int)a[i] * (unsigned int)b[i];
+    }
+    return (int)sum;
+}
+
+/*
+ * The vector loops keep one partial sum per lane, so a double result
+ * may differ in its last bits from adding the elements in order.
+ */
+static double double_sum(double *p, int n)
+{
+    double sum = 0.0;
+    int i = 0;
+#ifdef SIMD_ENABLED
+    DoubleVector acc;
+    double lane[DOUBLE_LANES];
+    int j;
+
+    acc = dv_set1(0.0);
+    for (; i + DOUBLE_LANES <= n; i += DOUBLE_LANES) {
+        acc = dv_add(acc, dv_load(p + i));
+    }
+    dv_store(lane, acc);
+    for (j = 0; j < DOUBLE_LANES; j++) {
+        sum += lane[j];
+    }
+#endif
+    for (; i < n; i++) {
+        sum += p[i];
+    }
+    return sum;
+}
+
+static double double_min(double *p, int n)
+{
+    double ret = p[0];
+    int i = 0;
+#ifdef SIMD_ENABLED
+    DoubleVector acc;
+    double lane[DOUBLE_LANES];
+    int j;
+
+    if (n >= DOUBLE_LANES) {
+        acc = dv_load(p);
+        for (i = DOUBLE_LANES; i + DOUBLE_LANES <= n; i += DOUBLE_LANES) {
+            acc = dv_min(acc, dv_load(p + i));
+        }
+        dv_store(lane, acc);
+        for (j = 0; j < DOUBLE_LANES; j++) {
+            if (lane[j] < ret) {
+                ret = lane[j];
+            }
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (p[i] < ret) {
+            ret = p[i];
+        }
+    }
+    return ret;
+}
+
+static double double_max(double *p, int n)
+{
+    double ret = p[0];
+    int i = 0;
+#ifdef SIMD_ENABLED
+    DoubleVector acc;
+    double lane[DOUBLE_LANES];
+    int j;
+
+    if (n >= DOUBLE_LANES) {
+        acc = dv_load(p);
+        for (i = DOUBLE_LANES; i + DOUBLE_LANES <= n; i += DOUBLE_LANES) {
+            acc = dv_max(acc, dv_load(p + i));
+        }
+        dv_store(lane, acc);
+        for (j = 0; j < DOUBLE_LANES; j++) {
+            if (lane[j] > ret) {
+                ret = lane[j];
+            }
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (p[i] > ret) {
+            ret = p[i];
+        }
+    }
+    return ret;
+}
+
+static void double_fill(double *p, int n, double x)
+{
+    int i = 0;
+#ifdef SIMD_ENABLED
+    DoubleVector v;
+
+    v = dv_set1(x);
+    for (; i + DOUBLE_LANES <= n; i += DOUBLE_LANES) {
+        dv_store(p + i, v);
+    }
+#endif
+    for (; i < n; i++) {
+        p[i] = x;
+    }
+}
+
+static int double_index_of(double *p, int n, double x)
+{
+    int i = 0;
+#ifdef SIMD_ENABLED
+    DoubleVector v;
+
+    v = dv_set1(x);
+    for (; i + DOUBLE_LANES <= n; i += DOUBLE_LANES) {
+        if (dv_eq_mask(dv_load(p + i), v)) {
+            break;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (p[i] == x) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int double_count(double *p, int n, double x)
+{
+    int count = 0;
+    int i = 0;
+#ifdef SIMD_ENABLED
+    DoubleVector v;
+    int mask;
+
+    v = dv_set1(x);
+    for (; i + DOUBLE_LANES <= n; i += DOUBLE_LANES) {
+        for (mask = dv_eq_mask(dv_load(p + i), v); mask; mask >>= 1) {
+            count += mask & 1;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (p[i] == x) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static double double_dot(double *a, double *b, int n)
+{
+    double sum = 0.0;
+    int i = 0;
+#ifdef SIMD_ENABLED
+    DoubleVector acc;
+    double lane[DOUBLE_LANES];
+    int j;
+
+    acc = dv_set1(0.0);
+    for (; i + DOUBLE_LANES <= n; i += DOUBLE_LANES) {
+        acc = dv_add(acc, dv_mul(dv_load(a + i), dv_load(b + i)));
+    }
+    dv_store(lane, acc);
+    for (j = 0; j < DOUBLE_LANES; j++) {
+        sum += lane[j];
+    }
+#endif
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static void argument_type_error(char *name)
+{
+    mrsk_runtime_error(0, ARRAY_LIB_ARGUMENT_TYPE_ERR,
+                       STRING_MESSAGE_ARGUMENT, "name", name,
+                       MESSAGE_ARGUMENT_END);
+}
+
+/* A multi dimensional array is taken a row at a time. */
+static MRSK_Object * array_argument(MRSK_Value *arg, char *name)
+{
+    if (arg->type != MRSK_ARRAY_VALUE
+        || arg->u.object->type == MULTI_ARRAY_OBJECT) {
+        argument_type_error(name);
+    }
+    return arg->u.object;
+}
+
+static int int_argument(MRSK_Value *arg, char *name)
+{
+    if (arg->type != MRSK_INT_VALUE) {
+        argument_type_error(name);
+    }
+    return arg->u.int_value;
+}
+
+static double number_value(MRSK_Value *v, char *name)
+{
+    if (v->type == MRSK_INT_VALUE) {
+        return v->u.int_value;
+    } else if (v->type != MRSK_DOUBLE_VALUE) {
+        argument_type_error(name);
+    }
+    return v->u.double_value;
+}
+
+/* The same equality as ==, except that values of other types differ. */
+static MRSK_Boolean values_equal(MRSK_Value *left, MRSK_Value *right)
+{
+    if (left->type == MRSK_INT_VALUE && right->type == MRSK_INT_VALUE) {
+        return left->u.int_value == right->u.int_value;
+    } else if ((left->type == MRSK_INT_VALUE
+                || left->type == MRSK_DOUBLE_VALUE)
+               && (right->type == MRSK_INT_VALUE
+                   || right->type == MRSK_DOUBLE_VALUE)) {
+        return number_value(left, "") == number_value(right, "");
+    } else if (left->type != right->type) {
+        return MRSK_FALSE;
+    } else if (left->type == MRSK_BOOLEAN_VALUE) {
+        return left->u.boolean_value == right->u.boolean_value;
+    } else if (left->type == MRSK_STRING_VALUE) {
+        return mrsk_string_equals(left->u.object, right->u.object);
+    } else if (left->type == MRSK_ARRAY_VALUE
+               || left->type == MRSK_MAP_VALUE
+               || left->type == MRSK_RECORD_VALUE) {
+        return left->u.object == right->u.object;
+    } else if (left->type == MRSK_NATIVE_POINTER_VALUE) {
+        return left->u.native_pointer.pointer
+            == right->u.native_pointer.pointer;
+    }
+    DBG_assert(left->type == MRSK_NONE_VALUE, ("type..%d\n", left->type));
+    return MRSK_TRUE;
+}
+
+/*
+ * Boxed arrays sum to an int while every element is an int, and to a
+ * double once a double is seen.
+ */
+MRSK_Value mrsk_nv_sum_proc(MRSK_Interpreter *interpreter,
+                            MRSK_LocalEnvironment *env,
+                            int arg_count, MRSK_Value *args)
+{
+    MRSK_Object *array;
+    MRSK_Value ret;
+    MRSK_Value *elem;
+    unsigned int int_sum_value = 0;
+    int i;
+
+    mrsk_check_argument_count(arg_count, 1);
+    array = array_argument(&args[0], "sum");
+
+    if (array->type == INT_ARRAY_OBJECT) {
+        ret.type = MRSK_INT_VALUE;
+        ret.u.int_value = int_sum(array->u.array.array.int_value,
+                                  array->u.array.size);
+        return ret;
+    } else if (array->type == DOUBLE_ARRAY_OBJECT) {
+        ret.type = MRSK_DOUBLE_VALUE;
+        ret.u.double_value = double_sum(array->u.array.array.double_value,
+                                        array->u.array.size);
+        return ret;
+    }
+    ret.type = MRSK_INT_VALUE;
+    for (i = 0; i < array->u.array.size; i++) {
+        elem = &array->u.array.array.value[i];
+        if (ret.type == MRSK_INT_VALUE && elem->type == MRSK_INT_VALUE) {
+            int_sum_value += (unsigned int)elem->u.int_value;
+            continue;
+        }
+        if (ret.type == MRSK_INT_VALUE) {
+            ret.type = MRSK_DOUBLE_VALUE;
+            ret.u.double_value = (int)int_sum_value;
+        }
+        ret.u.double_value += number_value(elem, "sum");
+    }
+    if (ret.type == MRSK_INT_VALUE) {
+        ret.u.int_value = (int)int_sum_value;
+    }
+
+    return ret;
+}
+
+static MRSK_Value min_max(int arg_count, MRSK_Value *args,
+                          MRSK_Boolean is_max, char *name)
+{
+    MRSK_Object *array;
+    MRSK_Value ret;
+    MRSK_Value *elem;
+    int size;
+    int i;
+
+    mrsk_check_argument_count(arg_count, 1);
+    array = array_argument(&args[0], name);
+    size = array->u.array.size;
+    if (size == 0) {
+        mrsk_runtime_error(0, ARRAY_LIB_EMPTY_ARRAY_ERR,
+                           STRING_MESSAGE_ARGUMENT, "name", name,
+                           MESSAGE_ARGUMENT_END);
+    }
+
+    if (array->type == INT_ARRAY_OBJECT) {
+        ret.type = MRSK_INT_VALUE;
+        ret.u.int_value = is_max
+            ? int_max(array->u.array.array.int_value, size)
+            : int_min(array->u.array.array.int_value, size);
+        return ret;
+    } else if (array->type == DOUBLE_ARRAY_OBJECT) {
+        ret.type = MRSK_DOUBLE_VALUE;
+        ret.u.double_value = is_max
+            ? double_max(array->u.array.array.double_value, size)
+            : double_min(array->u.array.array.double_value, size);
+        return ret;
+    }
+    ret = array->u.array.array.value[0];
+    number_value(&ret, name);
+    for (i = 1; i < size; i++) {
+        elem = &array->u.array.array.value[i];
+        if (is_max ? number_value(elem, name) > number_value(&ret, name)
+            : number_value(elem, name) < number_value(&ret, name)) {
+            ret = *elem;
+        }
+    }
+
+    return ret;
+}
+
+MRSK_Value mrsk_nv_min_proc(MRSK_Interpreter *interpreter,
+                            MRSK_LocalEnvironment *env,
+                            int arg_count, MRSK_Value *args)
+{
+    return min_max(arg_count, args, MRSK_FALSE, "min");
+}
+
+MRSK_Value mrsk_nv_max_proc(MRSK_Interpreter *interpreter,
+                            MRSK_LocalEnvironment *env,
+                            int arg_count, MRSK_Value *args)
+{
+    return min_max(arg_count, args, MRSK_TRUE, "max");
+}
+
+MRSK_Value mrsk_nv_fill_proc(MRSK_Interpreter *interpreter,
+                             MRSK_LocalEnvironment *env,
+                             int arg_count, MRSK_Value *args)
+{
+    MRSK_Object *array;
+    MRSK_Value ret;
+    int size;
+    int i;
+
+    mrsk_check_argument_count(arg_count, 2);
+    array = array_argument(&args[0], "fill");
+    size = array->u.array.size;
+    ret.type = MRSK_NONE_VALUE;
+    if (size == 0) {
+        return ret;
+    }
+
+    /*
+     * Storing the first element checks (and for a double_array
+     * converts) the value the same way an assignment would.
+     */
+    mrsk_array_unshare(interpreter, array);
+    mrsk_store_array_element(interpreter, array, 0, &args[1], 0);
+    if (array->type == INT_ARRAY_OBJECT) {
+        int_fill(array->u.array.array.int_value, size,
+                 array->u.array.array.int_value[0]);
+    } else if (array->type == DOUBLE_ARRAY_OBJECT) {
+        double_fill(array->u.array.array.double_value, size,
+                    array->u.array.array.double_value[0]);
+    } else {
+        mrsk_shade_values(interpreter, array->u.array.owner
+                          ? array->u.array.owner : array,
+                          array->u.array.array.value + 1, size - 1);
+        for (i = 1; i < size; i++) {
+            array->u.array.array.value[i] = args[1];
+        }
+    }
+
+    return ret;
+}
+
+static void check_range(MRSK_Object *array, int start, int count,
+                        char *name)
+{
+    if (start < 0 || count < 0 || start > array->u.array.size - count) {
+        mrsk_runtime_error(0, ARRAY_LIB_RANGE_ERR,
+                           STRING_MESSAGE_ARGUMENT, "name", name,
+                           MESSAGE_ARGUMENT_END);
+    }
+}
+
+/*
+ * copy_range(dest, dest_start, src, src_start, count).  The ranges may
+ * overlap.  Between arrays of different kinds each element is stored
+ * as an assignment would.
+ */
+MRSK_Value mrsk_nv_copy_range_proc(MRSK_Interpreter *interpreter,
+                                   MRSK_LocalEnvironment *env,
+                                   int arg_count, MRSK_Value *args)
+{
+    MRSK_Object *dest;
+    MRSK_Object *src;
+    int dest_start;
+    int src_start;
+    int count;
+    MRSK_Value v;
+    int i;
+
+    mrsk_check_argument_count(arg_count, 5);
+    dest = array_argument(&args[0], "copy_range");
+    dest_start = int_argument(&args[1], "copy_range");
+    src = array_argument(&args[2], "copy_range");
+    src_start = int_argument(&args[3], "copy_range");
+    count = int_argument(&args[4], "copy_range");
+    check_range(dest, dest_start, count, "copy_range");
+    check_range(src, src_start, count, "copy_range");
+    mrsk_array_unshare(interpreter, dest);
+
+    if (dest->type == INT_ARRAY_OBJECT && src->type == INT_ARRAY_OBJECT) {
+        memmove(dest->u.array.array.int_value + dest_start,
+                src->u.array.array.int_value + src_start,
+                sizeof(int) * count);
+    } else if (dest->type == DOUBLE_ARRAY_OBJECT
+               && src->type == DOUBLE_ARRAY_OBJECT) {
+        memmove(dest->u.array.array.double_value + dest_start,
+                src->u.array.array.double_value + src_start,
+                sizeof(double) * count);
+    } else if (dest->type == ARRAY_OBJECT && src->type == ARRAY_OBJECT) {
+        mrsk_shade_values(interpreter, dest->u.array.owner
+                          ? dest->u.array.owner : dest,
+                          dest->u.array.array.value + dest_start, count);
+        memmove(dest->u.array.array.value + dest_start,
+                src->u.array.array.value + src_start,
+                sizeof(MRSK_Value) * count);
+        mrsk_remember_object(interpreter, dest->u.array.owner
+                             ? dest->u.array.owner : dest);
+    } else {
+        for (i = 0; i < count; i++) {
+            v = mrsk_fetch_array_element(src, src_start + i);
+            mrsk_store_array_element(interpreter, dest, dest_start + i, &v,
+                                     0);
+        }
+    }
+    v.type = MRSK_NONE_VALUE;
+
+    return v;
+}
+
+/*
+ * A typed array can only hold a value of its own kind, so a search for
+ * anything else finds nothing; a whole double can match in an
+ * int_array, and any int in a double_array.
+ */
+static MRSK_Boolean typed_search_key(MRSK_Object *array, MRSK_Value *v,
+                                     int *int_key, double *double_key)
+{
+    if (array->type == INT_ARRAY_OBJECT) {
+        if (v->type == MRSK_INT_VALUE) {
+            *int_key = v->u.int_value;
+            return MRSK_TRUE;
+        }
+        if (v->type == MRSK_DOUBLE_VALUE
+            && v->u.double_value == (int)v->u.double_value) {
+            *int_key = (int)v->u.double_value;
+            return MRSK_TRUE;
+        }
+        return MRSK_FALSE;
+    }
+    if (v->type == MRSK_INT_VALUE || v->type == MRSK_DOUBLE_VALUE) {
+        *double_key = number_value(v, "");
+        return MRSK_TRUE;
+    }
+    return MRSK_FALSE;
+}
+
+/* Returns the index of the first element equal to the value, or -1. */
+MRSK_Value mrsk_nv_index_of_proc(MRSK_Interpreter *interpreter,
+                                 MRSK_LocalEnvironment *env,
+                                 int arg_count, MRSK_Value *args)
+{
+    MRSK_Object *array;
+    MRSK_Value ret;
+    int int_key;
+    double double_key;
+    int i;
+
+    mrsk_check_argument_count(arg_count, 2);
+    array = array_argument(&args[0], "index_of");
+    ret.type = MRSK_INT_VALUE;
+    ret.u.int_value = -1;
+
+    if (array->type == ARRAY_OBJECT) {
+        for (i = 0; i < array->u.array.size; i++) {
+            if (values_equal(&array->u.array.array.value[i], &args[1])) {
+                ret.u.int_value = i;
+                break;
+            }
+        }
+    } else if (typed_search_key(array, &args[1], &int_key, &double_key)) {
+        if (array->type == INT_ARRAY_OBJECT) {
+            ret.u.int_value = int_index_of(array->u.array.array.int_value,
+                                           array->u.array.size, int_key);
+        } else {
+            ret.u.int_value
+                = double_index_of(array->u.array.array.double_value,
+                                  array->u.array.size, double_key);
+        }
+    }
+
+    return ret;
+}
+
+MRSK_Value mrsk_nv_count_proc(MRSK_Interpreter *interpreter,
+                              MRSK_LocalEnvironment *env,
+                              int arg_count, MRSK_Value *args)
+{
+    MRSK_Object *array;
+    MRSK_Value ret;
+    int int_key;
+    double double_key;
+    int i;
+
+    mrsk_check_argument_count(arg_count, 2);
+    array = array_argument(&args[0], "count");
+    ret.type = MRSK_INT_VALUE;
+    ret.u.int_value = 0;
+
+    if (array->type == ARRAY_OBJECT) {
+        for (i = 0; i < array->u.array.size; i++) {
+            if (values_equal(&array->u.array.array.value[i], &args[1])) {
+                ret.u.int_value++;
+            }
+        }
+    } else if (typed_search_key(array, &args[1], &int_key, &double_key)) {
+        if (array->type == INT_ARRAY_OBJECT) {
+            ret.u.int_value = int_count(array->u.array.array.int_value,
+                                        array->u.array.size, int_key);
+        } else {
+            ret.u.int_value = double_count(array->u.array.array.double_value,
+                                           array->u.array.size, double_key);
+        }
+    }
+
+    return ret;
+}
+
+/*
+ * The product is an int when both arrays hold ints, and a double
+ * otherwise.
+ */
+MRSK_Value mrsk_nv_dot_proc(MRSK_Interpreter *interpreter,
+                            MRSK_LocalEnvironment *env,
+                            int arg_count, MRSK_Value *args)
+{
+    MRSK_Object *left;
+    MRSK_Object *right;
+    MRSK_Value ret;
+    MRSK_Value l;
+    MRSK_Value r;
+    unsigned int int_sum_value = 0;
+    int size;
+    int i;
+
+    mrsk_check_argument_count(arg_count, 2);
+    left = array_argument(&args[0], "dot");
+    right = array_argument(&args[1], "dot");
+    size = left->u.array.size;
+    if (right->u.array.size != size) {
+        mrsk_runtime_error(0, ARRAY_LIB_SIZE_MISMATCH_ERR,
+                           STRING_MESSAGE_ARGUMENT, "name", "dot",
+                           MESSAGE_ARGUMENT_END);
+    }
+
+    if (left->type == INT_ARRAY_OBJECT && right->type == INT_ARRAY_OBJECT) {
+        ret.type = MRSK_INT_VALUE;
+        ret.u.int_value = int_dot(left->u.array.array.int_value,
+                                  right->u.array.array.int_value, size);
+        return ret;
+    } else if (left->type == DOUBLE_ARRAY_OBJECT
+               && right->type == DOUBLE_ARRAY_OBJECT) {
+        ret.type = MRSK_DOUBLE_VALUE;
+        ret.u.double_value = double_dot(left->u.array.array.double_value,
+                                        right->u.array.array.double_value,
+                                        size);
+        return ret;
+    }
+    ret.type = MRSK_INT_VALUE;
+    for (i = 0; i < size; i++) {
+        l = mrsk_fetch_array_element(left, i);
+        r = mrsk_fetch_array_element(right, i);
+        if (ret.type == MRSK_INT_VALUE && l.type == MRSK_INT_VALUE
+            && r.type == MRSK_INT_VALUE) {
+            int_sum_value += (unsigned int)l.u.int_value
+                * (unsigned int)r.u.int_value;
+            continue;
+        }
+        if (ret.type == MRSK_INT_VALUE) {
+            ret.type = MRSK_DOUBLE_VALUE;
+            ret.u.double_value = (int)int_sum_value;
+        }
+        ret.u.double_value += number_value(&l, "dot") * number_value(&r, "dot");
+    }
+    if (ret.type == MRSK_INT_VALUE) {
+        ret.u.int_value = (int)int_sum_value;
+    }
+
+    return ret;
+}
+
+/*
+ * sort(array) and sort(array, "compare_fn") sort in place.  Without a
+ * comparator the elements must all be numbers or all be strings: ints
+ * go through a radix sort, doubles through an introsort, and strings
+ * and mixed numbers through a stable merge sort, which keeps the
+ * number of (costly) string comparisons low.  A comparator is a
+ * murasaki function of two arguments which returns a negative int, 0
+ * or a positive int; it gets the merge sort too.
+ */
+#define SORT_SMALL_SIZE         (16)
+
+static void int_insertion_sort(int *p, int n)
+{
+    int i;
+    int j;
+    int x;
+
+    for (i = 1; i < n; i++) {
+        x = p[i];
+        for (j = i; j > 0 && p[j-1] > x; j--) {
+            p[j] = p[j-1];
+        }
+        p[j] = x;
+    }
+}
+
+/*
+ * LSD radix sort a byte at a time.  Flipping the sign bit makes the
+ * unsigned order of the keys the signed order of the ints.  A pass in
+ * which every key has the same byte is skipped.
+ */
+static void int_radix_sort(int *p, int n)
+{
+    unsigned int sign_bit = 1u << (sizeof(int) * 8 - 1);
+    unsigned int *src = (unsigned int*)p;
+    unsigned int *dest;
+    unsigned int *tmp;
+    unsigned int *swap;
+    int count[256];
+    int shift;
+    int pos;
+    int sum;
+    int i;
+
+    if (n <= SORT_SMALL_SIZE) {
+        int_insertion_sort(p, n);
+        return;
+    }
+    tmp = MEM_malloc(sizeof(unsigned int) * n);
+    dest = tmp;
+    for (shift = 0; shift < (int)sizeof(int) * 8; shift += 8) {
+        for (i = 0; i < 256; i++) {
+            count[i] = 0;
+        }
+        for (i = 0; i < n; i++) {
+            count[((src[i] ^ sign_bit) >> shift) & 0xff]++;
+        }
+        if (count[((src[0] ^ sign_bit) >> shift) & 0xff] == n) {
+            continue;
+        }
+        for (i = 0, sum = 0; i < 256; i++) {
+            pos = sum;
+            sum += count[i];
+            count[i] = pos;
+        }
+        for (i = 0; i < n; i++) {
+            dest[count[((src[i] ^ sign_bit) >> shift) & 0xff]++] = src[i];
+        }
+        swap = src;
+        src = dest;
+        dest = swap;
+    }
+    if (src != (unsigned int*)p) {
+        memcpy(p, src, sizeof(int) * n);
+    }
+    MEM_free(tmp);
+}
+
+static void double_insertion_sort(double *p, int n)
+{
+    int i;
+    int j;
+    double x;
+
+    for (i = 1; i < n; i++) {
+        x = p[i];
+        for (j = i; j > 0 && p[j-1] > x; j--) {
+            p[j] = p[j-1];
+        }
+        p[j] = x;
+    }
+}
+
+static void double_sift_down(double *p, int root, int n)
+{
+    int child;
+    double x = p[root];
+
+    for (; (child = root * 2 + 1) < n; root = child) {
+        if (child + 1 < n && p[child] < p[child+1]) {
+            child++;
+        }
+        if (!(x < p[child])) {
+            break;
+        }
+        p[root] = p[child];
+    }
+    p[root] = x;
+}
+
+static void double_heap_sort(double *p, int n)
+{
+    int i;
+    double x;
+
+    for (i = n / 2 - 1; i >= 0; i--) {
+        double_sift_down(p, i, n);
+    }
+    for (i = n - 1; i > 0; i--) {
+        x = p[0];
+        p[0] = p[i];
+        p[i] = x;
+        double_sift_down(p, 0, i);
+    }
+}
+
+/*
+ * Quicksort with a median of three pivot, handing over to heap sort
+ * when depth runs out and to insertion sort for short ranges.  The
+ * caller has moved any NaN out of the range.
+ */
+static void double_introsort(double *p, int n, int depth)
+{
+    double pivot;
+    double x;
+    int i;
+    int j;
+
+    while (n > SORT_SMALL_SIZE) {
+        if (depth == 0) {
+            double_heap_sort(p, n);
+            return;
+        }
+        depth--;
+        if (p[n/2] < p[0]) {
+            x = p[n/2]; p[n/2] = p[0]; p[0] = x;
+        }
+        if (p[n-1] < p[n/2]) {
+            x = p[n-1]; p[n-1] = p[n/2]; p[n/2] = x;
+            if (p[n/2] < p[0]) {
+                x = p[n/2]; p[n/2] = p[0]; p[0] = x;
+            }
+        }
+        pivot = p[n/2];
+        i = -1;
+        j = n;
+        for (;;) {
+            do {
+                i++;
+            } while (p[i] < pivot);
+            do {
+                j--;
+            } while (pivot < p[j]);
+            if (i >= j) {
+                break;
+            }
+            x = p[i];
+            p[i] = p[j];
+            p[j] = x;
+        }
+        /* Recurse into the shorter side, loop on the longer one. */
+        if (j + 1 < n - j - 1) {
+            double_introsort(p, j + 1, depth);
+            p += j + 1;
+            n -= j + 1;
+        } else {
+            double_introsort(p + j + 1, n - j - 1, depth);
+            n = j + 1;
+        }
+    }
+    double_insertion_sort(p, n);
+}
+
+/* NaN compares false with everything, so NaNs are put last. */
+static void double_sort(double *p, int n)
+{
+    int depth;
+    int last;
+    int i;
+    double x;
+
+    last = n;
+    for (i = 0; i < last; i++) {
+        if (p[i] != p[i]) {
+            last--;
+            x = p[i];
+            p[i] = p[last];
+            p[last] = x;
+            i--;
+        }
+    }
+    for (depth = 0, i = last; i > 1; i >>= 1) {
+        depth += 2;
+    }
+    double_introsort(p, last, depth);
+}
+
+typedef struct SortContext_tag SortContext;
+
+typedef int SortCompareFunc(SortContext *ctx,
+                            MRSK_Value *left, MRSK_Value *right);
+
+struct SortContext_tag {
+    SortCompareFunc *compare;
+    MRSK_Interpreter *inter;
+    MRSK_LocalEnvironment *env;
+    FunctionDefinition *func;
+};
+
+static int compare_numbers(SortContext *ctx,
+                           MRSK_Value *left, MRSK_Value *right)
+{
+    double l;
+    double r;
+
+    if (left->type == MRSK_INT_VALUE && right->type == MRSK_INT_VALUE) {
+        return (left->u.int_value > right->u.int_value)
+            - (left->u.int_value < right->u.int_value);
+    }
+    l = number_value(left, "sort");
+    r = number_value(right, "sort");
+
+    return (l > r) - (l < r);
+}
+
+static int compare_strings(SortContext *ctx,
+                           MRSK_Value *left, MRSK_Value *right)
+{
+    return mrsk_compare_string(left->u.object, right->u.object);
+}
+
+static int compare_by_function(SortContext *ctx,
+                               MRSK_Value *left, MRSK_Value *right)
+{
+    MRSK_Value args[2];
+    MRSK_Value ret;
+
+    args[0] = *left;
+    args[1] = *right;
+    ret = mrsk_call_function_in_env(ctx->inter, ctx->env, ctx->func,
+                                    2, args);
+    if (ret.type != MRSK_INT_VALUE) {
+        mrsk_runtime_error(0, SORT_COMPARE_RESULT_ERR,
+                           STRING_MESSAGE_ARGUMENT, "name", ctx->func->name,
+                           MESSAGE_ARGUMENT_END);
+    }
+    return ret.u.int_value;
+}
+
+/*
+ * Swaps rather than holding the element being placed aside, so that
+ * every element stays in p while compare runs.
+ */
+static void value_insertion_sort(SortContext *ctx, MRSK_Value *p, int n)
+{
+    int i;
+    int j;
+    MRSK_Value x;
+
+    for (i = 1; i < n; i++) {
+        for (j = i; j > 0 && ctx->compare(ctx, &p[j-1], &p[j]) > 0; j--) {
+            x = p[j];
+            p[j] = p[j-1];
+            p[j-1] = x;
+        }
+    }
+}
+
+/*
+ * tmp has room for n values.  Merged runs are only copied back after
+ * the comparisons, so p keeps every element while compare runs.
+ */
+static void value_merge_sort(SortContext *ctx, MRSK_Value *p,
+                             MRSK_Value *tmp, int n)
+{
+    int half = n / 2;
+    int i;
+    int j;
+    int k;
+
+    if (n <= SORT_SMALL_SIZE) {
+        value_insertion_sort(ctx, p, n);
+        return;
+    }
+    value_merge_sort(ctx, p, tmp, half);
+    value_merge_sort(ctx, p + half, tmp, n - half);
+    if (ctx->compare(ctx, &p[half-1], &p[half]) <= 0) {
+        return;
+    }
+    for (i = 0, j = half, k = 0; i < half && j < n; k++) {
+        if (ctx->compare(ctx, &p[j], &p[i]) < 0) {
+            tmp[k] = p[j++];
+        } else {
+            tmp[k] = p[i++];
+        }
+    }
+    while (i < half) {
+        tmp[k++] = p[i++];
+    }
+    /* What is left of the right half is already in place. */
+    memcpy(p, tmp, sizeof(MRSK_Value) * k);
+}
+
+static void value_sort(SortContext *ctx, MRSK_Value *p, int n)
+{
+    MRSK_Value *tmp;
+
+    tmp = MEM_malloc(sizeof(MRSK_Value) * (n > 0 ? n : 1));
+    value_merge_sort(ctx, p, tmp, n);
+    MEM_free(tmp);
+}
+
+/*
+ * A boxed array whose elements are all ints or all doubles is sorted
+ * as bare numbers and boxed again.
+ */
+static void sort_boxed_array(MRSK_Object *array)
+{
+    MRSK_Value *v = array->u.array.array.value;
+    int size = array->u.array.size;
+    int int_count = 0;
+    int double_count = 0;
+    int string_count = 0;
+    SortContext ctx;
+    int *ints;
+    double *doubles;
+    int i;
+
+    for (i = 0; i < size; i++) {
+        if (v[i].type == MRSK_INT_VALUE) {
+            int_count++;
+        } else if (v[i].type == MRSK_DOUBLE_VALUE) {
+            double_count++;
+        } else if (v[i].type == MRSK_STRING_VALUE) {
+            string_count++;
+        }
+    }
+    if (int_count == size) {
+        ints = MEM_malloc(sizeof(int) * size);
+        for (i = 0; i < size; i++) {
+            ints[i] = v[i].u.int_value;
+        }
+        int_radix_sort(ints, size);
+        for (i = 0; i < size; i++) {
+            v[i].u.int_value = ints[i];
+        }
+        MEM_free(ints);
+    } else if (double_count == size) {
+        doubles = MEM_malloc(sizeof(double) * size);
+        for (i = 0; i < size; i++) {
+            doubles[i] = v[i].u.double_value;
+        }
+        double_sort(doubles, size);
+        for (i = 0; i < size; i++) {
+            v[i].u.double_value = doubles[i];
+        }
+        MEM_free(doubles);
+    } else if (int_count + double_count == size) {
+        ctx.compare = compare_numbers;
+        value_sort(&ctx, v, size);
+    } else if (string_count == size) {
+        ctx.compare = compare_strings;
+        value_sort(&ctx, v, size);
+    } else {
+        mrsk_runtime_error(0, SORT_ELEMENT_TYPE_ERR, MESSAGE_ARGUMENT_END);
+    }
+}
+
+/*
+ * The comparator may do anything, including growing the array or
+ * storing over its elements, so the elements are sorted in a copy and
+ * written back.  The copy is the frame of an environment of its own,
+ * which the collector scans as it does any other, so elements the
+ * comparator drops from the array stay alive until they are put back.
+ */
+static void sort_with_function(MRSK_Interpreter *inter, MRSK_Object *array,
+                               MRSK_Value *name)
+{
+    FunctionDefinition *func;
+    SortContext ctx;
+    MRSK_LocalEnvironment *copy;
+    char *func_name;
+    int size = array->u.array.size;
+    int i;
+
+    if (name->type != MRSK_STRING_VALUE) {
+        argument_type_error("sort");
+    }
+    func_name = mrsk_intern_string(inter,
+                                   mrsk_get_string_chars(inter,
+                                                         name->u.object));
+    func = mrsk_search_function(func_name);
+    if (func == NULL) {
+        mrsk_runtime_error(0, FUNCTION_NOT_FOUND_ERR,
+                           STRING_MESSAGE_ARGUMENT, "name", func_name,
+                           MESSAGE_ARGUMENT_END);
+    }
+    if (func->type != MURASAKI_FUNCTION_DEFINITION) {
+        argument_type_error("sort");
+    }
+    mrsk_check_argument_count(2, func->u.murasaki_f.parameter_count);
+
+    copy = mrsk_alloc_local_environment(inter, size);
+    for (i = 0; i < size; i++) {
+        copy->frame[i] = mrsk_fetch_array_element(array, i);
+    }
+    ctx.compare = compare_by_function;
+    ctx.inter = inter;
+    ctx.func = func;
+    ctx.env = mrsk_alloc_local_environment(inter,
+                                           func->u.murasaki_f
+                                           .local_variable_count);
+    value_sort(&ctx, copy->frame, size);
+    mrsk_dispose_local_environment(inter);
+
+    if (array->u.array.size != size) {
+        mrsk_runtime_error(0, SORT_ARRAY_MODIFIED_ERR, MESSAGE_ARGUMENT_END);
+    }
+    mrsk_array_unshare(inter, array);
+    for (i = 0; i < size; i++) {
+        mrsk_store_array_element(inter, array, i, &copy->frame[i], 0);
+    }
+    mrsk_dispose_local_environment(inter);
+}
+
+MRSK_Value mrsk_nv_sort_proc(MRSK_Interpreter *interpreter,
+                             MRSK_LocalEnvironment *env,
+                             int arg_count, MRSK_Value *args)
+{
+    MRSK_Object *array;
+    MRSK_Value ret;
+
+    if (arg_count < 1) {
+        mrsk_runtime_error(0, ARGUMENT_TOO_FEW_ERR, MESSAGE_ARGUMENT_END);
+    } else if (arg_count > 2) {
+        mrsk_runtime_error(0, ARGUMENT_TOO_MANY_ERR, MESSAGE_ARGUMENT_END);
+    }
+    array = array_argument(&args[0], "sort");
+
+    mrsk_array_unshare(interpreter, array);
+
+    if (arg_count == 2) {
+        sort_with_function(interpreter, array, &args[1]);
+    } else if (array->type == INT_ARRAY_OBJECT) {
+        int_radix_sort(array->u.array.array.int_value, array->u.array.size);
+    } else if (array->type == DOUBLE_ARRAY_OBJECT) {
+        double_sort(array->u.array.array.double_value, array->u.array.size);
+    } else {
+        mrsk_finish_scan(interpreter, array);
+        sort_boxed_array(array);
+    }
+    ret.type = MRSK_NONE_VALUE;
+
+    return ret;
+}
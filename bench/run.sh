@@ -0,0 +1,16 @@
+#!/bin/bash
+# Runs every benchmark script with the bytecode VM and with the AST walker
+# (-ast) and prints the elapsed time of each run.
+#
+#   usage: bench/run.sh [path-to-murasaki]
+
+MURASAKI=${1:-$(dirname "$0")/../murasaki}
+TIMEFORMAT='%R s'
+
+for script in "$(dirname "$0")"/*.mrsk; do
+    echo "== $(basename "$script")"
+    echo -n "bytecode: "
+    { time "$MURASAKI" "$script" > /dev/null; } 2>&1
+    echo -n "ast:      "
+    { time "$MURASAKI" -ast "$script" > /dev/null; } 2>&1
+done
@@ -21,6 +21,52 @@ void mrsk_function_define(char *identifier, ParameterList *parameter_list,
     f->type = MURASAKI_FUNCTION_DEFINITION;
     f->u.murasaki_f.parameter = parameter_list;
     f->u.murasaki_f.block = block;
+    f->u.murasaki_f.parameter_count = 0;
+    f->u.murasaki_f.local_variable_count = 0;
+    f->u.murasaki_f.local_variable = NULL;
+    f->u.murasaki_f.executable = NULL;
+    f->next = inter->function_list;
+    inter->function_list = f;
+}
+
+void mrsk_struct_define(char *identifier, IdentifierList *field_list)
+{
+    FunctionDefinition *f;
+    MRSK_Interpreter *inter;
+    IdentifierList *pos;
+    IdentifierList *prev;
+    int i;
+
+    if (mrsk_search_function(identifier)) {
+        mrsk_compile_error(FUNCTION_MULTIPLE_DEFINE_ERR,
+                           STRING_MESSAGE_ARGUMENT, "name",
+                           identifier, MESSAGE_ARGUMENT_END);
+        return;
+    }
+    inter = mrsk_get_current_interpreter();
+
+    f = mrsk_malloc(sizeof(FunctionDefinition));
+    f->name = identifier;
+    f->type = RECORD_DEFINITION;
+    f->u.record_f.shape.name = identifier;
+    f->u.record_f.shape.field_count = 0;
+    for (pos = field_list; pos; pos = pos->next) {
+        for (prev = field_list; prev != pos; prev = prev->next) {
+            if (prev->name == pos->name) {
+                mrsk_compile_error(FIELD_MULTIPLE_DEFINE_ERR,
+                                   STRING_MESSAGE_ARGUMENT, "name",
+                                   identifier,
+                                   STRING_MESSAGE_ARGUMENT, "field",
+                                   pos->name, MESSAGE_ARGUMENT_END);
+            }
+        }
+        f->u.record_f.shape.field_count++;
+    }
+    f->u.record_f.shape.field
+        = mrsk_malloc(sizeof(char*) * f->u.record_f.shape.field_count);
+    for (pos = field_list, i = 0; pos; pos = pos->next, i++) {
+        f->u.record_f.shape.field[i] = pos->name;
+    }
     f->next = inter->function_list;
     inter->function_list = f;
 }
@@ -84,6 +130,7 @@ ExpressionList * mrsk_chain_expression_list(ExpressionList *list, Expression *ex
     ExpressionList *pos;
 
     for(pos=list; pos->next; pos=pos->next) ;
+    pos->next = mrsk_create_expression_list(expr);
 
     return list;
 }
@@ -135,59 +182,27 @@ Expression * mrsk_create_assign_expression(Expression *left, Expression *operand
     return exp;
 }
 
-static Expression convert_value_to_expression(MRSK_Value *v)
-{
-    Expression expr;
-
-    if (v->type == MRSK_INT_VALUE) {
-        expr.type == INT_EXPRESSION;
-        expr.u.int_value = v->u.int_value;
-    } else if (v->type == MRSK_DOUBLE_VALUE) {
-        expr.type == DOUBLE_EXPRESSION;
-        expr.u.double_value = v->u.double_value;
-    } else {
-        DBG_assert(v->type==MRSK_BOOLEAN_VALUE,
-                   ("v->type..%d\n", v->type));
-        expr.type = BOOLEAN_EXPRESSION;
-        expr.u.boolean_value = v->u.boolean_value;
-    }
-    return expr;
-}
-
 Expression * mrsk_create_binary_expression(ExpressionType operator,
                                             Expression *left, Expression *right)
 {
-    if ((left->type == INT_EXPRESSION || left->type == DOUBLE_EXPRESSION)
-         && (right->type == INT_EXPRESSION || right->type == DOUBLE_EXPRESSION)) {
-        MRSK_Value v;
-        v = mrsk_eval_binary_expression(mrsk_get_current_interpreter(), NULL,
-                                        operator, left, right);
-        *left = convert_value_to_expression(&v);
-        return left;
-    } else {
-        Expression *exp;
-        exp = mrsk_alloc_expression(operator);
-        exp->u.binary_expression.left = left;
-        exp->u.binary_expression.right = right;
-        return exp;
-    }
+    Expression *exp;
+
+    exp = mrsk_alloc_expression(operator);
+    exp->u.binary_expression.left = left;
+    exp->u.binary_expression.right = right;
+    exp->u.binary_expression.quickening_failed = MRSK_FALSE;
+
+    return exp;
 }
 
 Expression * mrsk_create_minus_expression(Expression *operand)
 {
-    if (operand->type == INT_EXPRESSION
-        || operand->type == DOUBLE_EXPRESSION) {
-        MRSK_Value v;
-        v = mrsk_eval_minus_expression(mrsk_get_current_interpreter(),
-                                       NULL, operand);
-        *operand = convert_value_to_expression(&v);
-        return operand;
-    } else {
-        Expression *exp;
-        exp = mrsk_alloc_expression(MINUS_EXPRESSION);
-        exp->u.minus_expression = operand;
-        return exp;
-    }
+    Expression *exp;
+
+    exp = mrsk_alloc_expression(MINUS_EXPRESSION);
+    exp->u.minus_expression = operand;
+
+    return exp;
 }
 
 Expression * mrsk_create_index_expression(Expression *array, Expression *index)
@@ -216,7 +231,9 @@ Expression * mrsk_create_identifier_expression(char *identifier)
     Expression *exp;
 
     exp = mrsk_alloc_expression(IDENTIFIER_EXPRESSION);
-    exp->u.identifier = identifier;
+    exp->u.identifier.name = identifier;
+    exp->u.identifier.local_index = -1;
+    exp->u.identifier.global_index = -1;
 
     return exp;
 }
@@ -228,6 +245,7 @@ Expression * mrsk_create_function_call_expression(char *func_name, ArgumentList
     exp = mrsk_alloc_expression(FUNCTION_CALL_EXPRESSION);
     exp->u.function_call_expression.identifier = func_name;
     exp->u.function_call_expression.argument = argument;
+    exp->u.function_call_expression.function = NULL;
 
     return exp;
 }
@@ -240,11 +258,26 @@ Expression * mrsk_create_method_call_expression(Expression *expression,
     exp = mrsk_alloc_expression(METHOD_CALL_EXPRESSION);
     exp->u.method_call_expression.expression = expression;
     exp->u.method_call_expression.identifier = method_name;
+    exp->u.method_call_expression.selector
+        = mrsk_intern_selector(mrsk_get_current_interpreter(), method_name);
     exp->u.method_call_expression.argument = argument;
 
     return exp;
 }
 
+Expression * mrsk_create_member_expression(Expression *expression,
+                                          char *member_name)
+{
+    Expression *exp;
+
+    exp = mrsk_alloc_expression(MEMBER_EXPRESSION);
+    exp->u.member_expression.expression = expression;
+    exp->u.member_expression.member_name = member_name;
+    exp->u.member_expression.slot = -1;
+
+    return exp;
+}
+
 Expression * mrsk_create_boolean_expression(MRSK_Boolean value)
 {
     Expression *exp;
@@ -300,6 +333,7 @@ IdentifierList * mrsk_create_global_identifier(char *identifier)
 
     i_list = mrsk_malloc(sizeof(IdentifierList));
     i_list->name = identifier;
+    i_list->global_index = -1;
     i_list->next = NULL;
 
     return i_list;
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include "MEM.h"
+#include "DBG.h"
+#include "murasaki.h"
+
+#define INDENT_WIDTH    (4)
+
+static void dump_expression(Expression *expr, FILE *fp);
+static void dump_statement_list(StatementList *list, int indent, FILE *fp);
+
+static void dump_indent(int indent, FILE *fp)
+{
+    fprintf(fp, "%*s", indent * INDENT_WIDTH, "");
+}
+
+static void dump_string(char *str, FILE *fp)
+{
+    fputc('"', fp);
+    for (; *str; str++) {
+        switch (*str) {
+            case '\n':
+                fputs("\\n", fp);
+                break;
+            case '\t':
+                fputs("\\t", fp);
+                break;
+            case '"':
+                fputs("\\\"", fp);
+                break;
+            case '\\':
+                fputs("\\\\", fp);
+                break;
+            default:
+                fputc(*str, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void dump_argument_list(ArgumentList *arg_list, FILE *fp)
+{
+    ArgumentList *pos;
+
+    fputc('(', fp);
+    for (pos = arg_list; pos; pos = pos->next) {
+        dump_expression(pos->expression, fp);
+        if (pos->next) {
+            fputs(", ", fp);
+        }
+    }
+    fputc(')', fp);
+}
+
+/*
+ * Binary expressions are always parenthesized, so the output shows the
+ * tree's shape rather than relying on precedence.
+ */
+static void dump_expression(Expression *expr, FILE *fp)
+{
+    char buf[NUMBER_FORMAT_BUF_SIZE];
+    ExpressionList *pos;
+
+    switch (expr->type) {
+        case BOOLEAN_EXPRESSION:
+            fputs(expr->u.boolean_value ? "True" : "False", fp);
+            break;
+        case INT_EXPRESSION:
+            fprintf(fp, "%d", expr->u.int_value);
+            break;
+        case DOUBLE_EXPRESSION:
+            mrsk_format_double(buf, expr->u.double_value);
+            fputs(buf, fp);
+            break;
+        case STRING_EXPRESSION:
+            dump_string(expr->u.string_expression.string, fp);
+            break;
+        case IDENTIFIER_EXPRESSION:
+            fputs(expr->u.identifier.name, fp);
+            break;
+        case ASSIGN_EXPRESSION:
+            dump_expression(expr->u.assign_expression.left, fp);
+            fputs(" = ", fp);
+            dump_expression(expr->u.assign_expression.operand, fp);
+            break;
+        case ADD_EXPRESSION:
+        case SUB_EXPRESSION:
+        case MUL_EXPRESSION:
+        case DIV_EXPRESSION:
+        case MOD_EXPRESSION:
+        case EQ_EXPRESSION:
+        case NE_EXPRESSION:
+        case GT_EXPRESSION:
+        case GE_EXPRESSION:
+        case LT_EXPRESSION:
+        case LE_EXPRESSION:
+        case LOGICAL_AND_EXPRESSION:
+        case LOGICAL_OR_EXPRESSION:
+            fputc('(', fp);
+            dump_expression(expr->u.binary_expression.left, fp);
+            fprintf(fp, " %s ", mrsk_get_operator_string(expr->type));
+            dump_expression(expr->u.binary_expression.right, fp);
+            fputc(')', fp);
+            break;
+        case MINUS_EXPRESSION:
+            fputc('-', fp);
+            dump_expression(expr->u.minus_expression, fp);
+            break;
+        case FUNCTION_CALL_EXPRESSION:
+            fputs(expr->u.function_call_expression.identifier, fp);
+            dump_argument_list(expr->u.function_call_expression.argument, fp);
+            break;
+        case METHOD_CALL_EXPRESSION:
+            dump_expression(expr->u.method_call_expression.expression, fp);
+            fprintf(fp, ".%s", expr->u.method_call_expression.identifier);
+            dump_argument_list(expr->u.method_call_expression.argument, fp);
+            break;
+        case NONE_EXPRESSION:
+            fputs("None", fp);
+            break;
+        case ARRAY_EXPRESSION:
+            fputc('[', fp);
+            for (pos = expr->u.array_literal; pos; pos = pos->next) {
+                dump_expression(pos->expression, fp);
+                if (pos->next) {
+                    fputs(", ", fp);
+                }
+            }
+            fputc(']', fp);
+            break;
+        case INDEX_EXPRESSION:
+            dump_expression(expr->u.index_expression.array, fp);
+            fputc('[', fp);
+            dump_expression(expr->u.index_expression.index, fp);
+            fputc(']', fp);
+            break;
+        case INCREMENT_EXPRESSION:
+            dump_expression(expr->u.inc_dec.operand, fp);
+            fputs("++", fp);
+            break;
+        case DECREMENT_EXPRESSION:
+            dump_expression(expr->u.inc_dec.operand, fp);
+            fputs("--", fp);
+            break;
+        case MEMBER_EXPRESSION:
+            dump_expression(expr->u.member_expression.expression, fp);
+            fprintf(fp, ".%s", expr->u.member_expression.member_name);
+            break;
+        case INT_ADD_EXPRESSION:
+        case INT_SUB_EXPRESSION:
+        case INT_MUL_EXPRESSION:
+        case INT_EQ_EXPRESSION:
+        case INT_NE_EXPRESSION:
+        case INT_GT_EXPRESSION:
+        case INT_GE_EXPRESSION:
+        case INT_LT_EXPRESSION:
+        case INT_LE_EXPRESSION:
+        case EXPRESSION_TYPE_COUNT_PLUS_1:
+        default:
+            DBG_panic(("bad case. type..%d\n", expr->type));
+    }
+}
+
+static void dump_expression_opt(Expression *expr, FILE *fp)
+{
+    if (expr) {
+        dump_expression(expr, fp);
+    }
+}
+
+static void dump_block(Block *block, int indent, FILE *fp)
+{
+    fputs("{\n", fp);
+    if (block) {
+        dump_statement_list(block->statement_list, indent + 1, fp);
+    }
+    dump_indent(indent, fp);
+    fputc('}', fp);
+}
+
+static void dump_statement(Statement *statement, int indent, FILE *fp)
+{
+    IdentifierList *id_pos;
+    Elif *elif_pos;
+
+    dump_indent(indent, fp);
+    switch (statement->type) {
+        case EXPRESSION_STATEMENT:
+            dump_expression(statement->u.expression_s, fp);
+            fputc(';', fp);
+            break;
+        case GLOBAL_STATEMENT:
+            fputs("global ", fp);
+            for (id_pos = statement->u.global_s.identifier_list; id_pos;
+                 id_pos = id_pos->next) {
+                fputs(id_pos->name, fp);
+                if (id_pos->next) {
+                    fputs(", ", fp);
+                }
+            }
+            fputc(';', fp);
+            break;
+        case IF_STATEMENT:
+            fputs("if (", fp);
+            dump_expression(statement->u.if_s.condition, fp);
+            fputs(") ", fp);
+            dump_block(statement->u.if_s.then_block, indent, fp);
+            for (elif_pos = statement->u.if_s.elif_list; elif_pos;
+                 elif_pos = elif_pos->next) {
+                fputs(" elif (", fp);
+                dump_expression(elif_pos->condition, fp);
+                fputs(") ", fp);
+                dump_block(elif_pos->block, indent, fp);
+            }
+            if (statement->u.if_s.else_block) {
+                fputs(" else ", fp);
+                dump_block(statement->u.if_s.else_block, indent, fp);
+            }
+            break;
+        case WHILE_STATEMENT:
+            fputs("while (", fp);
+            dump_expression(statement->u.while_s.condition, fp);
+            fputs(") ", fp);
+            dump_block(statement->u.while_s.block, indent, fp);
+            break;
+        case FOR_STATEMENT:
+            fputs("for (", fp);
+            dump_expression_opt(statement->u.for_s.init, fp);
+            fputs("; ", fp);
+            dump_expression_opt(statement->u.for_s.condition, fp);
+            fputs("; ", fp);
+            dump_expression_opt(statement->u.for_s.post, fp);
+            fputs(") ", fp);
+            dump_block(statement->u.for_s.block, indent, fp);
+            break;
+        case RETURN_STATEMENT:
+            fputs("return", fp);
+            if (statement->u.return_s.return_value) {
+                fputc(' ', fp);
+                dump_expression(statement->u.return_s.return_value, fp);
+            }
+            fputc(';', fp);
+            break;
+        case BREAK_STATEMENT:
+            fputs("break;", fp);
+            break;
+        case CONTINUE_STATEMENT:
+            fputs("continue;", fp);
+            break;
+        case STATEMENT_TYPE_COUNT_PLUS_1:
+        default:
+            DBG_panic(("bad case...%d", statement->type));
+    }
+    fputc('\n', fp);
+}
+
+static void dump_statement_list(StatementList *list, int indent, FILE *fp)
+{
+    StatementList *pos;
+
+    for (pos = list; pos; pos = pos->next) {
+        dump_statement(pos->statement, indent, fp);
+    }
+}
+
+/*
+ * Prints the tree back as murasaki source, as it stands after
+ * mrsk_optimize_tree(), so the effect of folding can be inspected.
+ */
+void mrsk_dump_tree(MRSK_Interpreter *inter, FILE *fp)
+{
+    FunctionDefinition *pos;
+    ParameterList *param;
+    int i;
+
+    for (pos = inter->function_list; pos; pos = pos->next) {
+        if (pos->type == RECORD_DEFINITION) {
+            fprintf(fp, "struct %s {\n", pos->name);
+            for (i = 0; i < pos->u.record_f.shape.field_count; i++) {
+                dump_indent(1, fp);
+                fprintf(fp, "%s;\n", pos->u.record_f.shape.field[i]);
+            }
+            fputs("}\n", fp);
+            continue;
+        }
+        if (pos->type != MURASAKI_FUNCTION_DEFINITION) {
+            continue;
+        }
+        fprintf(fp, "function %s(", pos->name);
+        for (param = pos->u.murasaki_f.parameter; param;
+             param = param->next) {
+            fputs(param->name, fp);
+            if (param->next) {
+                fputs(", ", fp);
+            }
+        }
+        fputs(") ", fp);
+        dump_block(pos->u.murasaki_f.block, 0, fp);
+        fputc('\n', fp);
+    }
+    dump_statement_list(inter->statement_list, 0, fp);
+}
@@ -74,6 +74,7 @@ static void search_argument(MessageArgument *arg_list,
 static void format_message(MessageFormat *format, VString *v, va_list ap)
 {
     int         i;
+    int         len;
     char        buf[LINE_BUF_SIZE];
     int         arg_name_index;
     char        arg_name[LINE_BUF_SIZE];
@@ -84,7 +85,9 @@ static void format_message(MessageFormat *format, VString *v, va_list ap)
 
     for (i=0; format->format[i]!='\0'; i++) {
         if (format->format[i] != '$') {
-            mrsk_vstr_append_character(v, format->format[i]);
+            len = strcspn(&format->format[i], "$");
+            mrsk_vstr_append_n(v, &format->format[i], len);
+            i += len - 1;
             continue;
         }
         assert(format->format[i+1] == '(');
@@ -98,24 +101,23 @@ static void format_message(MessageFormat *format, VString *v, va_list ap)
         search_argument(arg, arg_name, &cur_arg);
         switch (cur_arg.type) {
             case INT_MESSAGE_ARGUMENT:
-                sprintf(buf, "%d", cur_arg.u.int_val);
-                mrsk_vstr_append_string(v, buf);
+                mrsk_vstr_append_n(v, buf,
+                                   mrsk_format_int(buf, cur_arg.u.int_val));
                 break;
             case DOUBLE_MESSAGE_ARGUMENT:
-                sprintf(buf, "%f", cur_arg.u.double_val);
-                mrsk_vstr_append_string(v, buf);
+                mrsk_vstr_append_n(v, buf,
+                                   mrsk_format_double(buf,
+                                                      cur_arg.u.double_val));
                 break;
             case STRING_MESSAGE_ARGUMENT:
-                strcpy(buf, cur_arg.u.string_val);
                 mrsk_vstr_append_string(v, cur_arg.u.string_val);
                 break;
             case POINTER_MESSAGE_ARGUMENT:
-                sprintf(buf, "%p", cur_arg.u.pointer_val);
-                mrsk_vstr_append_string(v, buf);
+                len = sprintf(buf, "%p", cur_arg.u.pointer_val);
+                mrsk_vstr_append_n(v, buf, len);
                 break;
             case CHARACTER_MESSAGE_ARGUMENT:
-                sprintf(buf, "%c", cur_arg.u.character_val);
-                mrsk_vstr_append_string(v, buf);
+                mrsk_vstr_append_character(v, cur_arg.u.character_val);
                 break;
             case MESSAGE_ARGUMENT_END:
                 assert(0);
@@ -174,6 +176,8 @@ void mrsk_runtime_error(int line_number, RuntimeError id, ...)
 
     self_check();
     va_start(ap, id);
+    line_number = mrsk_resolve_line_number(mrsk_get_current_interpreter(),
+                                           line_number);
     mrsk_vstr_clear(&message);
     format_message(&mrsk_runtime_error_message_format[id],
                    &message, ap);
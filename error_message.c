@@ -6,6 +6,7 @@ MessageFormat mrsk_compile_error_message_format[] = {
     {"在($(token))附近发生语法错误"},
     {"不正确的字符($(bad_char))"},
     {"函数名重复($(name))"},
+    {"结构体$(name)的字段名重复($(field))"},
     {"dummy"},
 };
 
@@ -37,6 +38,23 @@ MessageFormat mrsk_runtime_error_message_format[] = {
     {"对象中不存在名为$(method_name)的成员。"},
     {"请为new_array()函数传入整数类型（数组的大小）。"},
     {"自增/自减的目标值不是整数类型。"},
-    {"数组的resize()必须传入整数类型。"},
+    {"数组的resize()必须传入非负整数。"},
+    {"数组的reserve()必须传入非负整数。"},
+    {"$(name)的元素必须是$(type)类型。"},
+    {"请为$(name)()函数传入非负整数（数组的大小）。"},
+    {"$(name)()函数的参数类型不正确。"},
+    {"不能对空数组调用$(name)()函数。"},
+    {"$(name)()函数指定的范围超出了数组的大小。"},
+    {"$(name)()函数的两个数组大小必须相同。"},
+    {"sort()只能直接对数值或字符串的数组排序，"
+     "其他数组请传入比较函数。"},
+    {"比较函数$(name)()必须返回整数。"},
+    {"排序时比较函数改变了数组的大小。"},
+    {"不能给多维数组的一行整体赋值。"},
+    {"不能改变多维数组中一行的大小。"},
+    {"slice()的范围[$(start), $(end))必须在0到$(size)之间。"},
+    {"map的键必须是整数、实数、字符串或布尔类型。"},
+    {"成员运算符.的左边操作数不是结构体类型。"},
+    {"结构体$(name)中不存在名为$(field)的字段。"},
     {"dummy"},
 };
\ No newline at end of file
@@ -69,12 +69,13 @@ static void eval_double_expression(MRSK_Interpreter *inter, double double_value)
     push_value(inter, &v);
 }
 
-static void eval_string_expression(MRSK_Interpreter *inter, char *string_value)
+static void eval_string_expression(MRSK_Interpreter *inter,
+                                   MRSK_Object *string_object)
 {
     MRSK_Value v;
 
     v.type = MRSK_STRING_VALUE;
-    v.u.object = mrsk_literal_to_mrsk_string(inter, string_value);
+    v.u.object = string_object;
 
     push_value(inter, &v);
 }
@@ -88,61 +89,67 @@ static void eval_none_expression(MRSK_Interpreter *inter)
     push_value(inter, &v);
 }
 
-static Variable * search_global_variable_from_env(MRSK_Interpreter *inter,
-                                                  MRSK_LocalEnvironment *env,
-                                                  char *name)
+/*
+ * Only names that mrsk_fix_tree() could not resolve to a slot come
+ * here.  Inside a function, a global is visible only through a global
+ * statement, and those names are always resolved, so just the local
+ * list is searched.
+ */
+Variable * mrsk_search_variable(MRSK_Interpreter *inter,
+                                MRSK_LocalEnvironment *env, char *identifier)
 {
-    GlobalVariableRef *pos;
-
     if (env == NULL) {
-        return mrsk_search_global_variable(inter, name);
+        return mrsk_search_global_variable(inter, identifier);
     }
 
-    for (pos=env->global_variable; pos; pos=pos->next) {
-        if (!strcmp(pos->variable->name, name)) {
-            return pos->variable;
-        }
-    }
-    return NULL;
+    return mrsk_search_local_variable(env, identifier);
 }
 
 static void eval_identifier_expression(MRSK_Interpreter *inter,
                                        MRSK_LocalEnvironment *env,
                                        Expression *expr)
 {
-    MRSK_Value v;
     Variable *vp;
+    MRSK_Value *slot;
 
-    vp = mrsk_search_local_variable(env, expr->u.identifier);
-    if (vp != NULL) {
-        v = vp->value;
-    } else {
-        vp = search_global_variable_from_env(inter, env, expr->u.identifier);
-        if (vp != NULL) {
-            v = vp->value;
+    if (expr->u.identifier.local_index >= 0
+        || expr->u.identifier.global_index >= 0) {
+        if (expr->u.identifier.local_index >= 0) {
+            slot = &env->frame[expr->u.identifier.local_index];
         } else {
+            slot = &inter->global.variable[expr->u.identifier.global_index]
+                ->value;
+        }
+        if (slot->type == UNDEFINED_VALUE_TYPE) {
             mrsk_runtime_error(expr->line_number, VARIABLE_NOT_FOUND_ERR,
                                STRING_MESSAGE_ARGUMENT,
-                               "name", expr->u.identifier,
+                               "name", expr->u.identifier.name,
                                MESSAGE_ARGUMENT_END);
         }
+        push_value(inter, slot);
+        return;
     }
-    push_value(inter, &v);
+    vp = mrsk_search_variable(inter, env, expr->u.identifier.name);
+    if (vp == NULL) {
+        mrsk_runtime_error(expr->line_number, VARIABLE_NOT_FOUND_ERR,
+                           STRING_MESSAGE_ARGUMENT,
+                           "name", expr->u.identifier.name,
+                           MESSAGE_ARGUMENT_END);
+    }
+    push_value(inter, &vp->value);
 }
 
 static void eval_expression(MRSK_Interpreter *inter, MRSK_LocalEnvironment *env,
                             Expression *expr);
 
-static MRSK_Value * get_identifier_lvalue(MRSK_Interpreter *inter, MRSK_LocalEnvironment *env,
-                                          char *identifier)
+MRSK_Value * mrsk_get_identifier_lvalue(MRSK_Interpreter *inter,
+                                       MRSK_LocalEnvironment *env,
+                                       char *identifier)
 {
     Variable *new_var;
     Variable *left;
 
-    left = mrsk_search_local_variable(env, identifier);
-    if (left == NULL) {
-        left = search_global_variable_from_env(inter, env, identifier);
-    }
+    left = mrsk_search_variable(inter, env, identifier);
     if (left != NULL) {
         return &left->value;
     }
@@ -157,35 +164,346 @@ static MRSK_Value * get_identifier_lvalue(MRSK_Interpreter *inter, MRSK_LocalEnv
     return &left->value;
 }
 
-MRSK_Value * get_array_element_lvalue(MRSK_Interpreter *inter, MRSK_LocalEnvironment *env,
-                                      Expression *expr)
+static void check_index(MRSK_Value *index, int size, int line_number)
+{
+    if (index->type != MRSK_INT_VALUE) {
+        mrsk_runtime_error(line_number, INDEX_OPERAND_NOT_INT_ERR,
+                           MESSAGE_ARGUMENT_END);
+    }
+    if (index->u.int_value < 0 || index->u.int_value >= size) {
+        mrsk_runtime_error(line_number, ARRAY_INDEX_OUT_OF_BOUNDS_ERR,
+                           INT_MESSAGE_ARGUMENT, "size", size,
+                           INT_MESSAGE_ARGUMENT, "index", index->u.int_value,
+                           MESSAGE_ARGUMENT_END);
+    }
+}
+
+static MRSK_Object * check_array_index(MRSK_Value *array, MRSK_Value *index,
+                                       int line_number)
 {
-    MRSK_Value array;
-    MRSK_Value index;
+    MRSK_Object *obj;
 
-    eval_expression(inter, env, expr->u.index_expression.array);
-    eval_expression(inter, env, expr->u.index_expression.index);
-    index = pop_value(inter);
-    array = pop_value(inter);
+    if (array->type != MRSK_ARRAY_VALUE) {
+        mrsk_runtime_error(line_number, INDEX_OPERAND_NOT_ARRAY_ERR,
+                           MESSAGE_ARGUMENT_END);
+    }
+    obj = array->u.object;
+    if (obj->type == MULTI_ARRAY_OBJECT) {
+        check_index(index, obj->u.multi_array.dim[0], line_number);
+    } else {
+        check_index(index, obj->u.array.size, line_number);
+    }
+
+    return obj;
+}
+
+/* The offset in element of the first index_count (<= rank) subscripts. */
+static int multi_array_offset(MRSK_Object *obj, int index_count,
+                              MRSK_Value *index, int line_number)
+{
+    MRSK_MultiArray *multi = &obj->u.multi_array;
+    int offset = 0;
+    int i;
+
+    for (i = 0; i < index_count; i++) {
+        check_index(&index[i], multi->dim[i], line_number);
+        offset += index[i].u.int_value * multi->stride[i];
+    }
+    return offset;
+}
+
+static MRSK_Value multi_array_subscript(MRSK_Interpreter *inter,
+                                        MRSK_Object *obj, int index_count,
+                                        MRSK_Value *index, int line_number)
+{
+    MRSK_Value ret;
+    int offset;
+
+    offset = multi_array_offset(obj, index_count, index, line_number);
+    if (index_count == obj->u.multi_array.rank) {
+        return obj->u.multi_array.element[offset];
+    }
+    ret.type = MRSK_ARRAY_VALUE;
+    ret.u.object = mrsk_create_multi_array_view(inter, obj, index_count,
+                                                offset);
+    return ret;
+}
+
+/*
+ * Elements are read and written by value rather than through an lvalue
+ * pointer, as a typed array has no MRSK_Value to point at.  A subscript
+ * on a multi dimensional array reads a row as a view.  A map is indexed
+ * by key, and reads None for a key it doesn't have.
+ */
+MRSK_Value mrsk_get_array_element(MRSK_Interpreter *inter,
+                                  MRSK_Value *array, MRSK_Value *index,
+                                  int line_number)
+{
+    MRSK_Object *obj;
+    MRSK_Value *v;
+    MRSK_Value ret;
+
+    if (array->type == MRSK_MAP_VALUE) {
+        v = mrsk_map_search(array->u.object, index, line_number);
+        if (v) {
+            return *v;
+        }
+        ret.type = MRSK_NONE_VALUE;
+        return ret;
+    }
+    obj = check_array_index(array, index, line_number);
+    if (obj->type == MULTI_ARRAY_OBJECT) {
+        return multi_array_subscript(inter, obj, 1, index, line_number);
+    }
+
+    return mrsk_fetch_array_element(obj, index->u.int_value);
+}
+
+void mrsk_set_array_element(MRSK_Interpreter *inter, MRSK_Value *array,
+                            MRSK_Value *index, MRSK_Value *value,
+                            int line_number)
+{
+    MRSK_Object *obj;
 
-    if (array.type != MRSK_ARRAY_VALUE) {
-        mrsk_runtime_error(expr->line_number, INDEX_OPERAND_NOT_ARRAY_ERR,
+    if (array->type == MRSK_MAP_VALUE) {
+        mrsk_map_set(inter, array->u.object, index, value, line_number);
+        return;
+    }
+    obj = check_array_index(array, index, line_number);
+    if (obj->type == MULTI_ARRAY_OBJECT) {
+        mrsk_runtime_error(line_number, MULTI_ARRAY_ROW_ASSIGN_ERR,
                            MESSAGE_ARGUMENT_END);
     }
-    if (index.type != MRSK_INT_VALUE) {
-        mrsk_runtime_error(expr->line_number, INDEX_OPERAND_NOT_INT_ERR,
+    mrsk_array_unshare(inter, obj);
+    mrsk_store_array_element(inter, obj, index->u.int_value, value,
+                             line_number);
+}
+
+static MRSK_Value inc_dec_value(MRSK_Value *dest, int increment,
+                                int line_number)
+{
+    MRSK_Value ret;
+
+    if (dest->type != MRSK_INT_VALUE) {
+        mrsk_runtime_error(line_number, INC_DEC_OPERAND_TYPE_ERR,
                            MESSAGE_ARGUMENT_END);
     }
+    ret = *dest;
+    dest->u.int_value += increment;
+
+    return ret;
+}
 
-    if (index.u.int_value < 0
-        || index.u.int_value >= array.u.object->u.array.size) {
-        mrsk_runtime_error(expr->line_number, ARRAY_INDEX_OUT_OF_BOUNDS_ERR,
-                           INT_MESSAGE_ARGUMENT,
-                           "size", array.u.object->u.array.size,
-                           INT_MESSAGE_ARGUMENT, "index", index.u.int_value,
+/* Returns the element's old value, as the postfix operators do. */
+MRSK_Value mrsk_inc_dec_array_element(MRSK_Interpreter *inter,
+                                      MRSK_Value *array, MRSK_Value *index,
+                                      int increment, int line_number)
+{
+    MRSK_Object *obj;
+    MRSK_Value *v;
+    MRSK_Value ret;
+
+    if (array->type == MRSK_MAP_VALUE) {
+        v = mrsk_map_search(array->u.object, index, line_number);
+        if (v == NULL) {
+            mrsk_runtime_error(line_number, INC_DEC_OPERAND_TYPE_ERR,
+                               MESSAGE_ARGUMENT_END);
+        }
+        return inc_dec_value(v, increment, line_number);
+    }
+    obj = check_array_index(array, index, line_number);
+    if (obj->type == ARRAY_OBJECT || obj->type == INT_ARRAY_OBJECT) {
+        mrsk_array_unshare(inter, obj);
+    }
+    if (obj->type == INT_ARRAY_OBJECT) {
+        ret.type = MRSK_INT_VALUE;
+        ret.u.int_value = obj->u.array.array.int_value[index->u.int_value];
+        obj->u.array.array.int_value[index->u.int_value] += increment;
+        return ret;
+    }
+    if (obj->type != ARRAY_OBJECT) {
+        mrsk_runtime_error(line_number, INC_DEC_OPERAND_TYPE_ERR,
                            MESSAGE_ARGUMENT_END);
     }
-    return &array.u.object->u.array.array[index.u.int_value];
+
+    return inc_dec_value(&obj->u.array.array.value[index->u.int_value],
+                         increment, line_number);
+}
+
+/*
+ * a[i][j]... with index_count subscripts.  All but the last are applied
+ * to array here, a multi dimensional array taking as many as it has
+ * dimensions at once, so no row view is made on the way.  If that lands
+ * on an element of a multi dimensional array, its slot is returned;
+ * otherwise *container is what the last subscript applies to.
+ */
+static MRSK_Value * walk_index_chain(MRSK_Interpreter *inter,
+                                     MRSK_Value *array, int index_count,
+                                     MRSK_Value *index, int line_number,
+                                     MRSK_Value *container)
+{
+    MRSK_Object *obj;
+    int rank;
+    int count;
+    int i;
+
+    *container = *array;
+    for (i = 0; i < index_count - 1; ) {
+        obj = container->u.object;
+        if (container->type != MRSK_ARRAY_VALUE
+            || obj->type != MULTI_ARRAY_OBJECT) {
+            *container = mrsk_get_array_element(inter, container, &index[i],
+                                                line_number);
+            i++;
+            continue;
+        }
+        rank = obj->u.multi_array.rank;
+        if (rank == index_count - i) {
+            return &obj->u.multi_array.element
+                [multi_array_offset(obj, rank, &index[i], line_number)];
+        }
+        count = rank < index_count - 1 - i ? rank : index_count - 1 - i;
+        *container = multi_array_subscript(inter, obj, count, &index[i],
+                                           line_number);
+        i += count;
+    }
+
+    return NULL;
+}
+
+MRSK_Value mrsk_get_array_element_n(MRSK_Interpreter *inter,
+                                    MRSK_Value *array, int index_count,
+                                    MRSK_Value *index, int line_number)
+{
+    MRSK_Value container;
+    MRSK_Value *slot;
+
+    slot = walk_index_chain(inter, array, index_count, index, line_number,
+                            &container);
+    if (slot) {
+        return *slot;
+    }
+    return mrsk_get_array_element(inter, &container, &index[index_count-1],
+                                  line_number);
+}
+
+void mrsk_set_array_element_n(MRSK_Interpreter *inter, MRSK_Value *array,
+                              int index_count, MRSK_Value *index,
+                              MRSK_Value *value, int line_number)
+{
+    MRSK_Value container;
+    MRSK_Object *multi;
+    MRSK_Value *slot;
+
+    slot = walk_index_chain(inter, array, index_count, index, line_number,
+                            &container);
+    if (slot) {
+        multi = container.u.object;
+        mrsk_write_barrier(inter, multi->u.multi_array.owner
+                           ? multi->u.multi_array.owner : multi, slot, value);
+        *slot = *value;
+        return;
+    }
+    mrsk_set_array_element(inter, &container, &index[index_count-1], value,
+                           line_number);
+}
+
+MRSK_Value mrsk_inc_dec_array_element_n(MRSK_Interpreter *inter,
+                                        MRSK_Value *array, int index_count,
+                                        MRSK_Value *index, int increment,
+                                        int line_number)
+{
+    MRSK_Value container;
+    MRSK_Value *slot;
+
+    slot = walk_index_chain(inter, array, index_count, index, line_number,
+                            &container);
+    if (slot) {
+        return inc_dec_value(slot, increment, line_number);
+    }
+    return mrsk_inc_dec_array_element(inter, &container,
+                                      &index[index_count-1],
+                                      increment, line_number);
+}
+
+/*
+ * The field name of record.  slot, from mrsk_fix_tree(), is only a
+ * guess, so it is used if record's shape agrees and the fields are
+ * searched by name otherwise.
+ */
+MRSK_Value * mrsk_get_field(MRSK_Value *record, char *name, int slot,
+                            int line_number)
+{
+    RecordShape *shape;
+    int i;
+
+    if (record->type != MRSK_RECORD_VALUE) {
+        mrsk_runtime_error(line_number, MEMBER_OPERAND_NOT_RECORD_ERR,
+                           MESSAGE_ARGUMENT_END);
+    }
+    shape = record->u.object->u.record.shape;
+    if (slot >= 0 && slot < shape->field_count
+        && shape->field[slot] == name) {
+        return &record->u.object->u.record.field[slot];
+    }
+    for (i = 0; i < shape->field_count; i++) {
+        if (shape->field[i] == name) {
+            return &record->u.object->u.record.field[i];
+        }
+    }
+    mrsk_runtime_error(line_number, NO_SUCH_FIELD_ERR,
+                       STRING_MESSAGE_ARGUMENT, "name", shape->name,
+                       STRING_MESSAGE_ARGUMENT, "field", name,
+                       MESSAGE_ARGUMENT_END);
+    return NULL;
+}
+
+/*
+ * args are the fields in order.  They must be where the collector can
+ * see them (on the stack), as creating the record may collect.
+ */
+MRSK_Value mrsk_construct_record(MRSK_Interpreter *inter, RecordShape *shape,
+                                 int arg_count, MRSK_Value *args,
+                                 int line_number)
+{
+    MRSK_Value ret;
+    int i;
+
+    if (arg_count > shape->field_count) {
+        mrsk_runtime_error(line_number, ARGUMENT_TOO_MANY_ERR,
+                           MESSAGE_ARGUMENT_END);
+    } else if (arg_count < shape->field_count) {
+        mrsk_runtime_error(line_number, ARGUMENT_TOO_FEW_ERR,
+                           MESSAGE_ARGUMENT_END);
+    }
+    ret.type = MRSK_RECORD_VALUE;
+    ret.u.object = mrsk_create_record_i(inter, shape);
+    for (i = 0; i < arg_count; i++) {
+        ret.u.object->u.record.field[i] = args[i];
+    }
+
+    return ret;
+}
+
+/*
+ * Evaluates the array of a chain of subscripts and then each subscript,
+ * leaving them all on the stack; returns the number of subscripts.
+ */
+static int eval_index_operands(MRSK_Interpreter *inter,
+                               MRSK_LocalEnvironment *env, Expression *expr)
+{
+    int count;
+
+    if (expr->u.index_expression.array->type == INDEX_EXPRESSION) {
+        count = eval_index_operands(inter, env,
+                                    expr->u.index_expression.array);
+    } else {
+        eval_expression(inter, env, expr->u.index_expression.array);
+        count = 0;
+    }
+    eval_expression(inter, env, expr->u.index_expression.index);
+
+    return count + 1;
 }
 
 MRSK_Value * get_lvalue(MRSK_Interpreter *inter, MRSK_LocalEnvironment *env,
@@ -193,10 +511,24 @@ MRSK_Value * get_lvalue(MRSK_Interpreter *inter, MRSK_LocalEnvironment *env,
 {
     MRSK_Value *dest;
 
-    if (expr->type == IDENTIFIER_EXPRESSION) {
-        dest = get_identifier_lvalue(inter, env, expr->u.identifier);
-    } else if (expr->type == INDEX_EXPRESSION) {
-        dest = get_array_element_lvalue(inter, env, expr);
+    if (expr->type == IDENTIFIER_EXPRESSION
+        && expr->u.identifier.local_index >= 0) {
+        dest = &env->frame[expr->u.identifier.local_index];
+    } else if (expr->type == IDENTIFIER_EXPRESSION
+               && expr->u.identifier.global_index >= 0) {
+        dest = &inter->global.variable[expr->u.identifier.global_index]
+            ->value;
+    } else if (expr->type == IDENTIFIER_EXPRESSION) {
+        dest = mrsk_get_identifier_lvalue(inter, env,
+                                          expr->u.identifier.name);
+    } else if (expr->type == MEMBER_EXPRESSION) {
+        /* the record may be popped, as nothing collects before the store */
+        eval_expression(inter, env, expr->u.member_expression.expression);
+        dest = mrsk_get_field(peek_stack(inter, 0),
+                              expr->u.member_expression.member_name,
+                              expr->u.member_expression.slot,
+                              expr->line_number);
+        shrink_stack(inter, 1);
     } else {
         mrsk_runtime_error(expr->line_number, NOT_LVALUE_ERR,
                            MESSAGE_ARGUMENT_END);
@@ -210,10 +542,32 @@ static void eval_assign_expression(MRSK_Interpreter *inter, MRSK_LocalEnvironmen
 {
     MRSK_Value *src;
     MRSK_Value *dest;
+    MRSK_Value *record;
+    int count;
 
     eval_expression(inter, env, expression);
-    src = peek_stack(inter, 0);
 
+    if (left->type == INDEX_EXPRESSION) {
+        count = eval_index_operands(inter, env, left);
+        src = peek_stack(inter, count + 1);
+        mrsk_set_array_element_n(inter, src + 1, count, src + 2, src,
+                                 left->line_number);
+        shrink_stack(inter, count + 1);
+        return;
+    }
+    if (left->type == MEMBER_EXPRESSION) {
+        eval_expression(inter, env, left->u.member_expression.expression);
+        record = peek_stack(inter, 0);
+        src = peek_stack(inter, 1);
+        dest = mrsk_get_field(record, left->u.member_expression.member_name,
+                              left->u.member_expression.slot,
+                              left->line_number);
+        mrsk_write_barrier(inter, record->u.object, dest, src);
+        *dest = *src;
+        shrink_stack(inter, 1);
+        return;
+    }
+    src = peek_stack(inter, 0);
     dest = get_lvalue(inter, env, left);
     *dest = *src;
 }
@@ -291,6 +645,16 @@ static void eval_binary_int(MRSK_Interpreter *inter, ExpressionType operator,
         case INDEX_EXPRESSION:
         case INCREMENT_EXPRESSION:
         case DECREMENT_EXPRESSION:
+        case MEMBER_EXPRESSION:
+        case INT_ADD_EXPRESSION:
+        case INT_SUB_EXPRESSION:
+        case INT_MUL_EXPRESSION:
+        case INT_EQ_EXPRESSION:
+        case INT_NE_EXPRESSION:
+        case INT_GT_EXPRESSION:
+        case INT_GE_EXPRESSION:
+        case INT_LT_EXPRESSION:
+        case INT_LE_EXPRESSION:
         case EXPRESSION_TYPE_COUNT_PLUS_1:
         default:
             DBG_panic(("bad case...%d", operator));
@@ -352,6 +716,16 @@ static void eval_binary_double(MRSK_Interpreter *inter, ExpressionType operator,
         case INDEX_EXPRESSION:
         case INCREMENT_EXPRESSION:
         case DECREMENT_EXPRESSION:
+        case MEMBER_EXPRESSION:
+        case INT_ADD_EXPRESSION:
+        case INT_SUB_EXPRESSION:
+        case INT_MUL_EXPRESSION:
+        case INT_EQ_EXPRESSION:
+        case INT_NE_EXPRESSION:
+        case INT_GT_EXPRESSION:
+        case INT_GE_EXPRESSION:
+        case INT_LT_EXPRESSION:
+        case INT_LE_EXPRESSION:
         case EXPRESSION_TYPE_COUNT_PLUS_1:
         default:
             DBG_panic(("bad default...%d", operator));
@@ -365,13 +739,14 @@ static MRSK_Boolean eval_compare_string(ExpressionType operator,
     MRSK_Boolean result;
     int cmp;
 
-    cmp = strcmp(left->u.object->u.string.string, right->u.object->u.string.string);
-
     if (operator == EQ_EXPRESSION) {
-        result = (cmp == 0);
+        return mrsk_string_equals(left->u.object, right->u.object);
     } else if (operator == NE_EXPRESSION) {
-        result = (cmp != 0);
-    } else if (operator == GT_EXPRESSION) {
+        return !mrsk_string_equals(left->u.object, right->u.object);
+    }
+    cmp = mrsk_compare_string(left->u.object, right->u.object);
+
+    if (operator == GT_EXPRESSION) {
         result = (cmp > 0);
     } else if (operator == GE_EXPRESSION) {
         result = (cmp >= 0);
@@ -416,101 +791,207 @@ static MRSK_Boolean eval_binary_null(MRSK_Interpreter *inter,
 void chain_string(MRSK_Interpreter *inter, MRSK_Value *left,
                   MRSK_Value *right, MRSK_Value *result)
 {
+    char buf[NUMBER_FORMAT_BUF_SIZE];
     char *right_str;
-    MRSK_Object *right_obj;
-    int len;
-    char *str;
-
-    right_str = MRSK_value_to_string(right);
-    right_obj = mrsk_create_murasaki_string_i(inter, right_str);
 
     result->type = MRSK_STRING_VALUE;
-    len = strlen(left->u.object->u.string.string)
-        + strlen(right_obj->u.string.string);
-    str = MEM_malloc(len + 1);
-    strcpy(str, left->u.object->u.string.string);
-    strcat(str, right_obj->u.string.string);
-    result->u.object = mrsk_create_murasaki_string_i(inter, str);
+    if (right->type == MRSK_STRING_VALUE) {
+        result->u.object
+            = mrsk_chain_string(inter, left->u.object,
+                                right->u.object->u.string.string,
+                                right->u.object->u.string.length);
+    } else if (right->type == MRSK_INT_VALUE) {
+        result->u.object
+            = mrsk_chain_string(inter, left->u.object, buf,
+                                mrsk_format_int(buf, right->u.int_value));
+    } else if (right->type == MRSK_DOUBLE_VALUE) {
+        result->u.object
+            = mrsk_chain_string(inter, left->u.object, buf,
+                                mrsk_format_double(buf,
+                                                   right->u.double_value));
+    } else {
+        right_str = MRSK_value_to_string(right);
+        result->u.object = mrsk_chain_string(inter, left->u.object,
+                                             right_str, strlen(right_str));
+        MEM_free(right_str);
+    }
 }
 
 
-static void eval_binary_expression(MRSK_Interpreter *inter,
-                                   MRSK_LocalEnvironment *env,
-                                   ExpressionType operator,
-                                   Expression *left, Expression *right)
+void mrsk_binary_operation(MRSK_Interpreter *inter, ExpressionType operator,
+                           MRSK_Value *left_val, MRSK_Value *right_val,
+                           MRSK_Value *result, int line_number)
 {
-    MRSK_Value *left_val;
-    MRSK_Value *right_val;
-    MRSK_Value result;
-
-    eval_expression(inter, env, left);
-    eval_expression(inter, env, right);
-    left_val = peek_stack(inter, 1);
-    right_val = peek_stack(inter, 0);
-
     if (left_val->type == MRSK_INT_VALUE
         && right_val->type == MRSK_INT_VALUE) {
         eval_binary_int(inter, operator,
                         left_val->u.int_value, right_val->u.int_value,
-                        &result, left->line_number);
+                        result, line_number);
     } else if (left_val->type == MRSK_DOUBLE_VALUE
                && right_val->type == MRSK_DOUBLE_VALUE) {
         eval_binary_double(inter, operator,
                            left_val->u.double_value, right_val->u.double_value,
-                           &result, left->line_number);
+                           result, line_number);
     } else if (left_val->type == MRSK_INT_VALUE
                && right_val->type == MRSK_DOUBLE_VALUE) {
         eval_binary_double(inter, operator,
                            (double)left_val->u.int_value,
                            right_val->u.double_value,
-                           &result, left->line_number);
+                           result, line_number);
     } else if (left_val->type == MRSK_DOUBLE_VALUE
                && right_val->type == MRSK_INT_VALUE) {
         eval_binary_double(inter, operator,
                            left_val->u.double_value,
                            (double)right_val->u.int_value,
-                           &result, left->line_number);
+                           result, line_number);
     } else if (left_val->type == MRSK_BOOLEAN_VALUE
                && right_val->type == MRSK_BOOLEAN_VALUE) {
-        result.type = MRSK_BOOLEAN_VALUE;
-        result.u.boolean_value
+        result->type = MRSK_BOOLEAN_VALUE;
+        result->u.boolean_value
             = eval_binary_boolean(inter, operator,
                                   left_val->u.boolean_value,
                                   right_val->u.boolean_value,
-                                  left->line_number);
+                                  line_number);
     } else if (left_val->type == MRSK_STRING_VALUE
                && operator == ADD_EXPRESSION) {
-        chain_string(inter, left_val, right_val, &result);
+        chain_string(inter, left_val, right_val, result);
     } else if (left_val->type == MRSK_STRING_VALUE
                && right_val->type == MRSK_STRING_VALUE) {
-        result.type = MRSK_BOOLEAN_VALUE;
-        result.u.boolean_value
+        result->type = MRSK_BOOLEAN_VALUE;
+        result->u.boolean_value
             = eval_compare_string(operator, left_val, right_val,
-                                  left->line_number);
+                                  line_number);
     } else if (left_val->type == MRSK_NONE_VALUE
                || right_val->type == MRSK_NONE_VALUE) {
-        result.type = MRSK_BOOLEAN_VALUE;
-        result.u.boolean_value
+        result->type = MRSK_BOOLEAN_VALUE;
+        result->u.boolean_value
             = eval_binary_null(inter, operator, left_val, right_val,
-                               left->line_number);
+                               line_number);
     } else {
         char *op_str = mrsk_get_operator_string(operator);
-        mrsk_runtime_error(left->line_number, BAD_OPERAND_TYPE_ERR,
+        mrsk_runtime_error(line_number, BAD_OPERAND_TYPE_ERR,
                            STRING_MESSAGE_ARGUMENT, "operator", op_str,
                            MESSAGE_ARGUMENT_END);
     }
+}
+
+static struct {
+    ExpressionType generic;
+    ExpressionType quickened;
+} st_quickening_table[] = {
+    {ADD_EXPRESSION, INT_ADD_EXPRESSION},
+    {SUB_EXPRESSION, INT_SUB_EXPRESSION},
+    {MUL_EXPRESSION, INT_MUL_EXPRESSION},
+    {EQ_EXPRESSION, INT_EQ_EXPRESSION},
+    {NE_EXPRESSION, INT_NE_EXPRESSION},
+    {GT_EXPRESSION, INT_GT_EXPRESSION},
+    {GE_EXPRESSION, INT_GE_EXPRESSION},
+    {LT_EXPRESSION, INT_LT_EXPRESSION},
+    {LE_EXPRESSION, INT_LE_EXPRESSION},
+};
+
+#define QUICKENING_TABLE_SIZE \
+    (sizeof(st_quickening_table) / sizeof(st_quickening_table[0]))
+
+/*
+ * Once both operands of a binary node have been seen to be ints, the
+ * node is rewritten to its INT_xxx form, which skips the type dispatch
+ * of mrsk_binary_operation().  If it then sees anything else it goes
+ * back to the generic form for good.
+ *
+ * A node may be rewritten by a recursive evaluation of itself while its
+ * operands are evaluated, so callers decide on the operator they read
+ * before evaluating the operands.
+ */
+static void quicken_binary_expression(Expression *expr,
+                                      ExpressionType operator)
+{
+    int i;
+
+    for (i = 0; i < QUICKENING_TABLE_SIZE; i++) {
+        if (st_quickening_table[i].generic == operator) {
+            expr->type = st_quickening_table[i].quickened;
+            return;
+        }
+    }
+}
+
+static ExpressionType deoptimize_binary_expression(Expression *expr,
+                                                   ExpressionType quickened)
+{
+    int i;
+
+    for (i = 0; i < QUICKENING_TABLE_SIZE; i++) {
+        if (st_quickening_table[i].quickened == quickened) {
+            expr->type = st_quickening_table[i].generic;
+            expr->u.binary_expression.quickening_failed = MRSK_TRUE;
+            return expr->type;
+        }
+    }
+    DBG_panic(("bad expression type..%d\n", quickened));
+    return quickened;
+}
+
+static void eval_binary_expression(MRSK_Interpreter *inter,
+                                   MRSK_LocalEnvironment *env,
+                                   Expression *expr)
+{
+    MRSK_Value *left_val;
+    MRSK_Value *right_val;
+    MRSK_Value result;
+    ExpressionType operator = expr->type;
+    Expression *left = expr->u.binary_expression.left;
+
+    eval_expression(inter, env, left);
+    eval_expression(inter, env, expr->u.binary_expression.right);
+    left_val = peek_stack(inter, 1);
+    right_val = peek_stack(inter, 0);
+
+    mrsk_binary_operation(inter, operator, left_val, right_val, &result,
+                          left->line_number);
+    if (left_val->type == MRSK_INT_VALUE
+        && right_val->type == MRSK_INT_VALUE
+        && !expr->u.binary_expression.quickening_failed) {
+        quicken_binary_expression(expr, operator);
+    }
     pop_value(inter);
     pop_value(inter);
     push_value(inter, &result);
 }
 
-MRSK_Value mrsk_eval_binary_expression(MRSK_Interpreter *inter,
-                                       MRSK_LocalEnvironment *env,
-                                       ExpressionType operator,
-                                       Expression *left, Expression *right)
+/*
+ * Evaluates the operands of a quickened node.  Returns MRSK_TRUE with
+ * both ints popped into *left and *right, or deoptimizes the node,
+ * pushes the generic result and returns MRSK_FALSE.
+ */
+static MRSK_Boolean eval_int_operands(MRSK_Interpreter *inter,
+                                      MRSK_LocalEnvironment *env,
+                                      Expression *expr, int *left, int *right)
 {
-    eval_binary_expression(inter, env, operator, left, right);
-    return pop_value(inter);
+    MRSK_Value *left_val;
+    MRSK_Value *right_val;
+    MRSK_Value result;
+    ExpressionType operator = expr->type;
+
+    eval_expression(inter, env, expr->u.binary_expression.left);
+    eval_expression(inter, env, expr->u.binary_expression.right);
+    left_val = peek_stack(inter, 1);
+    right_val = peek_stack(inter, 0);
+
+    if (left_val->type == MRSK_INT_VALUE
+        && right_val->type == MRSK_INT_VALUE) {
+        *left = left_val->u.int_value;
+        *right = right_val->u.int_value;
+        shrink_stack(inter, 2);
+        return MRSK_TRUE;
+    }
+    operator = deoptimize_binary_expression(expr, operator);
+    mrsk_binary_operation(inter, operator, left_val, right_val, &result,
+                          expr->u.binary_expression.left->line_number);
+    shrink_stack(inter, 2);
+    push_value(inter, &result);
+
+    return MRSK_FALSE;
 }
 
 static void eval_logical_and_or_expression(MRSK_Interpreter *inter,
@@ -576,23 +1057,74 @@ static void eval_minus_expression(MRSK_Interpreter *inter,
     push_value(inter, &result);
 }
 
+static CallFrameChunk *alloc_frame_chunk(CallFrameChunk *prev,
+                                         int value_alloc_size)
+{
+    CallFrameChunk *chunk;
+
+    chunk = MEM_malloc(sizeof(CallFrameChunk));
+    chunk->environment_alloc_size = FRAME_CHUNK_ENVIRONMENT_SIZE;
+    chunk->environment_count = 0;
+    chunk->environment = MEM_malloc(sizeof(MRSK_LocalEnvironment)
+                                    * FRAME_CHUNK_ENVIRONMENT_SIZE);
+    chunk->value_alloc_size = value_alloc_size;
+    chunk->value_count = 0;
+    chunk->value = MEM_malloc(sizeof(MRSK_Value) * value_alloc_size);
+    chunk->prev = prev;
+    chunk->next = NULL;
+
+    return chunk;
+}
 
-MRSK_Value mrsk_eval_minus_expression(MRSK_Interpreter *inter,
-                                      MRSK_LocalEnvironment *env,
-                                      Expression *operand)
+/* Returns a chunk with room for one more environment of frame_size. */
+static CallFrameChunk *reserve_frame(CallFrameStack *fs, int frame_size)
 {
-    eval_minus_expression(inter, env, operand);
-    return pop_value(inter);
+    CallFrameChunk *chunk = fs->current;
+    CallFrameChunk *next;
+
+    if (chunk
+        && chunk->environment_count < chunk->environment_alloc_size
+        && chunk->value_count + frame_size <= chunk->value_alloc_size) {
+        return chunk;
+    }
+    next = chunk ? chunk->next : fs->first;
+    if (next == NULL) {
+        next = alloc_frame_chunk(chunk,
+                                 larger(frame_size, FRAME_CHUNK_VALUE_SIZE));
+        if (chunk) {
+            chunk->next = next;
+        } else {
+            fs->first = next;
+        }
+    } else if (next->value_alloc_size < frame_size) {
+        /* an unused chunk holds no live frame, so it may move */
+        next->value = MEM_realloc(next->value,
+                                  sizeof(MRSK_Value) * frame_size);
+        next->value_alloc_size = frame_size;
+    }
+    fs->current = next;
+
+    return next;
 }
 
-static MRSK_LocalEnvironment * alloc_local_environment(MRSK_Interpreter *inter)
+MRSK_LocalEnvironment * mrsk_alloc_local_environment(MRSK_Interpreter *inter,
+                                                    int frame_size)
 {
+    CallFrameChunk *chunk;
     MRSK_LocalEnvironment *ret;
+    int i;
 
-    ret = MEM_malloc(sizeof(MRSK_LocalEnvironment));
+    chunk = reserve_frame(&inter->frame_stack, frame_size);
+    ret = &chunk->environment[chunk->environment_count];
+    chunk->environment_count++;
+    ret->frame_size = frame_size;
+    ret->frame = &chunk->value[chunk->value_count];
+    chunk->value_count += frame_size;
+    for (i = 0; i < frame_size; i++) {
+        ret->frame[i].type = UNDEFINED_VALUE_TYPE;
+    }
     ret->variable = NULL;
-    ret->global_variable = NULL;
-    ret->ref_in_native_method = NULL;
+    ret->ref_base = inter->frame_stack.ref_count;
 
     ret->next = inter->top_environment;
     inter->top_environment = ret;
@@ -600,20 +1132,10 @@ static MRSK_LocalEnvironment * alloc_local_environment(MRSK_Interpreter *inter)
     return ret;
 }
 
-static void dispose_ref_in_native_method(MRSK_LocalEnvironment *env)
-{
-    RefInNativeFunc *ref;
-
-    while (env->ref_in_native_method) {
-        ref = env->ref_in_native_method;
-        env->ref_in_native_method = ref->next;
-        MEM_free(ref);
-    }
-}
-
-static void dispose_local_environment(MRSK_Interpreter *inter)
+void mrsk_dispose_local_environment(MRSK_Interpreter *inter)
 {
     MRSK_LocalEnvironment *env = inter->top_environment;
+    CallFrameChunk *chunk = inter->frame_stack.current;
 
     while (env->variable) {
         Variable *temp;
@@ -621,16 +1143,30 @@ static void dispose_local_environment(MRSK_Interpreter *inter)
         env->variable = temp->next;
         MEM_free(temp);
     }
-    while (env->global_variable) {
-        GlobalVariableRef *ref;
-        ref = env->global_variable;
-        env->global_variable = ref->next;
-        MEM_free(ref);
-    }
-    dispose_ref_in_native_method(env);
+    inter->frame_stack.ref_count = env->ref_base;
 
     inter->top_environment = env->next;
-    MEM_free(env);
+    chunk->environment_count--;
+    chunk->value_count -= env->frame_size;
+    if (chunk->environment_count == 0 && chunk->prev) {
+        inter->frame_stack.current = chunk->prev;
+    }
+}
+
+void mrsk_dispose_frame_stack(MRSK_Interpreter *inter)
+{
+    CallFrameChunk *chunk;
+
+    while (inter->frame_stack.first) {
+        chunk = inter->frame_stack.first;
+        inter->frame_stack.first = chunk->next;
+        MEM_free(chunk->environment);
+        MEM_free(chunk->value);
+        MEM_free(chunk);
+    }
+    inter->frame_stack.current = NULL;
+    MEM_free(inter->frame_stack.ref);
+    inter->frame_stack.ref = NULL;
 }
 
 static void call_native_function(MRSK_Interpreter *inter,
@@ -664,25 +1200,19 @@ static void call_murasaki_function(MRSK_Interpreter *inter,
     MRSK_Value value;
     StatementResult result;
     ArgumentList *arg_p;
-    ParameterList *param_p;
+    int arg_count;
 
-    for (arg_p=expr->u.function_call_expression.argument,
-         param_p=func->u.murasaki_f.parameter;
+    for (arg_p=expr->u.function_call_expression.argument, arg_count=0;
          arg_p;
-         arg_p=arg_p->next, param_p=param_p->next) {
-        Variable *new_var;
-        MRSK_Value arg_val;
-
-        if (param_p == NULL) {
+         arg_p=arg_p->next, arg_count++) {
+        if (arg_count >= func->u.murasaki_f.parameter_count) {
             mrsk_runtime_error(expr->line_number, ARGUMENT_TOO_MANY_ERR,
                                MESSAGE_ARGUMENT_END);
         }
         eval_expression(inter, caller_env, arg_p->expression);
-        arg_val = pop_value(inter);
-        new_var = mrsk_add_local_variable(env, param_p->name);
-        new_var->value = arg_val;
+        env->frame[arg_count] = pop_value(inter);
     }
-    if (param_p) {
+    if (arg_count < func->u.murasaki_f.parameter_count) {
         mrsk_runtime_error(expr->line_number, ARGUMENT_TOO_FEW_ERR,
                            MESSAGE_ARGUMENT_END);
     }
@@ -698,6 +1228,29 @@ static void call_murasaki_function(MRSK_Interpreter *inter,
 }
 
 
+static void call_record_constructor(MRSK_Interpreter *inter,
+                                    MRSK_LocalEnvironment *caller_env,
+                                    Expression *expr, RecordShape *shape)
+{
+    MRSK_Value value;
+    int arg_count;
+    ArgumentList *arg_p;
+
+    for (arg_count=0, arg_p=expr->u.function_call_expression.argument;
+         arg_p; arg_p=arg_p->next) {
+        eval_expression(inter, caller_env, arg_p->expression);
+        arg_count++;
+    }
+    value = mrsk_construct_record(inter, shape, arg_count,
+                                  &inter->stack.stack[inter->stack
+                                                      .stack_pointer
+                                                      - arg_count],
+                                  expr->line_number);
+    shrink_stack(inter, arg_count);
+
+    push_value(inter, &value);
+}
+
 static void eval_function_call_expression(MRSK_Interpreter *inter,
                                           MRSK_LocalEnvironment *env,
                                           Expression *expr)
@@ -705,16 +1258,19 @@ static void eval_function_call_expression(MRSK_Interpreter *inter,
     FunctionDefinition *func;
     MRSK_LocalEnvironment *local_env;
 
-    char *identifier = expr->u.function_call_expression.identifier;
-
-    func = mrsk_search_function(identifier);
+    func = expr->u.function_call_expression.function;
     if (func == NULL) {
-        mrsk_runtime_error(expr->line_number, FUNCTION_NOT_FOUND_ERR,
-                           STRING_MESSAGE_ARGUMENT, "name", identifier,
-                           MESSAGE_ARGUMENT_END);
+        func = mrsk_resolve_function_call(&expr->u.function_call_expression,
+                                          expr->line_number);
     }
 
-    local_env = alloc_local_environment(inter);
+    if (func->type == MURASAKI_FUNCTION_DEFINITION) {
+        local_env = mrsk_alloc_local_environment(inter,
+                                                 func->u.murasaki_f
+                                                 .local_variable_count);
+    } else {
+        local_env = mrsk_alloc_local_environment(inter, 0);
+    }
 
     switch (func->type) {
         case MURASAKI_FUNCTION_DEFINITION:
@@ -724,108 +1280,128 @@ static void eval_function_call_expression(MRSK_Interpreter *inter,
             call_native_function(inter, local_env, env, expr,
                                  func->u.native_f.proc);
             break;
+        case RECORD_DEFINITION:
+            call_record_constructor(inter, env, expr,
+                                    &func->u.record_f.shape);
+            break;
         case FUNCTION_DEFINITION_TYPE_COUNT_PLUS_1:
         default:
             DBG_panic(("bad case..%d\n", func->type));
     }
-    dispose_local_environment(inter);
+    mrsk_dispose_local_environment(inter);
 }
 
-static void check_method_argument_count(int line_number,
-                                        ArgumentList *arg_list,
-                                        int arg_count)
+/*
+ * Calls func from native code that calls it many times, as sort() does
+ * with its comparator.  The caller allocates env for func once, with
+ * mrsk_alloc_local_environment(), and checks arg_count; each call here
+ * only refills the frame, so no environment is pushed per call.
+ */
+MRSK_Value mrsk_call_function_in_env(MRSK_Interpreter *inter,
+                                     MRSK_LocalEnvironment *env,
+                                     FunctionDefinition *func,
+                                     int arg_count, MRSK_Value *args)
 {
-    ArgumentList *arg_p;
-    int count = 0;
+    StatementResult result;
+    MRSK_Value value;
+    int i;
 
-    for (arg_p=arg_list; arg_p; arg_p=arg_p->next) {
-        count++;
+    DBG_assert(func->type == MURASAKI_FUNCTION_DEFINITION,
+               ("func->type..%d\n", func->type));
+    for (i = 0; i < arg_count; i++) {
+        env->frame[i] = args[i];
+    }
+    for (; i < env->frame_size; i++) {
+        env->frame[i].type = UNDEFINED_VALUE_TYPE;
+    }
+    if (inter->execute_mode == MRSK_BYTECODE_MODE) {
+        return mrsk_vm_execute(inter, env, func->u.murasaki_f.executable);
     }
+    result = mrsk_execute_statement_list(inter, env,
+                                         func->u.murasaki_f.block
+                                         ->statement_list);
+    if (result.type == RETURN_STATEMENT_RESULT) {
+        value = result.u.return_value;
+    } else {
+        value.type = MRSK_NONE_VALUE;
+    }
+
+    return value;
+}
 
-    if (count < arg_count) {
+static void check_method_argument_count(int line_number,
+                                        int arg_count, int true_count)
+{
+    if (arg_count < true_count) {
         mrsk_runtime_error(line_number, ARGUMENT_TOO_FEW_ERR,
                            MESSAGE_ARGUMENT_END);
-    } else if (count > arg_count) {
+    } else if (arg_count > true_count) {
         mrsk_runtime_error(line_number, ARGUMENT_TOO_MANY_ERR,
                            MESSAGE_ARGUMENT_END);
     }
 }
 
+MRSK_Value mrsk_invoke_method(MRSK_Interpreter *inter, MRSK_Value *receiver,
+                              int selector, int arg_count,
+                              MRSK_Value *args, int line_number)
+{
+    MethodTable *table;
+    Method *method = NULL;
+    MRSK_LocalEnvironment *local_env;
+    MRSK_Value result;
+
+    if (dkc_is_object_value(receiver->type)) {
+        table = &inter->method_table[receiver->u.object->type];
+        if (selector < table->size) {
+            method = &table->method[selector];
+        }
+    }
+    if (method == NULL || method->proc == NULL) {
+        mrsk_runtime_error(line_number, NO_SUCH_METHOD_ERR,
+                           STRING_MESSAGE_ARGUMENT, "method_name",
+                           inter->selector[selector], MESSAGE_ARGUMENT_END);
+    }
+    if (method->argument_count >= 0) {
+        check_method_argument_count(line_number, arg_count,
+                                    method->argument_count);
+    }
+    local_env = mrsk_alloc_local_environment(inter, 0);
+    result = method->proc(inter, local_env, receiver, arg_count, args,
+                          line_number);
+    mrsk_dispose_local_environment(inter);
+
+    return result;
+}
+
 static void eval_method_call_expression(MRSK_Interpreter *inter,
                                         MRSK_LocalEnvironment *env,
                                         Expression *expr)
 {
-    MRSK_Value *left;
     MRSK_Value result;
-    MRSK_Boolean error_flag = MRSK_FALSE;
+    ArgumentList *arg_p;
+    int arg_count;
 
     eval_expression(inter, env, expr->u.method_call_expression.expression);
-    left = peek_stack(inter, 0);
-
-    if (left->type == MRSK_ARRAY_VALUE) {
-        if (!strcmp(expr->u.method_call_expression.identifier, "add")) {
-            MRSK_Value *add;
-            check_method_argument_count(expr->line_number,
-                                        expr->u.method_call_expression
-                                        .argument, 1);
-            eval_expression(inter, env,
-                            expr->u.method_call_expression.argument
-                            ->expression);
-            add = peek_stack(inter, 0);
-            mrsk_array_add(inter, left->u.object, *add);
-            pop_value(inter);
-            result.type = MRSK_NONE_VALUE;
-        } else if (!strcmp(expr->u.method_call_expression.identifier,
-                           "size")) {
-            check_method_argument_count(expr->line_number,
-                                        expr->u.method_call_expression
-                                        .argument, 0);
-            result.type = MRSK_INT_VALUE;
-            result.u.int_value = left->u.object->u.array.size;
-        } else if (!strcmp(expr->u.method_call_expression.identifier,
-                           "resize")) {
-            MRSK_Value new_size;
-            check_method_argument_count(expr->line_number,
-                                        expr->u.method_call_expression
-                                        .argument, 1);
-            eval_expression(inter, env,
-                            expr->u.method_call_expression.argument
-                            ->expression);
-            new_size = pop_value(inter);
-            if (new_size.type != MRSK_INT_VALUE) {
-                mrsk_runtime_error(expr->line_number,
-                                  ARRAY_RESIZE_ARGUMENT_ERR,
-                                  MESSAGE_ARGUMENT_END);
-            }
-            mrsk_array_resize(inter, left->u.object, new_size.u.int_value);
-            result.type = MRSK_NONE_VALUE;
-        } else {
-            error_flag = MRSK_TRUE;
-        }
-
-    } else if (left->type == MRSK_STRING_VALUE) {
-        if (!strcmp(expr->u.method_call_expression.identifier, "length")) {
-            check_method_argument_count(expr->line_number,
-                                        expr->u.method_call_expression
-                                        .argument, 0);
-            result.type = MRSK_INT_VALUE;
-            result.u.int_value = strlen(left->u.object->u.string.string);
-        } else {
-            error_flag = MRSK_TRUE;
-        }
-    } else {
-        error_flag = MRSK_TRUE;
-    }
-    if (error_flag) {
-        mrsk_runtime_error(expr->line_number, NO_SUCH_METHOD_ERR,
-                          STRING_MESSAGE_ARGUMENT, "method_name",
-                          expr->u.method_call_expression.identifier,
-                          MESSAGE_ARGUMENT_END);
+    for (arg_count=0, arg_p=expr->u.method_call_expression.argument;
+         arg_p; arg_p=arg_p->next) {
+        eval_expression(inter, env, arg_p->expression);
+        arg_count++;
     }
-    pop_value(inter);
+    result = mrsk_invoke_method(inter, peek_stack(inter, arg_count),
+                                expr->u.method_call_expression.selector,
+                                arg_count,
+                                &inter->stack.stack[inter->stack.stack_pointer
+                                                    - arg_count],
+                                expr->line_number);
+    shrink_stack(inter, arg_count + 1);
     push_value(inter, &result);
 }
 
+/*
+ * The elements are evaluated onto the stack before the array is made,
+ * as the VM does, so nothing collects between making and filling it
+ * and it needs no write barrier.
+ */
 static void eval_array_expression(MRSK_Interpreter *inter,
                                   MRSK_LocalEnvironment *env,
                                   ExpressionList *list)
@@ -837,28 +1413,46 @@ static void eval_array_expression(MRSK_Interpreter *inter,
 
     size = 0;
     for (pos=list; pos; pos=pos->next) {
+        eval_expression(inter, env, pos->expression);
         size++;
     }
     v.type = MRSK_ARRAY_VALUE;
     v.u.object = mrsk_create_array_i(inter, size);
-    push_value(inter, &v);
-
-    for (pos=list, i=0; pos; pos=pos->next, i++) {
-        eval_expression(inter, env, pos->expression);
-        v.u.object->u.array.array[i] = pop_value(inter);
+    for (i = 0; i < size; i++) {
+        v.u.object->u.array.array.value[i]
+            = inter->stack.stack[inter->stack.stack_pointer - size + i];
     }
-
+    shrink_stack(inter, size);
+    push_value(inter, &v);
 }
 
 static void eval_index_expression(MRSK_Interpreter *inter,
                                   MRSK_LocalEnvironment *env,
                                   Expression *expr)
 {
-    MRSK_Value *left;
+    MRSK_Value *array;
+    MRSK_Value result;
+    int count;
+
+    count = eval_index_operands(inter, env, expr);
+    array = peek_stack(inter, count);
+    result = mrsk_get_array_element_n(inter, array, count, array + 1,
+                                      expr->line_number);
+    shrink_stack(inter, count + 1);
+    push_value(inter, &result);
+}
 
-    left = get_array_element_lvalue(inter, env, expr);
+static void eval_member_expression(MRSK_Interpreter *inter,
+                                   MRSK_LocalEnvironment *env,
+                                   Expression *expr)
+{
+    MRSK_Value *record;
 
-    push_value(inter, left);
+    eval_expression(inter, env, expr->u.member_expression.expression);
+    record = peek_stack(inter, 0);
+    *record = *mrsk_get_field(record, expr->u.member_expression.member_name,
+                              expr->u.member_expression.slot,
+                              expr->line_number);
 }
 
 static void eval_inc_dec_expression(MRSK_Interpreter *inter,
@@ -868,7 +1462,20 @@ static void eval_inc_dec_expression(MRSK_Interpreter *inter,
     MRSK_Value   *operand;
     MRSK_Value   result;
     int         old_value;
-    
+    int         count;
+
+    if (expr->u.inc_dec.operand->type == INDEX_EXPRESSION) {
+        count = eval_index_operands(inter, env, expr->u.inc_dec.operand);
+        operand = peek_stack(inter, count);
+        result = mrsk_inc_dec_array_element_n(inter, operand, count,
+                                              operand + 1,
+                                              expr->type
+                                              == INCREMENT_EXPRESSION
+                                              ? 1 : -1, expr->line_number);
+        shrink_stack(inter, count + 1);
+        push_value(inter, &result);
+        return;
+    }
     operand = get_lvalue(inter, env, expr->u.inc_dec.operand);
     if (operand->type != MRSK_INT_VALUE) {
         mrsk_runtime_error(expr->line_number, INC_DEC_OPERAND_TYPE_ERR,
@@ -892,6 +1499,9 @@ static void eval_expression(MRSK_Interpreter *inter,
                             MRSK_LocalEnvironment *env,
                             Expression *expr)
 {
+    int left;
+    int right;
+
     switch (expr->type) {
         case BOOLEAN_EXPRESSION:
             eval_boolean_expression(inter, expr->u.boolean_value);
@@ -903,7 +1513,8 @@ static void eval_expression(MRSK_Interpreter *inter,
             eval_double_expression(inter, expr->u.double_value);
             break;
         case STRING_EXPRESSION:
-            eval_string_expression(inter, expr->u.string_value);
+            eval_string_expression(inter,
+                                   expr->u.string_expression.object);
             break;
         case IDENTIFIER_EXPRESSION:
             eval_identifier_expression(inter, env, expr);
@@ -924,9 +1535,7 @@ static void eval_expression(MRSK_Interpreter *inter,
         case GE_EXPRESSION:
         case LT_EXPRESSION:
         case LE_EXPRESSION:
-            eval_binary_expression(inter, env, expr->type,
-                                   expr->u.binary_expression.left,
-                                   expr->u.binary_expression.right);
+            eval_binary_expression(inter, env, expr);
             break;
         case LOGICAL_AND_EXPRESSION:
         case LOGICAL_OR_EXPRESSION:
@@ -956,6 +1565,54 @@ static void eval_expression(MRSK_Interpreter *inter,
         case DECREMENT_EXPRESSION:
             eval_inc_dec_expression(inter, env, expr);
             break;
+        case MEMBER_EXPRESSION:
+            eval_member_expression(inter, env, expr);
+            break;
+        case INT_ADD_EXPRESSION:
+            if (eval_int_operands(inter, env, expr, &left, &right)) {
+                eval_int_expression(inter, left + right);
+            }
+            break;
+        case INT_SUB_EXPRESSION:
+            if (eval_int_operands(inter, env, expr, &left, &right)) {
+                eval_int_expression(inter, left - right);
+            }
+            break;
+        case INT_MUL_EXPRESSION:
+            if (eval_int_operands(inter, env, expr, &left, &right)) {
+                eval_int_expression(inter, left * right);
+            }
+            break;
+        case INT_EQ_EXPRESSION:
+            if (eval_int_operands(inter, env, expr, &left, &right)) {
+                eval_boolean_expression(inter, left == right);
+            }
+            break;
+        case INT_NE_EXPRESSION:
+            if (eval_int_operands(inter, env, expr, &left, &right)) {
+                eval_boolean_expression(inter, left != right);
+            }
+            break;
+        case INT_GT_EXPRESSION:
+            if (eval_int_operands(inter, env, expr, &left, &right)) {
+                eval_boolean_expression(inter, left > right);
+            }
+            break;
+        case INT_GE_EXPRESSION:
+            if (eval_int_operands(inter, env, expr, &left, &right)) {
+                eval_boolean_expression(inter, left >= right);
+            }
+            break;
+        case INT_LT_EXPRESSION:
+            if (eval_int_operands(inter, env, expr, &left, &right)) {
+                eval_boolean_expression(inter, left < right);
+            }
+            break;
+        case INT_LE_EXPRESSION:
+            if (eval_int_operands(inter, env, expr, &left, &right)) {
+                eval_boolean_expression(inter, left <= right);
+            }
+            break;
         case EXPRESSION_TYPE_COUNT_PLUS_1:
         default:
             DBG_panic(("bad case. type..%d\n", expr->type));
@@ -20,44 +20,45 @@ static StatementResult execute_expression_statement(MRSK_Interpreter *inter,
     return result;
 }
 
-static StatementResult execute_global_statement(MRSK_Interpreter *inter,
-                                               MRSK_LocalEnvironment *env,
-                                               Statement *statement)
+/*
+ * The names were bound to global slots by mrsk_fix_tree(), so this only
+ * checks that the statement is legal here and the globals exist.
+ */
+void mrsk_declare_global_variable(MRSK_Interpreter *inter,
+                                  MRSK_LocalEnvironment *env,
+                                  IdentifierList *identifier_list,
+                                  int line_number)
 {
     IdentifierList *pos;
-    StatementResult result;
-
-    result.type = NORMAL_STATEMENT_RESULT;
 
     if (env == NULL) {
-        mrsk_runtime_error(statement->line_number,
+        mrsk_runtime_error(line_number,
                            GLOBAL_STATEMENT_IN_TOPLEVEL_ERR,
                            MESSAGE_ARGUMENT_END);
     }
-    for (pos=statement->u.global_s.identifier_list; pos; pos=pos->next) {
-        GlobalVariableRef *ref_pos;
-        GlobalVariableRef *new_ref;
-        Variable *variable;
-        for (ref_pos=env->global_variable; ref_pos; ref_pos=ref_pos->next) {
-            if (!strcmp(ref_pos->variable->name, pos->name)) {
-                goto NEXT_IDENTIFIER;
-            }
-        }
-        variable = mrsk_search_global_variable(inter, pos->name);
-        if (variable == NULL) {
-            mrsk_runtime_error(statement->line_number,
+    for (pos=identifier_list; pos; pos=pos->next) {
+        if (inter->global.variable[pos->global_index]->value.type
+            == UNDEFINED_VALUE_TYPE) {
+            mrsk_runtime_error(line_number,
                                GLOBAL_VARIABLE_NOT_FOUND_ERR,
                                STRING_MESSAGE_ARGUMENT,
                                "name", pos->name,
                                MESSAGE_ARGUMENT_END);
         }
-        new_ref = MEM_malloc(sizeof(GlobalVariableRef));
-        new_ref->variable = variable;
-        new_ref->next = env->global_variable;
-        env->global_variable = new_ref;
-NEXT_IDENTIFIER:
-        ;
     }
+}
+
+static StatementResult execute_global_statement(MRSK_Interpreter *inter,
+                                               MRSK_LocalEnvironment *env,
+                                               Statement *statement)
+{
+    StatementResult result;
+
+    result.type = NORMAL_STATEMENT_RESULT;
+    mrsk_declare_global_variable(inter, env,
+                                 statement->u.global_s.identifier_list,
+                                 statement->line_number);
+
     return result;
 }
 
@@ -81,9 +82,7 @@ static StatementResult execute_elif(MRSK_Interpreter *inter,
             result = mrsk_execute_statement_list(inter, env,
                                                  pos->block->statement_list);
             *executed = MRSK_TRUE;
-            if (result.type != NORMAL_STATEMENT_RESULT) {
-                goto FUNC_END;
-            }
+            goto FUNC_END;
         }
     }
 FUNC_END:
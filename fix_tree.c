@@ -0,0 +1,384 @@
+#include "MEM.h"
+#include "DBG.h"
+#include "murasaki.h"
+
+#define NAME_LIST_ALLOC_SIZE    (16)
+
+typedef struct {
+    int count;
+    int alloc_size;
+    char **name;
+} NameList;
+
+typedef struct {
+    MRSK_Interpreter *inter;
+    MRSK_Boolean is_toplevel;
+    NameList global_name;
+    NameList assigned_name;
+    NameList local_variable;
+} FunctionScope;
+
+typedef void ExpressionVisitor(Expression *expr, FunctionScope *scope);
+
+static int search_name(NameList *list, char *name)
+{
+    int i;
+
+    for (i = 0; i < list->count; i++) {
+        if (list->name[i] == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void add_name(NameList *list, char *name)
+{
+    if (search_name(list, name) >= 0) {
+        return;
+    }
+    if (list->alloc_size < list->count + 1) {
+        list->alloc_size += NAME_LIST_ALLOC_SIZE;
+        list->name = MEM_realloc(list->name,
+                                 sizeof(char*) * list->alloc_size);
+    }
+    list->name[list->count] = name;
+    list->count++;
+}
+
+static void walk_expression(Expression *expr, ExpressionVisitor *visit,
+                            FunctionScope *scope);
+
+static void walk_argument_list(ArgumentList *arg_list,
+                               ExpressionVisitor *visit, FunctionScope *scope)
+{
+    ArgumentList *pos;
+
+    for (pos = arg_list; pos; pos = pos->next) {
+        walk_expression(pos->expression, visit, scope);
+    }
+}
+
+static void walk_expression(Expression *expr, ExpressionVisitor *visit,
+                            FunctionScope *scope)
+{
+    ExpressionList *pos;
+
+    if (expr == NULL) {
+        return;
+    }
+    visit(expr, scope);
+
+    switch (expr->type) {
+        case BOOLEAN_EXPRESSION:
+        case INT_EXPRESSION:
+        case DOUBLE_EXPRESSION:
+        case STRING_EXPRESSION:
+        case IDENTIFIER_EXPRESSION:
+        case NONE_EXPRESSION:
+            break;
+        case ASSIGN_EXPRESSION:
+            walk_expression(expr->u.assign_expression.left, visit, scope);
+            walk_expression(expr->u.assign_expression.operand, visit, scope);
+            break;
+        case ADD_EXPRESSION:
+        case SUB_EXPRESSION:
+        case MUL_EXPRESSION:
+        case DIV_EXPRESSION:
+        case MOD_EXPRESSION:
+        case EQ_EXPRESSION:
+        case NE_EXPRESSION:
+        case GT_EXPRESSION:
+        case GE_EXPRESSION:
+        case LT_EXPRESSION:
+        case LE_EXPRESSION:
+        case LOGICAL_AND_EXPRESSION:
+        case LOGICAL_OR_EXPRESSION:
+        case INT_ADD_EXPRESSION:
+        case INT_SUB_EXPRESSION:
+        case INT_MUL_EXPRESSION:
+        case INT_EQ_EXPRESSION:
+        case INT_NE_EXPRESSION:
+        case INT_GT_EXPRESSION:
+        case INT_GE_EXPRESSION:
+        case INT_LT_EXPRESSION:
+        case INT_LE_EXPRESSION:
+            walk_expression(expr->u.binary_expression.left, visit, scope);
+            walk_expression(expr->u.binary_expression.right, visit, scope);
+            break;
+        case MINUS_EXPRESSION:
+            walk_expression(expr->u.minus_expression, visit, scope);
+            break;
+        case FUNCTION_CALL_EXPRESSION:
+            walk_argument_list(expr->u.function_call_expression.argument,
+                               visit, scope);
+            break;
+        case METHOD_CALL_EXPRESSION:
+            walk_expression(expr->u.method_call_expression.expression,
+                            visit, scope);
+            walk_argument_list(expr->u.method_call_expression.argument,
+                               visit, scope);
+            break;
+        case ARRAY_EXPRESSION:
+            for (pos = expr->u.array_literal; pos; pos = pos->next) {
+                walk_expression(pos->expression, visit, scope);
+            }
+            break;
+        case INDEX_EXPRESSION:
+            walk_expression(expr->u.index_expression.array, visit, scope);
+            walk_expression(expr->u.index_expression.index, visit, scope);
+            break;
+        case INCREMENT_EXPRESSION:
+        case DECREMENT_EXPRESSION:
+            walk_expression(expr->u.inc_dec.operand, visit, scope);
+            break;
+        case MEMBER_EXPRESSION:
+            walk_expression(expr->u.member_expression.expression,
+                            visit, scope);
+            break;
+        case EXPRESSION_TYPE_COUNT_PLUS_1:
+        default:
+            DBG_panic(("bad case. type..%d\n", expr->type));
+    }
+}
+
+static void walk_statement_list(StatementList *list,
+                                ExpressionVisitor *visit,
+                                FunctionScope *scope);
+
+static void walk_block(Block *block, ExpressionVisitor *visit,
+                       FunctionScope *scope)
+{
+    if (block) {
+        walk_statement_list(block->statement_list, visit, scope);
+    }
+}
+
+static void walk_statement_list(StatementList *list,
+                                ExpressionVisitor *visit,
+                                FunctionScope *scope)
+{
+    StatementList *pos;
+    IdentifierList *id_pos;
+    Elif *elif_pos;
+
+    for (pos = list; pos; pos = pos->next) {
+        Statement *statement = pos->statement;
+        switch (statement->type) {
+            case EXPRESSION_STATEMENT:
+                walk_expression(statement->u.expression_s, visit, scope);
+                break;
+            case GLOBAL_STATEMENT:
+                for (id_pos = statement->u.global_s.identifier_list;
+                     id_pos; id_pos = id_pos->next) {
+                    add_name(&scope->global_name, id_pos->name);
+                    id_pos->global_index
+                        = mrsk_intern_global_variable(scope->inter,
+                                                      id_pos->name);
+                }
+                break;
+            case IF_STATEMENT:
+                walk_expression(statement->u.if_s.condition, visit, scope);
+                walk_block(statement->u.if_s.then_block, visit, scope);
+                for (elif_pos = statement->u.if_s.elif_list; elif_pos;
+                     elif_pos = elif_pos->next) {
+                    walk_expression(elif_pos->condition, visit, scope);
+                    walk_block(elif_pos->block, visit, scope);
+                }
+                walk_block(statement->u.if_s.else_block, visit, scope);
+                break;
+            case WHILE_STATEMENT:
+                walk_expression(statement->u.while_s.condition, visit, scope);
+                walk_block(statement->u.while_s.block, visit, scope);
+                break;
+            case FOR_STATEMENT:
+                walk_expression(statement->u.for_s.init, visit, scope);
+                walk_expression(statement->u.for_s.condition, visit, scope);
+                walk_expression(statement->u.for_s.post, visit, scope);
+                walk_block(statement->u.for_s.block, visit, scope);
+                break;
+            case RETURN_STATEMENT:
+                walk_expression(statement->u.return_s.return_value,
+                                visit, scope);
+                break;
+            case BREAK_STATEMENT:
+            case CONTINUE_STATEMENT:
+                break;
+            case STATEMENT_TYPE_COUNT_PLUS_1:
+            default:
+                DBG_panic(("bad case...%d", statement->type));
+        }
+    }
+}
+
+static void collect_assigned_name(Expression *expr, FunctionScope *scope)
+{
+    Expression *target;
+
+    if (expr->type == ASSIGN_EXPRESSION) {
+        target = expr->u.assign_expression.left;
+    } else if (expr->type == INCREMENT_EXPRESSION
+               || expr->type == DECREMENT_EXPRESSION) {
+        target = expr->u.inc_dec.operand;
+    } else {
+        return;
+    }
+    if (target->type == IDENTIFIER_EXPRESSION) {
+        add_name(&scope->assigned_name, target->u.identifier.name);
+    }
+}
+
+/*
+ * At top level every name is a global.  In a function a name is a local
+ * slot, a global slot if the function declares it global, or neither,
+ * which leaves it to the by-name lookup (and its runtime error).
+ */
+static void resolve_identifier(Expression *expr, FunctionScope *scope)
+{
+    IdentifierExpression *ie = &expr->u.identifier;
+
+    ie->local_index = search_name(&scope->local_variable, ie->name);
+    ie->global_index = -1;
+    if (ie->local_index < 0
+        && (scope->is_toplevel
+            || search_name(&scope->global_name, ie->name) >= 0)) {
+        ie->global_index = mrsk_intern_global_variable(scope->inter,
+                                                       ie->name);
+    }
+}
+
+static void bind_function_call(Expression *expr)
+{
+    FunctionCallExpression *fce = &expr->u.function_call_expression;
+
+    fce->function = mrsk_search_function(fce->identifier);
+}
+
+/*
+ * The type of record.name isn't known until run time, but if every
+ * struct with a field name has it in the same place, that is the slot
+ * to try first.
+ */
+static void resolve_member(Expression *expr, FunctionScope *scope)
+{
+    MemberExpression *me = &expr->u.member_expression;
+    FunctionDefinition *pos;
+    RecordShape *shape;
+    int i;
+
+    me->slot = -1;
+    for (pos = scope->inter->function_list; pos; pos = pos->next) {
+        if (pos->type != RECORD_DEFINITION) {
+            continue;
+        }
+        shape = &pos->u.record_f.shape;
+        for (i = 0; i < shape->field_count; i++) {
+            if (shape->field[i] == me->member_name) {
+                break;
+            }
+        }
+        if (i == shape->field_count) {
+            continue;
+        }
+        if (me->slot >= 0 && me->slot != i) {
+            me->slot = -1;
+            return;
+        }
+        me->slot = i;
+    }
+}
+
+static void fix_expression(Expression *expr, FunctionScope *scope)
+{
+    if (expr->type == IDENTIFIER_EXPRESSION) {
+        resolve_identifier(expr, scope);
+    } else if (expr->type == MEMBER_EXPRESSION) {
+        resolve_member(expr, scope);
+    } else if (expr->type == FUNCTION_CALL_EXPRESSION) {
+        bind_function_call(expr);
+    } else if (expr->type == STRING_EXPRESSION) {
+        expr->u.string_expression.object
+            = mrsk_literal_to_mrsk_string(scope->inter,
+                                          expr->u.string_expression.string);
+    }
+}
+
+static void init_name_list(NameList *list)
+{
+    list->count = 0;
+    list->alloc_size = 0;
+    list->name = NULL;
+}
+
+static void init_scope(FunctionScope *scope, MRSK_Interpreter *inter,
+                       MRSK_Boolean is_toplevel)
+{
+    scope->inter = inter;
+    scope->is_toplevel = is_toplevel;
+    init_name_list(&scope->global_name);
+    init_name_list(&scope->assigned_name);
+    init_name_list(&scope->local_variable);
+}
+
+static void dispose_scope(FunctionScope *scope)
+{
+    MEM_free(scope->global_name.name);
+    MEM_free(scope->assigned_name.name);
+    MEM_free(scope->local_variable.name);
+}
+
+/*
+ * Parameters come first, so the caller can store arguments straight into
+ * frame[0..parameter_count-1].  Any other name the function assigns to
+ * is a local too, unless the function declares it with a global
+ * statement.
+ */
+static void fix_function(MRSK_Interpreter *inter, FunctionDefinition *fd)
+{
+    FunctionScope scope;
+    ParameterList *param;
+    int i;
+
+    init_scope(&scope, inter, MRSK_FALSE);
+
+    fd->u.murasaki_f.parameter_count = 0;
+    for (param = fd->u.murasaki_f.parameter; param; param = param->next) {
+        add_name(&scope.local_variable, param->name);
+        fd->u.murasaki_f.parameter_count++;
+    }
+    walk_block(fd->u.murasaki_f.block, collect_assigned_name, &scope);
+    for (i = 0; i < scope.assigned_name.count; i++) {
+        if (search_name(&scope.global_name, scope.assigned_name.name[i]) < 0) {
+            add_name(&scope.local_variable, scope.assigned_name.name[i]);
+        }
+    }
+    fd->u.murasaki_f.local_variable_count = scope.local_variable.count;
+    fd->u.murasaki_f.local_variable
+        = mrsk_malloc(sizeof(char*) * (scope.local_variable.count + 1));
+    for (i = 0; i < scope.local_variable.count; i++) {
+        fd->u.murasaki_f.local_variable[i] = scope.local_variable.name[i];
+    }
+    walk_block(fd->u.murasaki_f.block, fix_expression, &scope);
+
+    dispose_scope(&scope);
+}
+
+/*
+ * Every function is known once parsing is done, so call sites are bound
+ * to their FunctionDefinition here instead of searching function_list
+ * on each call.  Global names get their slots here too.
+ */
+void mrsk_fix_tree(MRSK_Interpreter *inter)
+{
+    FunctionDefinition *pos;
+    FunctionScope toplevel;
+
+    for (pos = inter->function_list; pos; pos = pos->next) {
+        if (pos->type == MURASAKI_FUNCTION_DEFINITION) {
+            fix_function(inter, pos);
+        }
+    }
+    init_scope(&toplevel, inter, MRSK_TRUE);
+    walk_statement_list(inter->statement_list, fix_expression, &toplevel);
+    dispose_scope(&toplevel);
+}
@@ -0,0 +1,804 @@
+#include <stdarg.h>
+#include <string.h>
+#include "MEM.h"
+#include "DBG.h"
+#include "murasaki.h"
+
+#define OPCODE_ALLOC_SIZE       (256)
+#define LABEL_TABLE_ALLOC_SIZE  (256)
+#define CONSTANT_ALLOC_SIZE     (64)
+#define LINE_NUMBER_ALLOC_SIZE  (64)
+
+/* stack_increment of -1 means "depends on the operands" */
+static OpcodeInfo st_opcode_info[] = {
+    {"dummy", 0, 0},
+    {"push_int", 1, 1},
+    {"push_double", 1, 1},
+    {"push_boolean", 1, 1},
+    {"push_string", 1, 1},
+    {"push_none", 0, 1},
+    {"push_variable", 1, 1},
+    {"store_variable", 1, 0},
+    {"push_array_element", 0, -1},
+    {"store_array_element", 0, -2},
+    {"increment_variable", 1, 1},
+    {"decrement_variable", 1, 1},
+    {"push_local", 1, 1},
+    {"store_local", 1, 0},
+    {"increment_local", 1, 1},
+    {"decrement_local", 1, 1},
+    {"push_global", 1, 1},
+    {"store_global", 1, 0},
+    {"increment_global", 1, 1},
+    {"decrement_global", 1, 1},
+    {"increment_array_element", 0, -1},
+    {"decrement_array_element", 0, -1},
+    {"push_array_element_n", 1, 0},
+    {"store_array_element_n", 1, 0},
+    {"increment_array_element_n", 1, 0},
+    {"decrement_array_element_n", 1, 0},
+    {"push_field", 2, 0},
+    {"store_field", 2, -1},
+    {"increment_field", 2, 0},
+    {"decrement_field", 2, 0},
+    {"add", 0, -1},
+    {"sub", 0, -1},
+    {"mul", 0, -1},
+    {"div", 0, -1},
+    {"mod", 0, -1},
+    {"eq", 0, -1},
+    {"ne", 0, -1},
+    {"gt", 0, -1},
+    {"ge", 0, -1},
+    {"lt", 0, -1},
+    {"le", 0, -1},
+    {"minus", 0, 0},
+    {"logical_and", 1, -1},
+    {"logical_or", 1, -1},
+    {"create_array", 1, 0},
+    {"call", 2, 0},
+    {"method_call", 2, 0},
+    {"pop", 0, -1},
+    {"jump", 1, 0},
+    {"jump_if_false", 1, -1},
+    {"global", 1, 0},
+    {"return", 0, -1},
+    {"not_lvalue", 0, 0},
+    {"dummy", 0, 0},
+};
+
+typedef struct {
+    int label_address;
+} LabelTable;
+
+typedef struct {
+    int size;
+    int alloc_size;
+    int *code;
+    int label_table_size;
+    int label_table_alloc_size;
+    LabelTable *label_table;
+    int line_number_size;
+    int line_number_alloc_size;
+    LineNumber *line_number;
+    int constant_count;
+    int constant_alloc_size;
+    Constant *constant;
+    int current_stack_size;
+    int need_stack_size;
+} OpcodeBuf;
+
+typedef struct LoopLabel_tag {
+    int break_label;
+    int continue_label;
+} LoopLabel;
+
+static void generate_expression(OpcodeBuf *ob, Expression *expr);
+static void generate_statement_list(OpcodeBuf *ob, LoopLabel *loop,
+                                    StatementList *statement_list);
+
+static void init_opcode_buf(OpcodeBuf *ob)
+{
+    ob->size = 0;
+    ob->alloc_size = 0;
+    ob->code = NULL;
+    ob->label_table_size = 0;
+    ob->label_table_alloc_size = 0;
+    ob->label_table = NULL;
+    ob->line_number_size = 0;
+    ob->line_number_alloc_size = 0;
+    ob->line_number = NULL;
+    ob->constant_count = 0;
+    ob->constant_alloc_size = 0;
+    ob->constant = NULL;
+    ob->current_stack_size = 0;
+    ob->need_stack_size = 0;
+}
+
+static void add_line_number(OpcodeBuf *ob, int line_number, int start_pc)
+{
+    if (ob->line_number_size > 0
+        && ob->line_number[ob->line_number_size-1].line_number
+        == line_number) {
+        return;
+    }
+    if (ob->line_number_size > 0) {
+        ob->line_number[ob->line_number_size-1].pc_count
+            = start_pc - ob->line_number[ob->line_number_size-1].start_pc;
+    }
+    if (ob->line_number_size == ob->line_number_alloc_size) {
+        ob->line_number_alloc_size = ob->line_number_alloc_size
+            ? ob->line_number_alloc_size * 2 : LINE_NUMBER_ALLOC_SIZE;
+        ob->line_number = MEM_realloc(ob->line_number,
+                                      sizeof(LineNumber)
+                                      * ob->line_number_alloc_size);
+    }
+    ob->line_number[ob->line_number_size].line_number = line_number;
+    ob->line_number[ob->line_number_size].start_pc = start_pc;
+    ob->line_number[ob->line_number_size].pc_count = 0;
+    ob->line_number_size++;
+}
+
+static void increment_stack_size(OpcodeBuf *ob, int increment)
+{
+    ob->current_stack_size += increment;
+    if (ob->current_stack_size > ob->need_stack_size) {
+        ob->need_stack_size = ob->current_stack_size;
+    }
+}
+
+static void generate_code(OpcodeBuf *ob, int line_number, Opcode code, ...)
+{
+    va_list ap;
+    int i;
+    int operand_count;
+
+    va_start(ap, code);
+
+    operand_count = st_opcode_info[code].operand_count;
+    if (ob->alloc_size < ob->size + 1 + operand_count) {
+        ob->code = MEM_realloc(ob->code, sizeof(int)
+                               * (ob->alloc_size + OPCODE_ALLOC_SIZE));
+        ob->alloc_size += OPCODE_ALLOC_SIZE;
+    }
+    add_line_number(ob, line_number, ob->size);
+    ob->code[ob->size] = code;
+    ob->size++;
+    for (i = 0; i < operand_count; i++) {
+        ob->code[ob->size] = va_arg(ap, int);
+        ob->size++;
+    }
+    va_end(ap);
+
+    if (code == CALL_OP) {
+        increment_stack_size(ob, 1 - ob->code[ob->size-1]);
+    } else if (code == METHOD_CALL_OP) {
+        increment_stack_size(ob, -ob->code[ob->size-1]);
+    } else if (code == CREATE_ARRAY_OP) {
+        increment_stack_size(ob, 1 - ob->code[ob->size-1]);
+    } else if (code == PUSH_ARRAY_ELEMENT_N_OP
+               || code == INCREMENT_ARRAY_ELEMENT_N_OP
+               || code == DECREMENT_ARRAY_ELEMENT_N_OP) {
+        increment_stack_size(ob, -ob->code[ob->size-1]);
+    } else if (code == STORE_ARRAY_ELEMENT_N_OP) {
+        increment_stack_size(ob, -ob->code[ob->size-1] - 1);
+    } else {
+        increment_stack_size(ob, st_opcode_info[code].stack_increment);
+    }
+}
+
+static int get_label(OpcodeBuf *ob)
+{
+    int ret;
+
+    if (ob->label_table_alloc_size < ob->label_table_size + 1) {
+        ob->label_table = MEM_realloc(ob->label_table,
+                                      (ob->label_table_alloc_size
+                                       + LABEL_TABLE_ALLOC_SIZE)
+                                      * sizeof(LabelTable));
+        ob->label_table_alloc_size += LABEL_TABLE_ALLOC_SIZE;
+    }
+    ret = ob->label_table_size;
+    ob->label_table_size++;
+
+    return ret;
+}
+
+static void set_label(OpcodeBuf *ob, int label)
+{
+    ob->label_table[label].label_address = ob->size;
+}
+
+static int add_constant(OpcodeBuf *ob, Constant *constant)
+{
+    if (ob->constant_alloc_size < ob->constant_count + 1) {
+        ob->constant = MEM_realloc(ob->constant,
+                                   (ob->constant_alloc_size
+                                    + CONSTANT_ALLOC_SIZE)
+                                   * sizeof(Constant));
+        ob->constant_alloc_size += CONSTANT_ALLOC_SIZE;
+    }
+    ob->constant[ob->constant_count] = *constant;
+    ob->constant_count++;
+
+    return ob->constant_count - 1;
+}
+
+static int add_identifier_constant(OpcodeBuf *ob, char *identifier)
+{
+    Constant c;
+    int i;
+
+    for (i = 0; i < ob->constant_count; i++) {
+        if (ob->constant[i].type == IDENTIFIER_CONSTANT
+            && ob->constant[i].u.identifier == identifier) {
+            return i;
+        }
+    }
+    c.type = IDENTIFIER_CONSTANT;
+    c.u.identifier = identifier;
+
+    return add_constant(ob, &c);
+}
+
+static void generate_double_expression(OpcodeBuf *ob, Expression *expr)
+{
+    Constant c;
+
+    c.type = DOUBLE_CONSTANT;
+    c.u.double_value = expr->u.double_value;
+    generate_code(ob, expr->line_number, PUSH_DOUBLE_OP,
+                  add_constant(ob, &c));
+}
+
+static void generate_string_expression(OpcodeBuf *ob, Expression *expr)
+{
+    Constant c;
+
+    c.type = STRING_CONSTANT;
+    c.u.string_object = expr->u.string_expression.object;
+    generate_code(ob, expr->line_number, PUSH_STRING_OP,
+                  add_constant(ob, &c));
+}
+
+static void generate_identifier_expression(OpcodeBuf *ob, Expression *expr)
+{
+    if (expr->u.identifier.local_index >= 0) {
+        generate_code(ob, expr->line_number, PUSH_LOCAL_OP,
+                      expr->u.identifier.local_index);
+    } else if (expr->u.identifier.global_index >= 0) {
+        generate_code(ob, expr->line_number, PUSH_GLOBAL_OP,
+                      expr->u.identifier.global_index);
+    } else {
+        generate_code(ob, expr->line_number, PUSH_VARIABLE_OP,
+                      add_identifier_constant(ob, expr->u.identifier.name));
+    }
+}
+
+/*
+ * Pushes the array of a chain of subscripts and then each subscript, and
+ * returns the number of subscripts, so that a[i][j] is done by a single
+ * *_ARRAY_ELEMENT_N_OP.
+ */
+static int generate_index_operands(OpcodeBuf *ob, Expression *expr)
+{
+    int count;
+
+    if (expr->u.index_expression.array->type == INDEX_EXPRESSION) {
+        count = generate_index_operands(ob, expr->u.index_expression.array);
+    } else {
+        generate_expression(ob, expr->u.index_expression.array);
+        count = 0;
+    }
+    generate_expression(ob, expr->u.index_expression.index);
+
+    return count + 1;
+}
+
+/* Pushes the record and emits code with the field's two operands. */
+static void generate_field_code(OpcodeBuf *ob, Expression *expr,
+                                Opcode code)
+{
+    MemberExpression *me = &expr->u.member_expression;
+
+    generate_expression(ob, me->expression);
+    generate_code(ob, expr->line_number, code,
+                  add_identifier_constant(ob, me->member_name), me->slot);
+}
+
+static void generate_assign_expression(OpcodeBuf *ob, Expression *expr)
+{
+    Expression *left = expr->u.assign_expression.left;
+    int count;
+
+    generate_expression(ob, expr->u.assign_expression.operand);
+
+    if (left->type == IDENTIFIER_EXPRESSION
+        && left->u.identifier.local_index >= 0) {
+        generate_code(ob, expr->line_number, STORE_LOCAL_OP,
+                      left->u.identifier.local_index);
+    } else if (left->type == IDENTIFIER_EXPRESSION
+               && left->u.identifier.global_index >= 0) {
+        generate_code(ob, expr->line_number, STORE_GLOBAL_OP,
+                      left->u.identifier.global_index);
+    } else if (left->type == IDENTIFIER_EXPRESSION) {
+        generate_code(ob, expr->line_number, STORE_VARIABLE_OP,
+                      add_identifier_constant(ob, left->u.identifier.name));
+    } else if (left->type == INDEX_EXPRESSION) {
+        count = generate_index_operands(ob, left);
+        if (count == 1) {
+            generate_code(ob, left->line_number, STORE_ARRAY_ELEMENT_OP);
+        } else {
+            generate_code(ob, left->line_number, STORE_ARRAY_ELEMENT_N_OP,
+                          count);
+        }
+    } else if (left->type == MEMBER_EXPRESSION) {
+        generate_field_code(ob, left, STORE_FIELD_OP);
+    } else {
+        /* an error only if it is run, as in the AST walker */
+        generate_code(ob, left->line_number, NOT_LVALUE_OP);
+    }
+}
+
+static void generate_binary_expression(OpcodeBuf *ob, Expression *expr,
+                                       Opcode code)
+{
+    generate_expression(ob, expr->u.binary_expression.left);
+    generate_expression(ob, expr->u.binary_expression.right);
+    generate_code(ob, expr->u.binary_expression.left->line_number, code);
+}
+
+static void generate_logical_and_or_expression(OpcodeBuf *ob,
+                                               Expression *expr, Opcode code)
+{
+    int end_label;
+
+    end_label = get_label(ob);
+    generate_expression(ob, expr->u.binary_expression.left);
+    generate_code(ob, expr->u.binary_expression.left->line_number,
+                  code, end_label);
+    generate_expression(ob, expr->u.binary_expression.right);
+    set_label(ob, end_label);
+}
+
+static int generate_argument_list(OpcodeBuf *ob, ArgumentList *arg_list)
+{
+    ArgumentList *pos;
+    int arg_count = 0;
+
+    for (pos = arg_list; pos; pos = pos->next) {
+        generate_expression(ob, pos->expression);
+        arg_count++;
+    }
+
+    return arg_count;
+}
+
+static void generate_function_call_expression(OpcodeBuf *ob, Expression *expr)
+{
+    FunctionCallExpression *fce = &expr->u.function_call_expression;
+    Constant c;
+    int arg_count;
+
+    arg_count = generate_argument_list(ob, fce->argument);
+    c.type = FUNCTION_CALL_CONSTANT;
+    c.u.function_call = fce;
+    generate_code(ob, expr->line_number, CALL_OP,
+                  add_constant(ob, &c), arg_count);
+}
+
+static void generate_method_call_expression(OpcodeBuf *ob, Expression *expr)
+{
+    MethodCallExpression *mce = &expr->u.method_call_expression;
+    int arg_count;
+
+    generate_expression(ob, mce->expression);
+    arg_count = generate_argument_list(ob, mce->argument);
+    generate_code(ob, expr->line_number, METHOD_CALL_OP,
+                  mce->selector, arg_count);
+}
+
+static void generate_array_expression(OpcodeBuf *ob, Expression *expr)
+{
+    ExpressionList *pos;
+    int count = 0;
+
+    for (pos = expr->u.array_literal; pos; pos = pos->next) {
+        generate_expression(ob, pos->expression);
+        count++;
+    }
+    generate_code(ob, expr->line_number, CREATE_ARRAY_OP, count);
+}
+
+static void generate_inc_dec_expression(OpcodeBuf *ob, Expression *expr)
+{
+    Expression *operand = expr->u.inc_dec.operand;
+    MRSK_Boolean is_increment = (expr->type == INCREMENT_EXPRESSION);
+    int count;
+
+    if (operand->type == IDENTIFIER_EXPRESSION
+        && operand->u.identifier.local_index >= 0) {
+        generate_code(ob, expr->line_number,
+                      is_increment ? INCREMENT_LOCAL_OP : DECREMENT_LOCAL_OP,
+                      operand->u.identifier.local_index);
+    } else if (operand->type == IDENTIFIER_EXPRESSION
+               && operand->u.identifier.global_index >= 0) {
+        generate_code(ob, expr->line_number,
+                      is_increment ? INCREMENT_GLOBAL_OP : DECREMENT_GLOBAL_OP,
+                      operand->u.identifier.global_index);
+    } else if (operand->type == IDENTIFIER_EXPRESSION) {
+        generate_code(ob, expr->line_number,
+                      is_increment ? INCREMENT_VARIABLE_OP
+                      : DECREMENT_VARIABLE_OP,
+                      add_identifier_constant(ob, operand->u.identifier.name));
+    } else if (operand->type == INDEX_EXPRESSION) {
+        count = generate_index_operands(ob, operand);
+        if (count == 1) {
+            generate_code(ob, operand->line_number,
+                          is_increment ? INCREMENT_ARRAY_ELEMENT_OP
+                          : DECREMENT_ARRAY_ELEMENT_OP);
+        } else {
+            generate_code(ob, operand->line_number,
+                          is_increment ? INCREMENT_ARRAY_ELEMENT_N_OP
+                          : DECREMENT_ARRAY_ELEMENT_N_OP, count);
+        }
+    } else if (operand->type == MEMBER_EXPRESSION) {
+        generate_field_code(ob, operand, is_increment ? INCREMENT_FIELD_OP
+                            : DECREMENT_FIELD_OP);
+    } else {
+        /* the push is never reached; it keeps the stack depth right */
+        generate_code(ob, operand->line_number, NOT_LVALUE_OP);
+        generate_code(ob, operand->line_number, PUSH_NONE_OP);
+    }
+}
+
+static void generate_expression(OpcodeBuf *ob, Expression *expr)
+{
+    int count;
+
+    switch (expr->type) {
+        case BOOLEAN_EXPRESSION:
+            generate_code(ob, expr->line_number, PUSH_BOOLEAN_OP,
+                          expr->u.boolean_value);
+            break;
+        case INT_EXPRESSION:
+            generate_code(ob, expr->line_number, PUSH_INT_OP,
+                          expr->u.int_value);
+            break;
+        case DOUBLE_EXPRESSION:
+            generate_double_expression(ob, expr);
+            break;
+        case STRING_EXPRESSION:
+            generate_string_expression(ob, expr);
+            break;
+        case IDENTIFIER_EXPRESSION:
+            generate_identifier_expression(ob, expr);
+            break;
+        case ASSIGN_EXPRESSION:
+            generate_assign_expression(ob, expr);
+            break;
+        case ADD_EXPRESSION:
+            generate_binary_expression(ob, expr, ADD_OP);
+            break;
+        case SUB_EXPRESSION:
+            generate_binary_expression(ob, expr, SUB_OP);
+            break;
+        case MUL_EXPRESSION:
+            generate_binary_expression(ob, expr, MUL_OP);
+            break;
+        case DIV_EXPRESSION:
+            generate_binary_expression(ob, expr, DIV_OP);
+            break;
+        case MOD_EXPRESSION:
+            generate_binary_expression(ob, expr, MOD_OP);
+            break;
+        case EQ_EXPRESSION:
+            generate_binary_expression(ob, expr, EQ_OP);
+            break;
+        case NE_EXPRESSION:
+            generate_binary_expression(ob, expr, NE_OP);
+            break;
+        case GT_EXPRESSION:
+            generate_binary_expression(ob, expr, GT_OP);
+            break;
+        case GE_EXPRESSION:
+            generate_binary_expression(ob, expr, GE_OP);
+            break;
+        case LT_EXPRESSION:
+            generate_binary_expression(ob, expr, LT_OP);
+            break;
+        case LE_EXPRESSION:
+            generate_binary_expression(ob, expr, LE_OP);
+            break;
+        case LOGICAL_AND_EXPRESSION:
+            generate_logical_and_or_expression(ob, expr, LOGICAL_AND_OP);
+            break;
+        case LOGICAL_OR_EXPRESSION:
+            generate_logical_and_or_expression(ob, expr, LOGICAL_OR_OP);
+            break;
+        case MINUS_EXPRESSION:
+            generate_expression(ob, expr->u.minus_expression);
+            generate_code(ob, expr->u.minus_expression->line_number,
+                          MINUS_OP);
+            break;
+        case FUNCTION_CALL_EXPRESSION:
+            generate_function_call_expression(ob, expr);
+            break;
+        case METHOD_CALL_EXPRESSION:
+            generate_method_call_expression(ob, expr);
+            break;
+        case NONE_EXPRESSION:
+            generate_code(ob, expr->line_number, PUSH_NONE_OP);
+            break;
+        case ARRAY_EXPRESSION:
+            generate_array_expression(ob, expr);
+            break;
+        case INDEX_EXPRESSION:
+            count = generate_index_operands(ob, expr);
+            if (count == 1) {
+                generate_code(ob, expr->line_number, PUSH_ARRAY_ELEMENT_OP);
+            } else {
+                generate_code(ob, expr->line_number, PUSH_ARRAY_ELEMENT_N_OP,
+                              count);
+            }
+            break;
+        case INCREMENT_EXPRESSION:
+        case DECREMENT_EXPRESSION:
+            generate_inc_dec_expression(ob, expr);
+            break;
+        case MEMBER_EXPRESSION:
+            generate_field_code(ob, expr, PUSH_FIELD_OP);
+            break;
+        case INT_ADD_EXPRESSION:
+        case INT_SUB_EXPRESSION:
+        case INT_MUL_EXPRESSION:
+        case INT_EQ_EXPRESSION:
+        case INT_NE_EXPRESSION:
+        case INT_GT_EXPRESSION:
+        case INT_GE_EXPRESSION:
+        case INT_LT_EXPRESSION:
+        case INT_LE_EXPRESSION:
+        case EXPRESSION_TYPE_COUNT_PLUS_1:
+        default:
+            DBG_panic(("bad case. type..%d\n", expr->type));
+    }
+}
+
+static void generate_pop_expression(OpcodeBuf *ob, Expression *expr)
+{
+    generate_expression(ob, expr);
+    generate_code(ob, expr->line_number, POP_OP);
+}
+
+static void generate_return_none(OpcodeBuf *ob, int line_number)
+{
+    generate_code(ob, line_number, PUSH_NONE_OP);
+    generate_code(ob, line_number, RETURN_OP);
+}
+
+static void generate_global_statement(OpcodeBuf *ob, Statement *statement)
+{
+    Constant c;
+
+    c.type = IDENTIFIER_LIST_CONSTANT;
+    c.u.identifier_list = statement->u.global_s.identifier_list;
+    generate_code(ob, statement->line_number, GLOBAL_OP,
+                  add_constant(ob, &c));
+}
+
+static void generate_condition(OpcodeBuf *ob, Expression *condition,
+                               int false_label)
+{
+    generate_expression(ob, condition);
+    generate_code(ob, condition->line_number, JUMP_IF_FALSE_OP, false_label);
+}
+
+static void generate_if_statement(OpcodeBuf *ob, LoopLabel *loop,
+                                  Statement *statement)
+{
+    IfStatement *if_s = &statement->u.if_s;
+    Elif *pos;
+    int end_label;
+    int false_label;
+
+    end_label = get_label(ob);
+    false_label = get_label(ob);
+    generate_condition(ob, if_s->condition, false_label);
+    generate_statement_list(ob, loop, if_s->then_block->statement_list);
+    generate_code(ob, statement->line_number, JUMP_OP, end_label);
+    set_label(ob, false_label);
+
+    for (pos = if_s->elif_list; pos; pos = pos->next) {
+        false_label = get_label(ob);
+        generate_condition(ob, pos->condition, false_label);
+        generate_statement_list(ob, loop, pos->block->statement_list);
+        generate_code(ob, statement->line_number, JUMP_OP, end_label);
+        set_label(ob, false_label);
+    }
+    if (if_s->else_block) {
+        generate_statement_list(ob, loop, if_s->else_block->statement_list);
+    }
+    set_label(ob, end_label);
+}
+
+static void generate_while_statement(OpcodeBuf *ob, Statement *statement)
+{
+    LoopLabel loop;
+
+    loop.break_label = get_label(ob);
+    loop.continue_label = get_label(ob);
+
+    set_label(ob, loop.continue_label);
+    generate_condition(ob, statement->u.while_s.condition, loop.break_label);
+    generate_statement_list(ob, &loop,
+                            statement->u.while_s.block->statement_list);
+    generate_code(ob, statement->line_number, JUMP_OP, loop.continue_label);
+    set_label(ob, loop.break_label);
+}
+
+static void generate_for_statement(OpcodeBuf *ob, Statement *statement)
+{
+    ForStatement *for_s = &statement->u.for_s;
+    LoopLabel loop;
+    int loop_label;
+
+    if (for_s->init) {
+        generate_pop_expression(ob, for_s->init);
+    }
+    loop.break_label = get_label(ob);
+    loop.continue_label = get_label(ob);
+    loop_label = get_label(ob);
+
+    set_label(ob, loop_label);
+    if (for_s->condition) {
+        generate_condition(ob, for_s->condition, loop.break_label);
+    }
+    generate_statement_list(ob, &loop, for_s->block->statement_list);
+    set_label(ob, loop.continue_label);
+    if (for_s->post) {
+        generate_pop_expression(ob, for_s->post);
+    }
+    generate_code(ob, statement->line_number, JUMP_OP, loop_label);
+    set_label(ob, loop.break_label);
+}
+
+static void generate_return_statement(OpcodeBuf *ob, Statement *statement)
+{
+    if (statement->u.return_s.return_value) {
+        generate_expression(ob, statement->u.return_s.return_value);
+        generate_code(ob, statement->line_number, RETURN_OP);
+    } else {
+        generate_return_none(ob, statement->line_number);
+    }
+}
+
+/*
+ * break/continue outside of a loop end the enclosing function (or the
+ * top level) just like the AST walker, which lets the result propagate.
+ */
+static void generate_break_continue_statement(OpcodeBuf *ob, LoopLabel *loop,
+                                              Statement *statement)
+{
+    if (loop == NULL) {
+        generate_return_none(ob, statement->line_number);
+    } else if (statement->type == BREAK_STATEMENT) {
+        generate_code(ob, statement->line_number, JUMP_OP, loop->break_label);
+    } else {
+        generate_code(ob, statement->line_number, JUMP_OP,
+                      loop->continue_label);
+    }
+}
+
+static void generate_statement_list(OpcodeBuf *ob, LoopLabel *loop,
+                                    StatementList *statement_list)
+{
+    StatementList *pos;
+
+    for (pos = statement_list; pos; pos = pos->next) {
+        Statement *statement = pos->statement;
+        switch (statement->type) {
+            case EXPRESSION_STATEMENT:
+                generate_pop_expression(ob, statement->u.expression_s);
+                break;
+            case GLOBAL_STATEMENT:
+                generate_global_statement(ob, statement);
+                break;
+            case IF_STATEMENT:
+                generate_if_statement(ob, loop, statement);
+                break;
+            case WHILE_STATEMENT:
+                generate_while_statement(ob, statement);
+                break;
+            case FOR_STATEMENT:
+                generate_for_statement(ob, statement);
+                break;
+            case RETURN_STATEMENT:
+                generate_return_statement(ob, statement);
+                break;
+            case BREAK_STATEMENT:
+            case CONTINUE_STATEMENT:
+                generate_break_continue_statement(ob, loop, statement);
+                break;
+            case STATEMENT_TYPE_COUNT_PLUS_1:
+            default:
+                DBG_panic(("bad case...%d", statement->type));
+        }
+    }
+}
+
+static void fix_labels(OpcodeBuf *ob)
+{
+    int i;
+    int j;
+    OpcodeInfo *info;
+
+    for (i = 0; i < ob->size; i += 1 + info->operand_count) {
+        info = &st_opcode_info[ob->code[i]];
+        if (ob->code[i] == JUMP_OP || ob->code[i] == JUMP_IF_FALSE_OP
+            || ob->code[i] == LOGICAL_AND_OP || ob->code[i] == LOGICAL_OR_OP) {
+            j = ob->code[i+1];
+            ob->code[i+1] = ob->label_table[j].label_address;
+        }
+    }
+}
+
+static Executable * fix_opcode_buf(OpcodeBuf *ob)
+{
+    Executable *exe;
+
+    fix_labels(ob);
+    if (ob->line_number_size > 0) {
+        ob->line_number[ob->line_number_size-1].pc_count
+            = ob->size - ob->line_number[ob->line_number_size-1].start_pc;
+    }
+    exe = MEM_malloc(sizeof(Executable));
+    exe->code_size = ob->size;
+    exe->code = MEM_realloc(ob->code, sizeof(int) * ob->size);
+    exe->constant_count = ob->constant_count;
+    exe->constant = ob->constant;
+    exe->line_number_size = ob->line_number_size;
+    exe->line_number = ob->line_number;
+    exe->need_stack_size = ob->need_stack_size;
+    exe->local_variable = NULL;
+    MEM_free(ob->label_table);
+
+    return exe;
+}
+
+static Executable * generate_executable(StatementList *statement_list,
+                                        int last_line_number)
+{
+    OpcodeBuf ob;
+
+    init_opcode_buf(&ob);
+    generate_statement_list(&ob, NULL, statement_list);
+    generate_return_none(&ob, last_line_number);
+
+    return fix_opcode_buf(&ob);
+}
+
+void mrsk_generate(MRSK_Interpreter *inter)
+{
+    FunctionDefinition *pos;
+
+    for (pos = inter->function_list; pos; pos = pos->next) {
+        if (pos->type != MURASAKI_FUNCTION_DEFINITION) {
+            continue;
+        }
+        pos->u.murasaki_f.executable
+            = generate_executable(pos->u.murasaki_f.block->statement_list,
+                                  inter->current_line_number);
+        pos->u.murasaki_f.executable->local_variable
+            = pos->u.murasaki_f.local_variable;
+    }
+    inter->executable = generate_executable(inter->statement_list,
+                                            inter->current_line_number);
+}
+
+void mrsk_dispose_executable(Executable *exe)
+{
+    MEM_free(exe->code);
+    MEM_free(exe->constant);
+    MEM_free(exe->line_number);
+    MEM_free(exe);
+}
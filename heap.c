@@ -1,36 +1,161 @@
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
+#include <time.h>
 #include "MEM.h"
 #include "DBG.h"
 #include "murasaki.h"
 
+#define FREE_SLOT       ((ObjectType)0)
+
+/* Allocation skips over chunks with fewer free slots than this. */
+#define CHUNK_RECYCLE_FREE_COUNT        (HEAP_CHUNK_SIZE / 8)
+
+#define chunk_of(obj) \
+    ((HeapChunk*)((char*)((obj) - (obj)->slot) \
+                  - offsetof(HeapChunk, object)))
+
+static void minor_collect(MRSK_Interpreter *inter);
+static void start_major_collection(MRSK_Interpreter *inter);
+static void major_slice(MRSK_Interpreter *inter);
+static void record_pause(GCStat *stat, clock_t pause);
+
+/*
+ * A minor collection whenever the nursery fills up.  A major collection
+ * starts when the heap has doubled since the last one finished, and
+ * then goes on a slice at a time, after each minor collection, so that
+ * no pause is much longer than a minor collection and a slice.
+ */
 static void check_gc(MRSK_Interpreter *inter)
 {
+    Heap *heap = &inter->heap;
+    clock_t start;
+    clock_t minor_end;
+
 #if 0
-    mrsk_garbage_collect(inter);
+    heap->current_threshold = 0;
+    heap->major_threshold = 0;
 #endif
-    if (inter->heap.current_heap_size > inter->heap.current_threshold) {
-        /* fprintf(stderr, "garbage collecting..."); */
-        mrsk_garbage_collect(inter);
-        /* fprintf(stderr, "done.\n"); */
+    if (heap->current_heap_size > heap->current_threshold) {
+        start = clock();
+        minor_collect(inter);
+        minor_end = clock();
+        if (heap->phase == GC_IDLE
+            && heap->current_heap_size > heap->major_threshold) {
+            start_major_collection(inter);
+        }
+        if (heap->phase != GC_IDLE) {
+            major_slice(inter);
+        }
+        heap->current_threshold = heap->current_heap_size + NURSERY_SIZE;
+        heap->stat.minor_time += minor_end - start;
+        heap->stat.major_time += clock() - minor_end;
+        record_pause(&heap->stat, clock() - start);
+    }
+}
 
-        inter->heap.current_threshold
-            = inter->heap.current_heap_size + HEAP_THRESHOLD_SIZE;
+static HeapChunk * recyclable_chunk(HeapChunk *chunk)
+{
+    for (; chunk; chunk = chunk->next) {
+        if (chunk->free_count >= CHUNK_RECYCLE_FREE_COUNT) {
+            break;
+        }
     }
+    return chunk;
 }
 
-static MRSK_Object * alloc_object(MRSK_Interpreter *inter, ObjectType type)
+static HeapChunk * new_chunk(Heap *heap)
+{
+    HeapChunk *chunk;
+    int i;
+
+    chunk = MEM_malloc(sizeof(HeapChunk));
+    for (i = 0; i < HEAP_CHUNK_SIZE; i++) {
+        chunk->object[i].type = FREE_SLOT;
+    }
+    chunk->free_count = HEAP_CHUNK_SIZE;
+    chunk->next = heap->chunk;
+    heap->chunk = chunk;
+
+    return chunk;
+}
+
+/*
+ * The cursor only moves forward between collections, as nothing is freed
+ * meanwhile; each collection starts it over at the first chunk worth
+ * recycling.
+ */
+static MRSK_Object * take_free_slot(Heap *heap)
+{
+    HeapChunk *chunk = heap->current_chunk;
+    MRSK_Object *obj;
+
+    for (;;) {
+        for (; chunk && heap->cursor < HEAP_CHUNK_SIZE; heap->cursor++) {
+            obj = &chunk->object[heap->cursor];
+            if (obj->type == FREE_SLOT) {
+                obj->slot = heap->cursor;
+                heap->cursor++;
+                chunk->free_count--;
+                return obj;
+            }
+        }
+        chunk = chunk ? recyclable_chunk(chunk->next) : NULL;
+        if (chunk == NULL) {
+            chunk = new_chunk(heap);
+        }
+        heap->current_chunk = chunk;
+        heap->cursor = 0;
+    }
+}
+
+static void free_slot(MRSK_Object *obj)
+{
+    obj->type = FREE_SLOT;
+    chunk_of(obj)->free_count++;
+}
+
+static void reset_cursor(Heap *heap)
+{
+    heap->current_chunk = recyclable_chunk(heap->chunk);
+    heap->cursor = 0;
+}
+
+/* Chunks with nothing left in them go back to the system. */
+static void release_empty_chunks(Heap *heap)
+{
+    HeapChunk **pos;
+    HeapChunk *chunk;
+
+    for (pos = &heap->chunk; *pos; ) {
+        chunk = *pos;
+        if (chunk->free_count == HEAP_CHUNK_SIZE) {
+            *pos = chunk->next;
+            MEM_free(chunk);
+        } else {
+            pos = &chunk->next;
+        }
+    }
+    reset_cursor(heap);
+}
+
+/*
+ * Doesn't collect, so it's safe while the only reference to an object
+ * is in a C local; views are made this way.
+ */
+static MRSK_Object * link_object(MRSK_Interpreter *inter, ObjectType type)
 {
     MRSK_Object *ret;
 
-    check_gc(inter);
-    ret = MEM_malloc(sizeof(MRSK_Object));
+    ret = take_free_slot(&inter->heap);
     inter->heap.current_heap_size += sizeof(MRSK_Object);
     ret->type = type;
     ret->marked = MRSK_FALSE;
+    ret->young = MRSK_TRUE;
+    ret->remembered = MRSK_FALSE;
     ret->prev = NULL;
-    ret->next = inter->heap.header;
-    inter->heap.header = ret;
+    ret->next = inter->heap.young;
+    inter->heap.young = ret;
     if (ret->next) {
         ret->next->prev = ret;
     }
@@ -38,38 +163,234 @@ static MRSK_Object * alloc_object(MRSK_Interpreter *inter, ObjectType type)
     return ret;
 }
 
-static void add_ref_in_native_method(MRSK_LocalEnvironment *env,
+static MRSK_Object * alloc_object(MRSK_Interpreter *inter, ObjectType type)
+{
+    check_gc(inter);
+    return link_object(inter, type);
+}
+
+/* The object stays rooted until the calling native's environment is popped. */
+static void add_ref_in_native_method(MRSK_Interpreter *inter,
                                      MRSK_Object *obj)
 {
-    RefInNativeFunc *new_ref;
+    CallFrameStack *fs = &inter->frame_stack;
 
-    new_ref = MEM_malloc(sizeof(RefInNativeFunc));
-    new_ref->object = obj;
-    new_ref->next = env->ref_in_native_method;
-    env->ref_in_native_method = new_ref;
+    if (fs->ref_count == fs->ref_alloc_size) {
+        fs->ref_alloc_size += NATIVE_REF_ALLOC_SIZE;
+        fs->ref = MEM_realloc(fs->ref,
+                              sizeof(MRSK_Object*) * fs->ref_alloc_size);
+    }
+    fs->ref[fs->ref_count] = obj;
+    fs->ref_count++;
 }
 
+/*
+ * Literal strings live in interpreter_storage, outside the heap list, and
+ * are created already marked, so the collector never looks into or frees
+ * them.
+ */
 MRSK_Object * mrsk_literal_to_mrsk_string(MRSK_Interpreter *inter,
                                           char *str)
 {
     MRSK_Object *ret;
 
-    ret = alloc_object(inter, STRING_OBJECT);
+    ret = MEM_storage_malloc(inter->interpreter_storage,
+                             sizeof(MRSK_Object));
+    ret->type = STRING_OBJECT;
+    ret->marked = MRSK_TRUE;
+    ret->young = MRSK_FALSE;
+    ret->remembered = MRSK_FALSE;
     ret->u.string.string = str;
+    ret->u.string.length = strlen(str);
+    ret->u.string.buffer = NULL;
+    ret->u.string.has_hash = MRSK_TRUE;
+    ret->u.string.hash = mrsk_hash_string(str);
     ret->u.string.is_literal = MRSK_TRUE;
+    ret->prev = NULL;
+    ret->next = NULL;
 
     return ret;
 }
 
-MRSK_Object * mrsk_create_murasaki_string_i(MRSK_Interpreter *inter,
-                                            char *str)
+/* The caller fills in the characters; string points to short_string. */
+static MRSK_Object * alloc_string(MRSK_Interpreter *inter, int length)
 {
     MRSK_Object *ret;
 
     ret = alloc_object(inter, STRING_OBJECT);
-    ret->u.string.string = str;
-    inter->heap.current_heap_size += strlen(str) + 1;
+    ret->u.string.string = ret->u.string.short_string;
+    ret->u.string.length = length;
+    ret->u.string.buffer = NULL;
     ret->u.string.is_literal = MRSK_FALSE;
+    ret->u.string.has_hash = MRSK_FALSE;
+
+    return ret;
+}
+
+/* Takes over str, a MEM_malloc()ed string. */
+MRSK_Object * mrsk_create_murasaki_string_i(MRSK_Interpreter *inter,
+                                            char *str)
+{
+    MRSK_Object *ret;
+    int length = strlen(str);
+
+    ret = alloc_string(inter, length);
+    if (length < SHORT_STRING_SIZE) {
+        memcpy(ret->u.string.short_string, str, length + 1);
+        MEM_free(str);
+    } else {
+        ret->u.string.string = str;
+        inter->heap.current_heap_size += length + 1;
+    }
+
+    return ret;
+}
+
+#define STRING_BUFFER_MIN_SIZE  (32)
+#define string_buffer_chars(buf) ((char*)((buf) + 1))
+
+static StringBuffer *alloc_string_buffer(MRSK_Interpreter *inter,
+                                         int alloc_size)
+{
+    StringBuffer *buf;
+
+    buf = MEM_malloc(sizeof(StringBuffer) + alloc_size);
+    buf->ref_count = 1;
+    buf->alloc_size = alloc_size;
+    buf->length = 0;
+    inter->heap.current_heap_size += sizeof(StringBuffer) + alloc_size;
+
+    return buf;
+}
+
+static void release_string_buffer(MRSK_Interpreter *inter, StringBuffer *buf)
+{
+    buf->ref_count--;
+    if (buf->ref_count == 0) {
+        inter->heap.current_heap_size -= sizeof(StringBuffer) + buf->alloc_size;
+        MEM_free(buf);
+    }
+}
+
+/*
+ * left + right.  When left is the longest string in its buffer and the
+ * buffer has room, right is appended in place and the result shares the
+ * buffer, so s = s + x in a loop is amortized O(length of x).  Otherwise
+ * a short result is stored inline and a longer one gets a new buffer
+ * with twice the room it needs.
+ */
+MRSK_Object * mrsk_chain_string(MRSK_Interpreter *inter, MRSK_Object *left,
+                                char *right, int right_length)
+{
+    MRSK_Object *ret;
+    StringBuffer *buf = left->u.string.buffer;
+    int left_length = left->u.string.length;
+    int length = left_length + right_length;
+    int alloc_size;
+
+    if (buf && buf->length == left_length && length < buf->alloc_size) {
+        buf->ref_count++;
+    } else if (length < SHORT_STRING_SIZE) {
+        ret = alloc_string(inter, length);
+        memcpy(ret->u.string.short_string, left->u.string.string, left_length);
+        memcpy(ret->u.string.short_string + left_length, right, right_length);
+        ret->u.string.short_string[length] = '\0';
+        return ret;
+    } else {
+        alloc_size = (length + 1) * 2;
+        if (alloc_size < STRING_BUFFER_MIN_SIZE) {
+            alloc_size = STRING_BUFFER_MIN_SIZE;
+        }
+        buf = alloc_string_buffer(inter, alloc_size);
+        memcpy(string_buffer_chars(buf), left->u.string.string, left_length);
+    }
+    memcpy(string_buffer_chars(buf) + left_length, right, right_length);
+    string_buffer_chars(buf)[length] = '\0';
+    buf->length = length;
+
+    ret = alloc_string(inter, length);
+    ret->u.string.string = string_buffer_chars(buf);
+    ret->u.string.buffer = buf;
+
+    return ret;
+}
+
+/*
+ * A string that shares its buffer with a longer one, or a slice of a
+ * literal, is not terminated at its own length; give it characters of
+ * its own before handing them out.
+ */
+char * mrsk_get_string_chars(MRSK_Interpreter *inter, MRSK_Object *obj)
+{
+    MRSK_String *str = &obj->u.string;
+    StringBuffer *buf;
+    char *chars;
+
+    if (str->is_literal && str->string[str->length] != '\0') {
+        /* a slice() of a literal */
+        chars = MEM_malloc(str->length + 1);
+        memcpy(chars, str->string, str->length);
+        chars[str->length] = '\0';
+        inter->heap.current_heap_size += str->length + 1;
+        str->string = chars;
+        str->is_literal = MRSK_FALSE;
+    } else if (str->buffer && str->buffer->length != str->length
+        && str->length < SHORT_STRING_SIZE) {
+        memcpy(str->short_string, str->string, str->length);
+        str->short_string[str->length] = '\0';
+        release_string_buffer(inter, str->buffer);
+        str->buffer = NULL;
+        str->string = str->short_string;
+    } else if (str->buffer && str->buffer->length != str->length) {
+        buf = alloc_string_buffer(inter, str->length + 1);
+        memcpy(string_buffer_chars(buf), str->string, str->length);
+        string_buffer_chars(buf)[str->length] = '\0';
+        buf->length = str->length;
+        release_string_buffer(inter, str->buffer);
+        str->buffer = buf;
+        str->string = string_buffer_chars(buf);
+    }
+    return str->string;
+}
+
+/*
+ * The characters [start, end) of obj.  A long one shares obj's buffer,
+ * as the strings chained onto one do, so it costs no copy; obj is given
+ * a buffer first if its characters are a malloc()ed string of their
+ * own.  A literal's characters live as long as the interpreter, so a
+ * slice of one just points into them.
+ */
+MRSK_Object * mrsk_string_slice(MRSK_Interpreter *inter, MRSK_Object *obj,
+                                int start, int end)
+{
+    MRSK_String *str = &obj->u.string;
+    MRSK_Object *ret;
+    StringBuffer *buf;
+    int length = end - start;
+
+    ret = alloc_string(inter, length);
+    if (length < SHORT_STRING_SIZE) {
+        memcpy(ret->u.string.short_string, str->string + start, length);
+        ret->u.string.short_string[length] = '\0';
+        return ret;
+    }
+    if (str->is_literal) {
+        ret->u.string.string = str->string + start;
+        ret->u.string.is_literal = MRSK_TRUE;
+        return ret;
+    }
+    if (str->buffer == NULL) {
+        buf = alloc_string_buffer(inter, str->length + 1);
+        memcpy(string_buffer_chars(buf), str->string, str->length + 1);
+        buf->length = str->length;
+        inter->heap.current_heap_size -= str->length + 1;
+        MEM_free(str->string);
+        str->buffer = buf;
+        str->string = string_buffer_chars(buf);
+    }
+    str->buffer->ref_count++;
+    ret->u.string.buffer = str->buffer;
+    ret->u.string.string = str->string + start;
 
     return ret;
 }
@@ -81,20 +402,204 @@ MRSK_Object * MRSK_create_murasaki_string(MRSK_Interpreter *inter,
     MRSK_Object *ret;
 
     ret = mrsk_create_murasaki_string_i(inter, str);
-    add_ref_in_native_method(env, ret);
+    add_ref_in_native_method(inter, ret);
 
     return ret;
 }
 
-MRSK_Object * mrsk_create_array_i(MRSK_Interpreter *inter, int size)
+/* Same function as mrsk_hash_string(), over the string's length. */
+unsigned int mrsk_get_string_hash(MRSK_Object *obj)
+{
+    MRSK_String *str = &obj->u.string;
+    unsigned int h = 0;
+    int i;
+
+    if (!str->has_hash) {
+        for (i = 0; i < str->length; i++) {
+            h = h * 31 + (unsigned char)str->string[i];
+        }
+        str->hash = h;
+        str->has_hash = MRSK_TRUE;
+    }
+    return str->hash;
+}
+
+/*
+ * Different lengths or hashes decide inequality without looking at the
+ * characters; hashes are only compared once both are known.
+ */
+MRSK_Boolean mrsk_string_equals(MRSK_Object *left, MRSK_Object *right)
+{
+    MRSK_String *l = &left->u.string;
+    MRSK_String *r = &right->u.string;
+
+    if (left == right || l->string == r->string) {
+        return l->length == r->length;
+    }
+    if (l->length != r->length) {
+        return MRSK_FALSE;
+    }
+    if (mrsk_get_string_hash(left) != mrsk_get_string_hash(right)) {
+        return MRSK_FALSE;
+    }
+    return memcmp(l->string, r->string, l->length) == 0;
+}
+
+/* strcmp() order; strings never contain '\0', so memcmp() agrees. */
+int mrsk_compare_string(MRSK_Object *left, MRSK_Object *right)
+{
+    MRSK_String *l = &left->u.string;
+    MRSK_String *r = &right->u.string;
+    int cmp;
+
+    cmp = memcmp(l->string, r->string,
+                 l->length < r->length ? l->length : r->length);
+    if (cmp == 0) {
+        cmp = l->length - r->length;
+    }
+    return cmp;
+}
+
+static size_t array_element_size(ObjectType type)
+{
+    if (type == INT_ARRAY_OBJECT) {
+        return sizeof(int);
+    } else if (type == DOUBLE_ARRAY_OBJECT) {
+        return sizeof(double);
+    }
+    DBG_assert(type == ARRAY_OBJECT, ("bad type..%d\n", type));
+    return sizeof(MRSK_Value);
+}
+
+static MRSK_Object * alloc_array(MRSK_Interpreter *inter, ObjectType type,
+                                 int size)
 {
     MRSK_Object *ret;
+    size_t alloc_bytes;
 
-    ret = alloc_object(inter, ARRAY_OBJECT);
+    alloc_bytes = array_element_size(type) * size;
+    ret = alloc_object(inter, type);
     ret->u.array.size = size;
     ret->u.array.alloc_size = size;
-    ret->u.array.array = MEM_malloc(sizeof(MRSK_Value) * size);
-    inter->heap.current_heap_size += sizeof(MRSK_Value) * size;
+    ret->u.array.owner = NULL;
+    ret->u.array.array.value = MEM_malloc(alloc_bytes);
+    inter->heap.current_heap_size += alloc_bytes;
+
+    return ret;
+}
+
+MRSK_Object * mrsk_create_array_i(MRSK_Interpreter *inter, int size)
+{
+    return alloc_array(inter, ARRAY_OBJECT, size);
+}
+
+/* The elements of a typed array start out as 0. */
+MRSK_Object * mrsk_create_typed_array_i(MRSK_Interpreter *inter,
+                                        ObjectType type, int size)
+{
+    MRSK_Object *ret;
+
+    DBG_assert(type == INT_ARRAY_OBJECT || type == DOUBLE_ARRAY_OBJECT,
+               ("bad type..%d\n", type));
+    ret = alloc_array(inter, type, size);
+    memset(ret->u.array.array.value, 0, array_element_size(type) * size);
+
+    return ret;
+}
+
+/* dim[0..rank-1] are the sizes; the elements start out as None. */
+MRSK_Object * mrsk_create_multi_array_i(MRSK_Interpreter *inter,
+                                        int rank, int *dim)
+{
+    MRSK_Object *ret;
+    MRSK_MultiArray *multi;
+    int total;
+    int i;
+
+    DBG_assert(rank >= 2, ("rank..%d\n", rank));
+    ret = alloc_object(inter, MULTI_ARRAY_OBJECT);
+    multi = &ret->u.multi_array;
+    multi->rank = rank;
+    multi->dim = MEM_malloc(sizeof(int) * rank);
+    multi->stride = MEM_malloc(sizeof(int) * rank);
+    multi->owner = NULL;
+    total = 1;
+    for (i = rank - 1; i >= 0; i--) {
+        multi->dim[i] = dim[i];
+        multi->stride[i] = total;
+        total *= dim[i];
+    }
+    multi->element = MEM_malloc(sizeof(MRSK_Value) * total);
+    for (i = 0; i < total; i++) {
+        multi->element[i].type = MRSK_NONE_VALUE;
+    }
+    inter->heap.current_heap_size
+        += sizeof(MRSK_Value) * total + sizeof(int) * rank * 2;
+
+    return ret;
+}
+
+/*
+ * The view of obj's element[offset...] after index_count subscripts
+ * (fewer than obj's rank); it shares obj's storage.
+ */
+MRSK_Object * mrsk_create_multi_array_view(MRSK_Interpreter *inter,
+                                           MRSK_Object *obj, int index_count,
+                                           int offset)
+{
+    MRSK_MultiArray *multi = &obj->u.multi_array;
+    MRSK_Object *owner = multi->owner ? multi->owner : obj;
+    MRSK_Object *ret;
+
+    DBG_assert(index_count < multi->rank,
+               ("index_count..%d, rank..%d\n", index_count, multi->rank));
+    if (index_count == multi->rank - 1) {
+        ret = link_object(inter, ARRAY_OBJECT);
+        ret->u.array.size = multi->dim[index_count];
+        ret->u.array.alloc_size = ret->u.array.size;
+        ret->u.array.array.value = multi->element + offset;
+        ret->u.array.owner = owner;
+    } else {
+        ret = link_object(inter, MULTI_ARRAY_OBJECT);
+        ret->u.multi_array.rank = multi->rank - index_count;
+        ret->u.multi_array.dim = multi->dim + index_count;
+        ret->u.multi_array.stride = multi->stride + index_count;
+        ret->u.multi_array.element = multi->element + offset;
+        ret->u.multi_array.owner = owner;
+    }
+
+    return ret;
+}
+
+/* The table is allocated on the first set. */
+MRSK_Object * mrsk_create_map_i(MRSK_Interpreter *inter)
+{
+    MRSK_Object *ret;
+
+    ret = alloc_object(inter, MAP_OBJECT);
+    ret->u.map.count = 0;
+    ret->u.map.capacity = 0;
+    ret->u.map.entry = NULL;
+
+    return ret;
+}
+
+/* The fields start out as None. */
+MRSK_Object * mrsk_create_record_i(MRSK_Interpreter *inter,
+                                   RecordShape *shape)
+{
+    MRSK_Object *ret;
+    size_t alloc_bytes;
+    int i;
+
+    alloc_bytes = sizeof(MRSK_Value) * shape->field_count;
+    ret = alloc_object(inter, RECORD_OBJECT);
+    ret->u.record.shape = shape;
+    ret->u.record.field = MEM_malloc(alloc_bytes);
+    for (i = 0; i < shape->field_count; i++) {
+        ret->u.record.field[i].type = MRSK_NONE_VALUE;
+    }
+    inter->heap.current_heap_size += alloc_bytes;
 
     return ret;
 }
@@ -106,87 +611,373 @@ MRSK_Object * MRSK_create_array(MRSK_Interpreter *inter,
     MRSK_Object *ret;
 
     ret = mrsk_create_array_i(inter, size);
-    add_ref_in_native_method(env, ret);
+    add_ref_in_native_method(inter, ret);
 
     return ret;
 }
 
-void mrsk_array_add(MRSK_Interpreter *inter, MRSK_Object *obj, MRSK_Value v)
+/* Typed arrays box their element on the way out. */
+MRSK_Value mrsk_fetch_array_element(MRSK_Object *obj, int index)
 {
-    int new_size;
+    MRSK_Value ret;
 
-    DBG_assert(obj->type==ARRAY_OBJECT, ("bad type..%d\n", obj->type));
+    if (obj->type == INT_ARRAY_OBJECT) {
+        ret.type = MRSK_INT_VALUE;
+        ret.u.int_value = obj->u.array.array.int_value[index];
+    } else if (obj->type == DOUBLE_ARRAY_OBJECT) {
+        ret.type = MRSK_DOUBLE_VALUE;
+        ret.u.double_value = obj->u.array.array.double_value[index];
+    } else {
+        DBG_assert(obj->type == ARRAY_OBJECT, ("bad type..%d\n", obj->type));
+        ret = obj->u.array.array.value[index];
+    }
 
-    check_gc(inter);
-    if (obj->u.array.size + 1 > obj->u.array.alloc_size) {
-        new_size = obj->u.array.alloc_size * 2;
-        if (new_size == 0
-            || new_size - obj->u.array.alloc_size > ARRAY_ALLOC_SIZE) {
-            new_size = obj->u.array.alloc_size + ARRAY_ALLOC_SIZE;
+    return ret;
+}
+
+/*
+ * An int_array takes only ints; a double_array takes doubles, and ints
+ * which it converts.
+ */
+void mrsk_store_array_element(MRSK_Interpreter *inter, MRSK_Object *obj,
+                              int index, MRSK_Value *v, int line_number)
+{
+    if (obj->type == INT_ARRAY_OBJECT) {
+        if (v->type != MRSK_INT_VALUE) {
+            mrsk_runtime_error(line_number, TYPED_ARRAY_ELEMENT_TYPE_ERR,
+                               STRING_MESSAGE_ARGUMENT, "name", "int_array",
+                               STRING_MESSAGE_ARGUMENT, "type", "int",
+                               MESSAGE_ARGUMENT_END);
+        }
+        obj->u.array.array.int_value[index] = v->u.int_value;
+    } else if (obj->type == DOUBLE_ARRAY_OBJECT) {
+        if (v->type == MRSK_DOUBLE_VALUE) {
+            obj->u.array.array.double_value[index] = v->u.double_value;
+        } else if (v->type == MRSK_INT_VALUE) {
+            obj->u.array.array.double_value[index] = v->u.int_value;
+        } else {
+            mrsk_runtime_error(line_number, TYPED_ARRAY_ELEMENT_TYPE_ERR,
+                               STRING_MESSAGE_ARGUMENT, "name", "double_array",
+                               STRING_MESSAGE_ARGUMENT, "type", "double",
+                               MESSAGE_ARGUMENT_END);
+        }
+    } else {
+        DBG_assert(obj->type == ARRAY_OBJECT, ("bad type..%d\n", obj->type));
+        mrsk_write_barrier(inter,
+                           obj->u.array.owner ? obj->u.array.owner : obj,
+                           &obj->u.array.array.value[index], v);
+        obj->u.array.array.value[index] = *v;
+    }
+}
+
+/*
+ * The elements [start, end) of obj, sharing its storage.  The storage
+ * is moved to a hidden array which both obj and the slice then view, so
+ * it lives as long as either does; whichever is written to first gets
+ * elements of its own through mrsk_array_unshare().  A slice of a row
+ * of a multi dimensional array is a window onto it, as the row is.
+ */
+MRSK_Object * mrsk_array_slice(MRSK_Interpreter *inter, MRSK_Object *obj,
+                               int start, int end)
+{
+    MRSK_Object *owner = obj->u.array.owner;
+    MRSK_Object *ret;
+
+    if (owner == NULL) {
+        /* obj's elements are about to be found only through owner */
+        if (obj->type == ARRAY_OBJECT) {
+            mrsk_shade_values(inter, obj, obj->u.array.array.value,
+                              obj->u.array.size);
         }
-        obj->u.array.array = MEM_realloc(obj->u.array.array,
-                                         new_size * sizeof(MRSK_Value));
-        inter->heap.current_heap_size
-            += (new_size - obj->u.array.alloc_size) * sizeof(MRSK_Value);
-        obj->u.array.alloc_size = new_size;
+        owner = link_object(inter, obj->type);
+        owner->u.array = obj->u.array;
+        obj->u.array.alloc_size = obj->u.array.size;
+        obj->u.array.owner = owner;
+        mrsk_remember_object(inter, obj);
+    }
+    ret = link_object(inter, obj->type);
+    ret->u.array.size = end - start;
+    ret->u.array.alloc_size = ret->u.array.size;
+    ret->u.array.array.value
+        = (MRSK_Value*)((char*)obj->u.array.array.value
+                        + array_element_size(obj->type) * start);
+    ret->u.array.owner = owner;
+
+    return ret;
+}
+
+/*
+ * Called before obj's elements are written or its size changes.  The
+ * copy doesn't collect: the value being stored may be only in a C
+ * local.
+ */
+void mrsk_array_unshare(MRSK_Interpreter *inter, MRSK_Object *obj)
+{
+    MRSK_Object *owner = obj->u.array.owner;
+    size_t bytes;
+    void *elements;
+
+    if (owner == NULL || owner->type == MULTI_ARRAY_OBJECT) {
+        return;
     }
-    obj->u.array.array[obj->u.array.size] = v;
+    bytes = array_element_size(obj->type) * obj->u.array.size;
+    elements = MEM_malloc(bytes);
+    memcpy(elements, obj->u.array.array.value, bytes);
+    inter->heap.current_heap_size += bytes;
+    if (obj->type == ARRAY_OBJECT) {
+        mrsk_remember_object(inter, obj);
+    }
+    obj->u.array.array.value = elements;
+    obj->u.array.alloc_size = obj->u.array.size;
+    obj->u.array.owner = NULL;
+}
+
+/*
+ * Only a reallocation can grow the heap, so it's the only place an
+ * array operation gives the collector a chance to run.
+ */
+static void realloc_array(MRSK_Interpreter *inter, MRSK_Object *obj,
+                          int new_alloc_size)
+{
+    size_t element_size = array_element_size(obj->type);
+
+    if (new_alloc_size > obj->u.array.alloc_size) {
+        check_gc(inter);
+    }
+    obj->u.array.array.value = MEM_realloc(obj->u.array.array.value,
+                                           new_alloc_size * element_size);
+    inter->heap.current_heap_size
+        += (new_alloc_size - obj->u.array.alloc_size) * (int)element_size;
+    obj->u.array.alloc_size = new_alloc_size;
+}
+
+/* Doubles the capacity (at least ARRAY_MIN_ALLOC_SIZE) until size fits. */
+static void grow_array(MRSK_Interpreter *inter, MRSK_Object *obj, int size)
+{
+    int new_alloc_size;
+
+    if (size <= obj->u.array.alloc_size) {
+        return;
+    }
+    new_alloc_size = obj->u.array.alloc_size * 2;
+    if (new_alloc_size < ARRAY_MIN_ALLOC_SIZE) {
+        new_alloc_size = ARRAY_MIN_ALLOC_SIZE;
+    }
+    if (new_alloc_size < size) {
+        new_alloc_size = size;
+    }
+    realloc_array(inter, obj, new_alloc_size);
+}
+
+void mrsk_array_add(MRSK_Interpreter *inter, MRSK_Object *obj, MRSK_Value v,
+                    int line_number)
+{
+    DBG_assert(mrsk_is_array_object(obj->type),
+               ("bad type..%d\n", obj->type));
+
+    mrsk_array_unshare(inter, obj);
+    grow_array(inter, obj, obj->u.array.size + 1);
+    if (obj->type == ARRAY_OBJECT) {
+        /* so that the write barrier doesn't shade what was left there */
+        obj->u.array.array.value[obj->u.array.size].type = MRSK_NONE_VALUE;
+    }
+    mrsk_store_array_element(inter, obj, obj->u.array.size, &v, line_number);
     obj->u.array.size++;
 }
 
+/*
+ * New elements are None, or 0 in a typed array.  Growing never shrinks
+ * the capacity; shrink_to_fit() does that.
+ */
 void mrsk_array_resize(MRSK_Interpreter *inter, MRSK_Object *obj, int new_size)
 {
-    int new_alloc_size;
-    MRSK_Boolean need_realloc;
     int i;
 
-    check_gc(inter);
-    
-    if (new_size > obj->u.array.alloc_size) {
-        new_alloc_size = obj->u.array.alloc_size * 2;
-        if (new_alloc_size < new_size) {
-            new_alloc_size = new_size + ARRAY_ALLOC_SIZE;
-        } else if (new_alloc_size - obj->u.array.alloc_size
-                   > ARRAY_ALLOC_SIZE) {
-            new_alloc_size = obj->u.array.alloc_size + ARRAY_ALLOC_SIZE;
+    DBG_assert(new_size >= 0, ("new_size..%d\n", new_size));
+    mrsk_array_unshare(inter, obj);
+    if (obj->type == ARRAY_OBJECT && new_size < obj->u.array.size) {
+        mrsk_shade_values(inter, obj->u.array.owner ? obj->u.array.owner : obj,
+                          obj->u.array.array.value + new_size,
+                          obj->u.array.size - new_size);
+    }
+    grow_array(inter, obj, new_size);
+    if (obj->type == ARRAY_OBJECT) {
+        for (i = obj->u.array.size; i < new_size; i++) {
+            obj->u.array.array.value[i].type = MRSK_NONE_VALUE;
         }
-        need_realloc = MRSK_TRUE;
-    } else if (obj->u.array.alloc_size - new_size > ARRAY_ALLOC_SIZE) {
-        new_alloc_size = new_size;
-        need_realloc = MRSK_TRUE;
+    } else if (new_size > obj->u.array.size) {
+        i = (int)array_element_size(obj->type);
+        memset((char*)obj->u.array.array.value + obj->u.array.size * i, 0,
+               (new_size - obj->u.array.size) * i);
+    }
+    obj->u.array.size = new_size;
+}
+
+void mrsk_array_reserve(MRSK_Interpreter *inter, MRSK_Object *obj, int size)
+{
+    mrsk_array_unshare(inter, obj);
+    if (size > obj->u.array.alloc_size) {
+        realloc_array(inter, obj, size);
+    }
+}
+
+/* Keeps at least one slot, as realloc() to 0 bytes may return NULL. */
+void mrsk_array_shrink_to_fit(MRSK_Interpreter *inter, MRSK_Object *obj)
+{
+    int new_alloc_size = obj->u.array.size > 0 ? obj->u.array.size : 1;
+
+    mrsk_array_unshare(inter, obj);
+    if (new_alloc_size < obj->u.array.alloc_size) {
+        realloc_array(inter, obj, new_alloc_size);
+    }
+}
+
+typedef void GCMarker(Heap *heap, MRSK_Object *obj);
+
+/*
+ * Marked objects wait on a stack for their children to be marked, so
+ * that a long list doesn't recurse as deep as it is long.  A big array
+ * pushes all its elements at once, so the stack doubles.
+ */
+static void push_object(ObjectStack *stack, MRSK_Object *obj)
+{
+    if (stack->count == stack->alloc_size) {
+        stack->alloc_size = stack->alloc_size
+            ? stack->alloc_size * 2 : OBJECT_STACK_ALLOC_SIZE;
+        stack->object = MEM_realloc(stack->object,
+                                    sizeof(MRSK_Object*) * stack->alloc_size);
+    }
+    stack->object[stack->count] = obj;
+    stack->count++;
+}
+
+static void gc_mark_value(Heap *heap, MRSK_Value *v, GCMarker *mark)
+{
+    if (dkc_is_object_value(v->type)) {
+        mark(heap, v->u.object);
+    }
+}
+
+/*
+ * Marks obj's children from the index-th on, or no more than max of
+ * them if max isn't negative.  *index is left where it stopped, or at
+ * -1 once it got through them all.  Returns how many it looked at.
+ */
+static int gc_mark_children(Heap *heap, MRSK_Object *obj, GCMarker *mark,
+                            int *index, int max)
+{
+    int count;
+    int end;
+    int i;
+
+    /* Typed arrays hold no references; a view's elements are owner's. */
+    if (mrsk_is_array_object(obj->type) && obj->u.array.owner) {
+        mark(heap, obj->u.array.owner);
+        count = 0;
+    } else if (obj->type == MULTI_ARRAY_OBJECT
+               && obj->u.multi_array.owner) {
+        mark(heap, obj->u.multi_array.owner);
+        count = 0;
+    } else if (obj->type == ARRAY_OBJECT) {
+        count = obj->u.array.size;
+    } else if (obj->type == MULTI_ARRAY_OBJECT) {
+        count = obj->u.multi_array.dim[0] * obj->u.multi_array.stride[0];
+    } else if (obj->type == MAP_OBJECT) {
+        count = obj->u.map.capacity;
+    } else if (obj->type == RECORD_OBJECT) {
+        count = obj->u.record.shape->field_count;
     } else {
-        need_realloc = MRSK_FALSE;
+        count = 0;
     }
-    if (need_realloc) {
-        check_gc(inter);
-        obj->u.array.array = MEM_realloc(obj->u.array.array,
-                                         new_alloc_size * sizeof(MRSK_Value));
-        inter->heap.current_heap_size
-            += (new_alloc_size - obj->u.array.alloc_size) * sizeof(MRSK_Value);
-        obj->u.array.alloc_size = new_alloc_size;
+    end = count;
+    if (max >= 0 && end - *index > max) {
+        end = *index + max;
     }
-    for (i = obj->u.array.size; i < new_size; i++) {
-        obj->u.array.array[i].type = MRSK_NONE_VALUE;
+
+    for (i = *index; i < end; i++) {
+        if (obj->type == ARRAY_OBJECT) {
+            gc_mark_value(heap, &obj->u.array.array.value[i], mark);
+        } else if (obj->type == MULTI_ARRAY_OBJECT) {
+            gc_mark_value(heap, &obj->u.multi_array.element[i], mark);
+        } else if (obj->type == MAP_OBJECT) {
+            if (obj->u.map.entry[i].distance == 0) {
+                continue;
+            }
+            gc_mark_value(heap, &obj->u.map.entry[i].key, mark);
+            gc_mark_value(heap, &obj->u.map.entry[i].value, mark);
+        } else {
+            gc_mark_value(heap, &obj->u.record.field[i], mark);
+        }
     }
-    obj->u.array.size = new_size;
+    i = end - *index;
+    *index = end < count ? end : -1;
+
+    return i;
 }
 
-static void gc_mark(MRSK_Object *obj)
+/*
+ * Makes an old white object gray.  Young objects are left to minor
+ * collections, and literal strings are always marked.
+ */
+static void gc_mark(Heap *heap, MRSK_Object *obj)
 {
-    if (obj->marked) {
+    if (obj->young || obj->marked) {
         return;
     }
 
     obj->marked = MRSK_TRUE;
+    push_object(&heap->gray, obj);
+}
 
-    if (obj->type == ARRAY_OBJECT) {
-        int i;
-        for (i=0; i<obj->u.array.size; i++) {
-            if (dkc_is_object_value(obj->u.array.array[i].type)) {
-                gc_mark(obj->u.array.array[i].u.object);
+/* A minor collection stops at old objects. */
+static void gc_mark_young(Heap *heap, MRSK_Object *obj)
+{
+    if (!obj->young || obj->marked) {
+        return;
+    }
+
+    obj->marked = MRSK_TRUE;
+    push_object(&heap->young_gray, obj);
+}
+
+/*
+ * Blackens the objects on stack until it is empty, or until about
+ * budget values have been looked at if budget isn't negative.  An
+ * object too big for what is left of the budget is put back, and
+ * heap.scan_index says where to go on with it.  Returns whether it got
+ * to the end.
+ */
+static MRSK_Boolean gc_trace(Heap *heap, ObjectStack *stack,
+                             GCMarker *mark, int budget)
+{
+    MRSK_Object *obj;
+    int index;
+    int work = 0;
+
+    while (stack->count > 0) {
+        if (budget >= 0 && work >= budget) {
+            return MRSK_FALSE;
+        }
+        stack->count--;
+        obj = stack->object[stack->count];
+        index = 0;
+        if (obj == heap->scan) {
+            index = heap->scan_index;
+            heap->scan = NULL;
+            if (index < 0) {
+                /* mrsk_finish_scan() has been through it */
+                continue;
             }
         }
+        work += gc_mark_children(heap, obj, mark, &index,
+                                 budget < 0 ? -1 : budget - work) + 1;
+        if (index >= 0) {
+            push_object(stack, obj);
+            heap->scan = obj;
+            heap->scan_index = index;
+        }
     }
+    return MRSK_TRUE;
 }
 
 static void gc_reset_mark(MRSK_Object *obj)
@@ -194,59 +985,105 @@ static void gc_reset_mark(MRSK_Object *obj)
     obj->marked = MRSK_FALSE;
 }
 
-static void gc_mark_ref_in_native_method(MRSK_LocalEnvironment *env)
+static void gc_mark_frame_stack(MRSK_Interpreter *inter, GCMarker *mark)
 {
-    RefInNativeFunc *ref;
+    Heap *heap = &inter->heap;
+    CallFrameChunk *chunk;
+    Variable *v;
+    int i;
 
-    for (ref=env->ref_in_native_method; ref; ref=ref->next) {
-        gc_mark(ref->object);
+    for (chunk=inter->frame_stack.first; chunk; chunk=chunk->next) {
+        for (i=0; i<chunk->value_count; i++) {
+            gc_mark_value(heap, &chunk->value[i], mark);
+        }
+        for (i=0; i<chunk->environment_count; i++) {
+            for (v=chunk->environment[i].variable; v; v=v->next) {
+                gc_mark_value(heap, &v->value, mark);
+            }
+        }
+        if (chunk == inter->frame_stack.current) {
+            break;
+        }
+    }
+    for (i=0; i<inter->frame_stack.ref_count; i++) {
+        mark(heap, inter->frame_stack.ref[i]);
     }
 }
 
-static void gc_mark_objects(MRSK_Interpreter *inter)
+static void gc_mark_roots(MRSK_Interpreter *inter, GCMarker *mark)
 {
-    MRSK_Object *obj;
-    Variable *v;
-    MRSK_LocalEnvironment *lv;
+    Heap *heap = &inter->heap;
     int i;
 
-    for (obj=inter->heap.header; obj; obj=obj->next) {
-        gc_reset_mark(obj);
-    }
-    
-    for (v=inter->variable; v; v=v->next) {
-        if (dkc_is_object_value(v->value.type)) {
-            gc_mark(v->value.u.object);
-        }
+    for (i=0; i<inter->global.count; i++) {
+        gc_mark_value(heap, &inter->global.variable[i]->value, mark);
     }
     
-    for (lv=inter->top_environment; lv; lv=lv->next) {
-        for (v=lv->variable; v; v=v->next) {
-            if (dkc_is_object_value(v->value.type)) {
-                gc_mark(v->value.u.object);
-            }
-        }
-        gc_mark_ref_in_native_method(lv);
-    }
+    gc_mark_frame_stack(inter, mark);
 
     for (i=0; i<inter->stack.stack_pointer; i++) {
-        if (dkc_is_object_value(inter->stack.stack[i].type)) {
-            gc_mark(inter->stack.stack[i].u.object);
-        }
+        gc_mark_value(heap, &inter->stack.stack[i], mark);
+    }
+}
+
+/*
+ * All at once; a major collection that was going on may have left
+ * some marks.
+ */
+static void gc_mark_objects(MRSK_Interpreter *inter)
+{
+    MRSK_Object *obj;
+
+    for (obj=inter->heap.header; obj; obj=obj->next) {
+        gc_reset_mark(obj);
     }
+    inter->heap.gray.count = 0;
+    inter->heap.scan = NULL;
+    gc_mark_roots(inter, gc_mark);
+    gc_trace(&inter->heap, &inter->heap.gray, gc_mark, -1);
 }
 
 static void gc_dispose_object(MRSK_Interpreter *inter, MRSK_Object *obj)
 {
     switch (obj->type) {
         case ARRAY_OBJECT:
+        case INT_ARRAY_OBJECT:
+        case DOUBLE_ARRAY_OBJECT:
+            if (obj->u.array.owner) {
+                break;
+            }
+            inter->heap.current_heap_size
+                -= array_element_size(obj->type) * obj->u.array.alloc_size;
+            MEM_free(obj->u.array.array.value);
+            break;
+        case MULTI_ARRAY_OBJECT:
+            if (obj->u.multi_array.owner) {
+                break;
+            }
+            inter->heap.current_heap_size
+                -= sizeof(MRSK_Value) * obj->u.multi_array.dim[0]
+                * obj->u.multi_array.stride[0]
+                + sizeof(int) * obj->u.multi_array.rank * 2;
+            MEM_free(obj->u.multi_array.element);
+            MEM_free(obj->u.multi_array.dim);
+            MEM_free(obj->u.multi_array.stride);
+            break;
+        case MAP_OBJECT:
             inter->heap.current_heap_size
-                -= sizeof(MRSK_Value) * obj->u.array.alloc_size;
-            MEM_free(obj->u.array.array);
+                -= sizeof(MapEntry) * obj->u.map.capacity;
+            MEM_free(obj->u.map.entry);
+            break;
+        case RECORD_OBJECT:
+            inter->heap.current_heap_size
+                -= sizeof(MRSK_Value) * obj->u.record.shape->field_count;
+            MEM_free(obj->u.record.field);
             break;
         case STRING_OBJECT:
-            if (!obj->u.string.is_literal) {
-                inter->heap.current_heap_size -= strlen(obj->u.string.string) + 1;
+            if (obj->u.string.buffer) {
+                release_string_buffer(inter, obj->u.string.buffer);
+            } else if (!obj->u.string.is_literal
+                       && obj->u.string.string != obj->u.string.short_string) {
+                inter->heap.current_heap_size -= obj->u.string.length + 1;
                 MEM_free(obj->u.string.string);
             }
             break;
@@ -255,35 +1092,282 @@ static void gc_dispose_object(MRSK_Interpreter *inter, MRSK_Object *obj)
             DBG_assert(0, ("bad type..%d\n", obj->type));
     }
     inter->heap.current_heap_size -= sizeof(MRSK_Object);
-    MEM_free(obj);
+    free_slot(obj);
 }
 
-static void gc_sweep_objects(MRSK_Interpreter *inter)
+/*
+ * Frees the white objects from heap.sweep on, and whitens the black
+ * ones for the next major collection, until the end of the list or
+ * until budget objects if budget isn't negative.  Objects promoted
+ * meanwhile go in front of heap.sweep, so they are passed over.
+ * Returns whether it got to the end.
+ */
+static MRSK_Boolean gc_sweep_objects(MRSK_Interpreter *inter, int budget)
 {
+    Heap *heap = &inter->heap;
+    MRSK_Object *obj;
+    int work;
+
+    for (work = 0; heap->sweep; work++) {
+        if (budget >= 0 && work >= budget) {
+            return MRSK_FALSE;
+        }
+        obj = heap->sweep;
+        heap->sweep = obj->next;
+        if (obj->marked) {
+            obj->marked = MRSK_FALSE;
+            continue;
+        }
+        if (obj->prev) {
+            obj->prev->next = obj->next;
+        } else {
+            heap->header = obj->next;
+        }
+        if (obj->next) {
+            obj->next->prev = obj->prev;
+        }
+        gc_dispose_object(inter, obj);
+    }
+    return MRSK_TRUE;
+}
+
+/*
+ * An old object that has been given a young one; the next minor
+ * collection traces it as a root.
+ */
+void mrsk_remember_object(MRSK_Interpreter *inter, MRSK_Object *obj)
+{
+    if (obj->young || obj->remembered) {
+        return;
+    }
+    push_object(&inter->heap.remembered, obj);
+    obj->remembered = MRSK_TRUE;
+}
+
+static void forget_remembered_objects(Heap *heap)
+{
+    int i;
+
+    for (i = 0; i < heap->remembered.count; i++) {
+        heap->remembered.object[i]->remembered = MRSK_FALSE;
+    }
+    heap->remembered.count = 0;
+}
+
+/*
+ * v[0..count), slots of obj, are about to be overwritten or dropped.
+ * While a major collection marks, the old objects in them are shaded:
+ * the marking has to find everything that was reachable when it
+ * started, and it may not have traced obj yet.
+ */
+void mrsk_shade_values(MRSK_Interpreter *inter, MRSK_Object *obj,
+                       MRSK_Value *v, int count)
+{
+    int i;
+
+    if (inter->heap.phase != GC_MARKING || obj->young) {
+        return;
+    }
+    for (i = 0; i < count; i++) {
+        gc_mark_value(&inter->heap, &v[i], gc_mark);
+    }
+}
+
+/*
+ * obj's children are about to move about within it.  If a slice left
+ * it scanned part way, the rest is marked now, as where the scan
+ * stopped would mean nothing afterwards.
+ */
+void mrsk_finish_scan(MRSK_Interpreter *inter, MRSK_Object *obj)
+{
+    if (inter->heap.scan != obj || inter->heap.scan_index < 0) {
+        return;
+    }
+    gc_mark_children(&inter->heap, obj, gc_mark,
+                     &inter->heap.scan_index, -1);
+}
+
+/*
+ * The caller takes obj off the young list.  An object promoted while a
+ * major collection marks is black: whatever it refers to is young, or
+ * was reachable when the marking started.
+ */
+static void promote_object(Heap *heap, MRSK_Object *obj)
+{
+    obj->young = MRSK_FALSE;
+    obj->marked = heap->phase == GC_MARKING;
+    obj->prev = NULL;
+    obj->next = heap->header;
+    if (heap->header) {
+        heap->header->prev = obj;
+    }
+    heap->header = obj;
+}
+
+/* The upper bounds of GCStat.pause_count[], but for the last. */
+static double pause_bucket_msec[GC_PAUSE_BUCKET_COUNT - 1] = {
+    0.1, 0.2, 0.5, 1, 2, 5, 10, 20, 50, 100
+};
+
+static double clock_to_msec(clock_t t)
+{
+    return t * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static void record_pause(GCStat *stat, clock_t pause)
+{
+    int i;
+
+    for (i = 0; i < GC_PAUSE_BUCKET_COUNT - 1; i++) {
+        if (clock_to_msec(pause) < pause_bucket_msec[i]) {
+            break;
+        }
+    }
+    stat->pause_count[i]++;
+    if (pause > stat->max_pause) {
+        stat->max_pause = pause;
+    }
+}
+
+/*
+ * The young objects reachable from the roots or from a remembered
+ * object are promoted and the rest are freed; old objects aren't looked
+ * at otherwise.
+ */
+static void minor_collect(MRSK_Interpreter *inter)
+{
+    Heap *heap = &inter->heap;
     MRSK_Object *obj;
     MRSK_Object *tmp;
+    int index;
+    int i;
 
-    for (obj=inter->heap.header; obj; ) {
-        if (!obj->marked) {
-            if (obj->prev) {
-                obj->prev->next = obj->next;
-            } else {
-                inter->heap.header = obj->next;
-            }
-            if (obj->next) {
-                obj->next->prev = obj->prev;
-            }
-            tmp = obj->next;
-            gc_dispose_object(inter, obj);
-            obj = tmp;
+    gc_mark_roots(inter, gc_mark_young);
+    for (i = 0; i < heap->remembered.count; i++) {
+        index = 0;
+        gc_mark_children(heap, heap->remembered.object[i], gc_mark_young,
+                         &index, -1);
+    }
+    gc_trace(heap, &heap->young_gray, gc_mark_young, -1);
+    forget_remembered_objects(heap);
+
+    for (obj = heap->young; obj; obj = tmp) {
+        tmp = obj->next;
+        if (obj->marked) {
+            promote_object(heap, obj);
         } else {
-            obj = obj->next;
+            gc_dispose_object(inter, obj);
         }
     }
+    heap->young = NULL;
+    reset_cursor(heap);
+    heap->stat.minor_count++;
+}
+
+/*
+ * Right after a minor collection, so every object is old.  Shading the
+ * roots is the only part done at once.
+ */
+static void start_major_collection(MRSK_Interpreter *inter)
+{
+    DBG_assert(inter->heap.young == NULL, ("young objects left\n"));
+    inter->heap.phase = GC_MARKING;
+    gc_mark_roots(inter, gc_mark);
+}
+
+static void finish_major_collection(Heap *heap)
+{
+    release_empty_chunks(heap);
+    heap->major_threshold = heap->current_heap_size * 2;
+    if (heap->major_threshold < HEAP_THRESHOLD_SIZE) {
+        heap->major_threshold = HEAP_THRESHOLD_SIZE;
+    }
+    heap->phase = GC_IDLE;
+    heap->stat.major_count++;
 }
 
+/*
+ * Also right after a minor collection, so the switch to sweeping
+ * happens with the remembered set empty; nothing remembered later can
+ * be swept, as only reachable objects are stored into.
+ */
+static void major_slice(MRSK_Interpreter *inter)
+{
+    Heap *heap = &inter->heap;
+
+    if (heap->phase == GC_MARKING) {
+        if (gc_trace(heap, &heap->gray, gc_mark, heap->slice_work)) {
+            heap->phase = GC_SWEEPING;
+            heap->sweep = heap->header;
+        }
+    } else if (gc_sweep_objects(inter, heap->slice_work)) {
+        finish_major_collection(heap);
+    }
+    heap->stat.slice_count++;
+}
+
+/*
+ * A major collection all at once: the young objects join the old ones
+ * and the whole heap is marked and swept.  One going on in slices is
+ * started over.
+ */
 void mrsk_garbage_collect(MRSK_Interpreter *inter)
 {
+    Heap *heap = &inter->heap;
+    clock_t start = clock();
+    MRSK_Object *obj;
+    MRSK_Object *tmp;
+
+    heap->phase = GC_IDLE;
+    for (obj = heap->young; obj; obj = tmp) {
+        tmp = obj->next;
+        promote_object(heap, obj);
+    }
+    heap->young = NULL;
+    forget_remembered_objects(heap);
+
     gc_mark_objects(inter);
-    gc_sweep_objects(inter);
+    heap->sweep = heap->header;
+    gc_sweep_objects(inter, -1);
+    finish_major_collection(heap);
+    heap->stat.major_time += clock() - start;
+    record_pause(&heap->stat, clock() - start);
+}
+
+void mrsk_print_gc_stat(MRSK_Interpreter *inter, FILE *fp)
+{
+    GCStat *stat = &inter->heap.stat;
+    int i;
+
+    fprintf(fp, "minor gc: %d times, %.1f msec\n",
+            stat->minor_count, clock_to_msec(stat->minor_time));
+    fprintf(fp, "major gc: %d times in %d slices, %.1f msec\n",
+            stat->major_count, stat->slice_count,
+            clock_to_msec(stat->major_time));
+    fprintf(fp, "max pause: %.1f msec\n", clock_to_msec(stat->max_pause));
+    for (i = 0; i < GC_PAUSE_BUCKET_COUNT; i++) {
+        if (i < GC_PAUSE_BUCKET_COUNT - 1) {
+            fprintf(fp, "  < %5.1f msec: %d\n",
+                    pause_bucket_msec[i], stat->pause_count[i]);
+        } else {
+            fprintf(fp, "  >=%5.1f msec: %d\n",
+                    pause_bucket_msec[i - 1], stat->pause_count[i]);
+        }
+    }
+}
+
+/* After the last collection, when nothing is left in the heap. */
+void mrsk_dispose_heap(MRSK_Interpreter *inter)
+{
+    Heap *heap = &inter->heap;
+    HeapChunk *tmp;
+
+    while (heap->chunk) {
+        tmp = heap->chunk->next;
+        MEM_free(heap->chunk);
+        heap->chunk = tmp;
+    }
+    MEM_free(heap->remembered.object);
+    MEM_free(heap->young_gray.object);
+    MEM_free(heap->gray.object);
 }
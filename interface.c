@@ -11,18 +11,86 @@ static void add_native_functions(MRSK_Interpreter *inter)
     MRSK_add_native_function(inter, "fgets", mrsk_nv_fgets_proc);
     MRSK_add_native_function(inter, "fputs", mrsk_nv_fputs_proc);
     MRSK_add_native_function(inter, "new_array", mrsk_nv_new_array_proc);
+    MRSK_add_native_function(inter, "int_array", mrsk_nv_int_array_proc);
+    MRSK_add_native_function(inter, "double_array",
+                             mrsk_nv_double_array_proc);
+    MRSK_add_native_function(inter, "sum", mrsk_nv_sum_proc);
+    MRSK_add_native_function(inter, "min", mrsk_nv_min_proc);
+    MRSK_add_native_function(inter, "max", mrsk_nv_max_proc);
+    MRSK_add_native_function(inter, "fill", mrsk_nv_fill_proc);
+    MRSK_add_native_function(inter, "copy_range", mrsk_nv_copy_range_proc);
+    MRSK_add_native_function(inter, "index_of", mrsk_nv_index_of_proc);
+    MRSK_add_native_function(inter, "count", mrsk_nv_count_proc);
+    MRSK_add_native_function(inter, "dot", mrsk_nv_dot_proc);
+    MRSK_add_native_function(inter, "sort", mrsk_nv_sort_proc);
+    MRSK_add_native_function(inter, "new_map", mrsk_nv_new_map_proc);
+}
+
+static void add_method(MethodTable *table, int selector,
+                       int arg_count, MRSK_MethodProc *proc);
+
+/* A multi dimensional array only takes the methods that keep its shape. */
+static void add_multi_array_method(MRSK_Interpreter *inter, char *name,
+                                   int arg_count, MRSK_MethodProc *proc)
+{
+    add_method(&inter->method_table[MULTI_ARRAY_OBJECT],
+               mrsk_intern_selector(inter, mrsk_intern_string(inter, name)),
+               arg_count, proc);
+}
+
+static void add_native_methods(MRSK_Interpreter *inter)
+{
+    MRSK_add_method(inter, MRSK_ARRAY_VALUE, "add", 1,
+                    mrsk_nm_array_add_proc);
+    MRSK_add_method(inter, MRSK_ARRAY_VALUE, "size", 0,
+                    mrsk_nm_array_size_proc);
+    MRSK_add_method(inter, MRSK_ARRAY_VALUE, "resize", 1,
+                    mrsk_nm_array_resize_proc);
+    MRSK_add_method(inter, MRSK_ARRAY_VALUE, "reserve", 1,
+                    mrsk_nm_array_reserve_proc);
+    MRSK_add_method(inter, MRSK_ARRAY_VALUE, "shrink_to_fit", 0,
+                    mrsk_nm_array_shrink_to_fit_proc);
+    MRSK_add_method(inter, MRSK_ARRAY_VALUE, "slice", 2,
+                    mrsk_nm_array_slice_proc);
+    MRSK_add_method(inter, MRSK_STRING_VALUE, "length", 0,
+                    mrsk_nm_string_length_proc);
+    MRSK_add_method(inter, MRSK_STRING_VALUE, "slice", 2,
+                    mrsk_nm_string_slice_proc);
+    add_multi_array_method(inter, "size", 0, mrsk_nm_array_size_proc);
+    MRSK_add_method(inter, MRSK_MAP_VALUE, "get", 1, mrsk_nm_map_get_proc);
+    MRSK_add_method(inter, MRSK_MAP_VALUE, "set", 2, mrsk_nm_map_set_proc);
+    MRSK_add_method(inter, MRSK_MAP_VALUE, "has", 1, mrsk_nm_map_has_proc);
+    MRSK_add_method(inter, MRSK_MAP_VALUE, "remove", 1,
+                    mrsk_nm_map_remove_proc);
+    MRSK_add_method(inter, MRSK_MAP_VALUE, "keys", 0, mrsk_nm_map_keys_proc);
+    MRSK_add_method(inter, MRSK_MAP_VALUE, "size", 0, mrsk_nm_map_size_proc);
+}
+
+static void init_object_stack(ObjectStack *stack)
+{
+    stack->count = 0;
+    stack->alloc_size = 0;
+    stack->object = NULL;
 }
 
 MRSK_Interpreter * MRSK_create_interpreter(void)
 {
     MEM_Storage storage;
     MRSK_Interpreter *interpreter;
+    int i;
 
     storage = MEM_open_storage(0);
     interpreter = MEM_storage_malloc(storage, sizeof(struct MRSK_Interpreter_tag));
     interpreter->interpreter_storage = storage;
     interpreter->execute_storage = NULL;
-    interpreter->variable = NULL;
+    interpreter->global.count = 0;
+    interpreter->global.alloc_size = 0;
+    interpreter->global.variable = NULL;
+    interpreter->global.hash_size = 0;
+    interpreter->global.hash = NULL;
+    interpreter->string_pool.count = 0;
+    interpreter->string_pool.hash_size = 0;
+    interpreter->string_pool.bucket = NULL;
     interpreter->function_list = NULL;
     interpreter->statement_list = NULL;
     interpreter->current_line_number = 1;
@@ -30,16 +98,83 @@ MRSK_Interpreter * MRSK_create_interpreter(void)
     interpreter->stack.stack_pointer = 0;
     interpreter->stack.stack = MEM_malloc(sizeof(MRSK_Value) * STACK_ALLOC_SIZE);
     interpreter->heap.current_heap_size = 0;
-    interpreter->heap.current_threshold = HEAP_THRESHOLD_SIZE;
+    interpreter->heap.current_threshold = NURSERY_SIZE;
+    interpreter->heap.major_threshold = HEAP_THRESHOLD_SIZE;
     interpreter->heap.header = NULL;
+    interpreter->heap.young = NULL;
+    interpreter->heap.chunk = NULL;
+    interpreter->heap.current_chunk = NULL;
+    interpreter->heap.cursor = 0;
+    init_object_stack(&interpreter->heap.remembered);
+    init_object_stack(&interpreter->heap.young_gray);
+    init_object_stack(&interpreter->heap.gray);
+    interpreter->heap.scan = NULL;
+    interpreter->heap.scan_index = 0;
+    interpreter->heap.phase = GC_IDLE;
+    interpreter->heap.sweep = NULL;
+    interpreter->heap.slice_work = GC_SLICE_WORK;
+    interpreter->heap.stat.minor_count = 0;
+    interpreter->heap.stat.major_count = 0;
+    interpreter->heap.stat.slice_count = 0;
+    interpreter->heap.stat.minor_time = 0;
+    interpreter->heap.stat.major_time = 0;
+    interpreter->heap.stat.max_pause = 0;
+    for (i = 0; i < GC_PAUSE_BUCKET_COUNT; i++) {
+        interpreter->heap.stat.pause_count[i] = 0;
+    }
     interpreter->top_environment = NULL;
+    interpreter->frame_stack.first = NULL;
+    interpreter->frame_stack.current = NULL;
+    interpreter->frame_stack.ref_count = 0;
+    interpreter->frame_stack.ref_alloc_size = 0;
+    interpreter->frame_stack.ref = NULL;
+    interpreter->executable = NULL;
+    interpreter->current_executable = NULL;
+    interpreter->execute_mode = MRSK_BYTECODE_MODE;
+    interpreter->selector_count = 0;
+    interpreter->selector = NULL;
+    interpreter->dump_tree_fp = NULL;
+    interpreter->gc_stat_fp = NULL;
+    for (i = 0; i < OBJECT_TYPE_COUNT_PLUS_1; i++) {
+        interpreter->method_table[i].size = 0;
+        interpreter->method_table[i].method = NULL;
+    }
 
     mrsk_set_current_interpreter(interpreter);
     add_native_functions(interpreter);
+    add_native_methods(interpreter);
 
     return interpreter;
 }
 
+/* Before MRSK_compile(), which generates bytecode only for that mode. */
+void MRSK_set_execute_mode(MRSK_Interpreter *interpreter,
+                           MRSK_ExecuteMode mode)
+{
+    interpreter->execute_mode = mode;
+}
+
+void MRSK_set_dump_tree(MRSK_Interpreter *interpreter, FILE *fp)
+{
+    interpreter->dump_tree_fp = fp;
+}
+
+/*
+ * How many objects a slice of a major collection sweeps, or how many
+ * values it marks; smaller slices make for shorter pauses, but the
+ * collection takes more of them.
+ */
+void MRSK_set_gc_slice_work(MRSK_Interpreter *interpreter, int work)
+{
+    interpreter->heap.slice_work = work;
+}
+
+/* The collector's counts and times are printed to fp after the run. */
+void MRSK_set_gc_stat(MRSK_Interpreter *interpreter, FILE *fp)
+{
+    interpreter->gc_stat_fp = fp;
+}
+
 void MRSK_compile(MRSK_Interpreter *interpreter, FILE *fp)
 {
     extern int yyparse(void);
@@ -54,36 +189,79 @@ void MRSK_compile(MRSK_Interpreter *interpreter, FILE *fp)
         exit(1);
     }
     mrsk_reset_string_literal_buffer();
+    mrsk_optimize_tree(interpreter);
+    if (interpreter->dump_tree_fp) {
+        mrsk_dump_tree(interpreter, interpreter->dump_tree_fp);
+    }
+    mrsk_fix_tree(interpreter);
+    if (interpreter->execute_mode == MRSK_BYTECODE_MODE) {
+        mrsk_generate(interpreter);
+    }
 }
 
 void MRSK_interpret(MRSK_Interpreter *interpreter)
 {
     interpreter->execute_storage = MEM_open_storage(0);
     mrsk_add_std_fp(interpreter);
-    mrsk_execute_statement_list(interpreter, NULL, interpreter->statement_list);
+    if (interpreter->execute_mode == MRSK_BYTECODE_MODE) {
+        mrsk_vm_execute(interpreter, NULL, interpreter->executable);
+    } else {
+        mrsk_execute_statement_list(interpreter, NULL,
+                                    interpreter->statement_list);
+    }
+    if (interpreter->gc_stat_fp) {
+        mrsk_print_gc_stat(interpreter, interpreter->gc_stat_fp);
+    }
     mrsk_garbage_collect(interpreter);
 }
 
 static void release_global_strings(MRSK_Interpreter *interpreter)
 {
-    while (interpreter->variable) {
-        Variable *temp = interpreter->variable;
-        interpreter->variable = temp->next;
+    int i;
+
+    for (i = 0; i < interpreter->global.count; i++) {
+        interpreter->global.variable[i]->value.type = UNDEFINED_VALUE_TYPE;
+    }
+}
+
+static void dispose_executables(MRSK_Interpreter *interpreter)
+{
+    FunctionDefinition *pos;
+
+    for (pos=interpreter->function_list; pos; pos=pos->next) {
+        if (pos->type == MURASAKI_FUNCTION_DEFINITION
+            && pos->u.murasaki_f.executable) {
+            mrsk_dispose_executable(pos->u.murasaki_f.executable);
+        }
+    }
+    if (interpreter->executable) {
+        mrsk_dispose_executable(interpreter->executable);
     }
 }
 
 void MRSK_dispose_interpreter(MRSK_Interpreter *interpreter)
 {
+    int i;
+
     release_global_strings(interpreter);
+    dispose_executables(interpreter);
 
     if (interpreter->execute_storage) {
         MEM_dispose_storage(interpreter->execute_storage);
     }
-    interpreter->variable = NULL;
     mrsk_garbage_collect(interpreter);
     DBG_assert(interpreter->heap.current_heap_size==0,
                ("%d bytes leaked.\n", interpreter->heap.current_heap_size));
+    mrsk_dispose_heap(interpreter);
     MEM_free(interpreter->stack.stack);
+    mrsk_dispose_frame_stack(interpreter);
+    for (i = 0; i < OBJECT_TYPE_COUNT_PLUS_1; i++) {
+        MEM_free(interpreter->method_table[i].method);
+    }
+    MEM_free(interpreter->selector);
+    MEM_free(interpreter->global.variable);
+    MEM_free(interpreter->global.hash);
+    mrsk_dispose_string_pool(interpreter);
     MEM_dispose_storage(interpreter->interpreter_storage);
 }
 
@@ -93,10 +271,50 @@ void MRSK_add_native_function(MRSK_Interpreter *interpreter, char *name,
     FunctionDefinition *fd;
 
     fd = mrsk_malloc(sizeof(FunctionDefinition));
-    fd->name = name;
+    fd->name = mrsk_intern_string(interpreter, name);
     fd->type = NATIVE_FUNCTION_DEFINITION;
     fd->u.native_f.proc = proc;
     fd->next = interpreter->function_list;
 
     interpreter->function_list = fd;
 }
+
+static void add_method(MethodTable *table, int selector,
+                       int arg_count, MRSK_MethodProc *proc)
+{
+    int i;
+
+    if (table->size <= selector) {
+        table->method = MEM_realloc(table->method,
+                                    sizeof(Method) * (selector + 1));
+        for (i = table->size; i <= selector; i++) {
+            table->method[i].proc = NULL;
+        }
+        table->size = selector + 1;
+    }
+    table->method[selector].argument_count = arg_count;
+    table->method[selector].proc = proc;
+}
+
+/* An array method applies to typed arrays as well. */
+void MRSK_add_method(MRSK_Interpreter *interpreter,
+                     MRSK_ValueType receiver_type, char *name,
+                     int arg_count, MRSK_MethodProc *proc)
+{
+    MethodTable *table = interpreter->method_table;
+    int selector;
+
+    selector = mrsk_intern_selector(interpreter,
+                                    mrsk_intern_string(interpreter, name));
+    if (receiver_type == MRSK_ARRAY_VALUE) {
+        add_method(&table[ARRAY_OBJECT], selector, arg_count, proc);
+        add_method(&table[INT_ARRAY_OBJECT], selector, arg_count, proc);
+        add_method(&table[DOUBLE_ARRAY_OBJECT], selector, arg_count, proc);
+    } else if (receiver_type == MRSK_MAP_VALUE) {
+        add_method(&table[MAP_OBJECT], selector, arg_count, proc);
+    } else {
+        DBG_assert(receiver_type == MRSK_STRING_VALUE,
+                   ("receiver_type..%d\n", receiver_type));
+        add_method(&table[STRING_OBJECT], selector, arg_count, proc);
+    }
+}
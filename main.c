@@ -1,24 +1,61 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "MRSK.h"
 #include "MEM.h"
 
 int main(int argc, char **argv)
 {
     MRSK_Interpreter *interpreter;
+    MRSK_ExecuteMode mode = MRSK_BYTECODE_MODE;
+    int dump_tree = 0;
+    int gc_stat = 0;
+    int gc_slice_work = 0;
+    char *filename = NULL;
     FILE *fp;
+    int i;
 
-    if (argc != 2) {
-        fprintf(stderr, "usage:%s filename", argv[0]);
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-ast")) {
+            mode = MRSK_AST_MODE;
+        } else if (!strcmp(argv[i], "-dump")) {
+            dump_tree = 1;
+        } else if (!strcmp(argv[i], "-gcstat")) {
+            gc_stat = 1;
+        } else if (!strcmp(argv[i], "-gcslice") && i + 1 < argc) {
+            i++;
+            gc_slice_work = atoi(argv[i]);
+        } else if (filename == NULL) {
+            filename = argv[i];
+        } else {
+            filename = NULL;
+            break;
+        }
+    }
+    if (filename == NULL) {
+        fprintf(stderr,
+                "usage:%s [-ast] [-dump] [-gcstat] [-gcslice work] filename",
+                argv[0]);
         exit(1);
     }
 
-    fp = fopen(argv[1], "r");
+    fp = fopen(filename, "r");
     if (fp == NULL) {
-        fprintf(stderr, "%s not found \n", argv[1]);
+        fprintf(stderr, "%s not found \n", filename);
         exit(1);
     }
 
     interpreter = MRSK_create_interpreter();
+    MRSK_set_execute_mode(interpreter, mode);
+    if (dump_tree) {
+        MRSK_set_dump_tree(interpreter, stdout);
+    }
+    if (gc_stat) {
+        MRSK_set_gc_stat(interpreter, stderr);
+    }
+    if (gc_slice_work > 0) {
+        MRSK_set_gc_slice_work(interpreter, gc_slice_work);
+    }
     MRSK_compile(interpreter, fp);
     MRSK_interpret(interpreter);
     MRSK_dispose_interpreter(interpreter);
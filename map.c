@@ -0,0 +1,338 @@
+#include <limits.h>
+#include <string.h>
+#include "MEM.h"
+#include "DBG.h"
+#include "MRSK_dev.h"
+#include "murasaki.h"
+
+#define MAP_MIN_CAPACITY    (8)
+
+/* The table grows when it would be more than 7/8 full. */
+#define map_is_full(map) \
+    (((map)->count + 1) * 8 > (map)->capacity * 7)
+
+/*
+ * Slots are hash & (capacity - 1), so the low bits have to depend on
+ * the whole key; this is MurmurHash3's finalizer.
+ */
+static unsigned int mix_hash(unsigned int h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+
+    return h;
+}
+
+static MRSK_Boolean is_int_double(double d)
+{
+    return d >= INT_MIN && d <= INT_MAX && d == (int)d;
+}
+
+/*
+ * Keys are compared as == compares them, so 1 and 1.0 are the same key
+ * and hash alike.
+ */
+static unsigned int hash_key(MRSK_Value *key, int line_number)
+{
+    unsigned char *p;
+    unsigned int h;
+    int i;
+
+    if (key->type == MRSK_INT_VALUE) {
+        return mix_hash((unsigned int)key->u.int_value);
+    } else if (key->type == MRSK_DOUBLE_VALUE) {
+        if (is_int_double(key->u.double_value)) {
+            return mix_hash((unsigned int)(int)key->u.double_value);
+        }
+        p = (unsigned char*)&key->u.double_value;
+        for (h = 0, i = 0; i < sizeof(double); i++) {
+            h = h * 31 + p[i];
+        }
+        return mix_hash(h);
+    } else if (key->type == MRSK_STRING_VALUE) {
+        return mix_hash(mrsk_get_string_hash(key->u.object));
+    } else if (key->type == MRSK_BOOLEAN_VALUE) {
+        return mix_hash(key->u.boolean_value);
+    }
+    mrsk_runtime_error(line_number, MAP_KEY_TYPE_ERR, MESSAGE_ARGUMENT_END);
+    return 0;
+}
+
+static MRSK_Boolean keys_equal(MRSK_Value *left, MRSK_Value *right)
+{
+    if (left->type == MRSK_INT_VALUE && right->type == MRSK_INT_VALUE) {
+        return left->u.int_value == right->u.int_value;
+    } else if (left->type == MRSK_STRING_VALUE
+               && right->type == MRSK_STRING_VALUE) {
+        return mrsk_string_equals(left->u.object, right->u.object);
+    } else if (left->type == MRSK_BOOLEAN_VALUE
+               && right->type == MRSK_BOOLEAN_VALUE) {
+        return left->u.boolean_value == right->u.boolean_value;
+    } else if (left->type == MRSK_DOUBLE_VALUE
+               && right->type == MRSK_DOUBLE_VALUE) {
+        return left->u.double_value == right->u.double_value;
+    } else if (left->type == MRSK_INT_VALUE
+               && right->type == MRSK_DOUBLE_VALUE) {
+        return left->u.int_value == right->u.double_value;
+    } else if (left->type == MRSK_DOUBLE_VALUE
+               && right->type == MRSK_INT_VALUE) {
+        return left->u.double_value == right->u.int_value;
+    }
+    return MRSK_FALSE;
+}
+
+/* The slot of key, or -1. */
+static int search_slot(MRSK_Map *map, MRSK_Value *key, unsigned int hash)
+{
+    int mask = map->capacity - 1;
+    int i;
+    int distance;
+
+    if (map->capacity == 0) {
+        return -1;
+    }
+    for (i = hash & mask, distance = 1; ; i = (i + 1) & mask, distance++) {
+        if (map->entry[i].distance < distance) {
+            return -1;
+        }
+        if (map->entry[i].hash == hash
+            && keys_equal(&map->entry[i].key, key)) {
+            return i;
+        }
+    }
+}
+
+/*
+ * Puts a key which is not in the table yet, taking the slot of any key
+ * closer to its home slot and moving that one on instead.  Returns
+ * where the new key went.
+ */
+static MapEntry * insert_entry(MRSK_Map *map, MapEntry *new_entry)
+{
+    int mask = map->capacity - 1;
+    MapEntry cur = *new_entry;
+    MapEntry tmp;
+    MapEntry *ret = NULL;
+    int i;
+
+    cur.distance = 1;
+    for (i = cur.hash & mask; ; i = (i + 1) & mask, cur.distance++) {
+        if (map->entry[i].distance == 0) {
+            map->entry[i] = cur;
+            return ret ? ret : &map->entry[i];
+        }
+        if (map->entry[i].distance < cur.distance) {
+            tmp = map->entry[i];
+            map->entry[i] = cur;
+            cur = tmp;
+            if (ret == NULL) {
+                ret = &map->entry[i];
+            }
+        }
+    }
+}
+
+/*
+ * Doesn't collect, like mrsk_array_unshare(): the key and value being
+ * set may be only in C locals.
+ */
+static void grow_map(MRSK_Interpreter *inter, MRSK_Map *map)
+{
+    MapEntry *old_entry = map->entry;
+    int old_capacity = map->capacity;
+    int i;
+
+    map->capacity = old_capacity ? old_capacity * 2 : MAP_MIN_CAPACITY;
+    map->entry = MEM_malloc(sizeof(MapEntry) * map->capacity);
+    for (i = 0; i < map->capacity; i++) {
+        map->entry[i].distance = 0;
+    }
+    for (i = 0; i < old_capacity; i++) {
+        if (old_entry[i].distance > 0) {
+            insert_entry(map, &old_entry[i]);
+        }
+    }
+    MEM_free(old_entry);
+    inter->heap.current_heap_size
+        += (map->capacity - old_capacity) * (int)sizeof(MapEntry);
+}
+
+MRSK_Value * mrsk_map_search(MRSK_Object *map, MRSK_Value *key,
+                             int line_number)
+{
+    int i;
+
+    i = search_slot(&map->u.map, key, hash_key(key, line_number));
+    return i >= 0 ? &map->u.map.entry[i].value : NULL;
+}
+
+void mrsk_map_set(MRSK_Interpreter *inter, MRSK_Object *map,
+                  MRSK_Value *key, MRSK_Value *value, int line_number)
+{
+    MRSK_Map *m = &map->u.map;
+    MapEntry entry;
+    int i;
+
+    entry.hash = hash_key(key, line_number);
+    i = search_slot(m, key, entry.hash);
+    if (i >= 0) {
+        mrsk_write_barrier(inter, map, &m->entry[i].value, value);
+        m->entry[i].value = *value;
+        return;
+    }
+    mrsk_finish_scan(inter, map);
+    if (map_is_full(m)) {
+        grow_map(inter, m);
+    }
+    entry.key = *key;
+    entry.value = *value;
+    insert_entry(m, &entry);
+    m->count++;
+    mrsk_young_barrier(inter, map, key);
+    mrsk_young_barrier(inter, map, value);
+}
+
+/* Returns whether key was there. */
+MRSK_Boolean mrsk_map_remove(MRSK_Interpreter *inter, MRSK_Object *map,
+                             MRSK_Value *key, int line_number)
+{
+    MRSK_Map *m = &map->u.map;
+    int mask = m->capacity - 1;
+    int i;
+    int next;
+
+    i = search_slot(m, key, hash_key(key, line_number));
+    if (i < 0) {
+        return MRSK_FALSE;
+    }
+    mrsk_shade_values(inter, map, &m->entry[i].key, 1);
+    mrsk_shade_values(inter, map, &m->entry[i].value, 1);
+    mrsk_finish_scan(inter, map);
+    for (next = (i + 1) & mask; m->entry[next].distance > 1;
+         i = next, next = (next + 1) & mask) {
+        m->entry[i] = m->entry[next];
+        m->entry[i].distance--;
+    }
+    m->entry[i].distance = 0;
+    m->count--;
+
+    return MRSK_TRUE;
+}
+
+MRSK_Value mrsk_nv_new_map_proc(MRSK_Interpreter *interpreter,
+                                MRSK_LocalEnvironment *env,
+                                int arg_count, MRSK_Value *args)
+{
+    MRSK_Value value;
+
+    mrsk_check_argument_count(arg_count, 0);
+    value.type = MRSK_MAP_VALUE;
+    value.u.object = mrsk_create_map_i(interpreter);
+
+    return value;
+}
+
+/* get(key) is None when key is not there, as map[key] is. */
+MRSK_Value mrsk_nm_map_get_proc(MRSK_Interpreter *interpreter,
+                                MRSK_LocalEnvironment *env,
+                                MRSK_Value *receiver,
+                                int arg_count, MRSK_Value *args,
+                                int line_number)
+{
+    MRSK_Value *v;
+    MRSK_Value value;
+
+    v = mrsk_map_search(receiver->u.object, &args[0], line_number);
+    if (v) {
+        return *v;
+    }
+    value.type = MRSK_NONE_VALUE;
+
+    return value;
+}
+
+MRSK_Value mrsk_nm_map_set_proc(MRSK_Interpreter *interpreter,
+                                MRSK_LocalEnvironment *env,
+                                MRSK_Value *receiver,
+                                int arg_count, MRSK_Value *args,
+                                int line_number)
+{
+    MRSK_Value value;
+
+    mrsk_map_set(interpreter, receiver->u.object, &args[0], &args[1],
+                 line_number);
+    value.type = MRSK_NONE_VALUE;
+
+    return value;
+}
+
+MRSK_Value mrsk_nm_map_has_proc(MRSK_Interpreter *interpreter,
+                                MRSK_LocalEnvironment *env,
+                                MRSK_Value *receiver,
+                                int arg_count, MRSK_Value *args,
+                                int line_number)
+{
+    MRSK_Value value;
+
+    value.type = MRSK_BOOLEAN_VALUE;
+    value.u.boolean_value
+        = mrsk_map_search(receiver->u.object, &args[0], line_number) != NULL;
+
+    return value;
+}
+
+MRSK_Value mrsk_nm_map_remove_proc(MRSK_Interpreter *interpreter,
+                                   MRSK_LocalEnvironment *env,
+                                   MRSK_Value *receiver,
+                                   int arg_count, MRSK_Value *args,
+                                   int line_number)
+{
+    MRSK_Value value;
+
+    value.type = MRSK_BOOLEAN_VALUE;
+    value.u.boolean_value = mrsk_map_remove(interpreter, receiver->u.object,
+                                            &args[0], line_number);
+
+    return value;
+}
+
+/* The keys in table order, which is no particular order. */
+MRSK_Value mrsk_nm_map_keys_proc(MRSK_Interpreter *interpreter,
+                                 MRSK_LocalEnvironment *env,
+                                 MRSK_Value *receiver,
+                                 int arg_count, MRSK_Value *args,
+                                 int line_number)
+{
+    MRSK_Map *m = &receiver->u.object->u.map;
+    MRSK_Value value;
+    int i;
+    int j;
+
+    value.type = MRSK_ARRAY_VALUE;
+    value.u.object = mrsk_create_array_i(interpreter, m->count);
+    for (i = 0, j = 0; i < m->capacity; i++) {
+        if (m->entry[i].distance > 0) {
+            value.u.object->u.array.array.value[j] = m->entry[i].key;
+            j++;
+        }
+    }
+
+    return value;
+}
+
+MRSK_Value mrsk_nm_map_size_proc(MRSK_Interpreter *interpreter,
+                                 MRSK_LocalEnvironment *env,
+                                 MRSK_Value *receiver,
+                                 int arg_count, MRSK_Value *args,
+                                 int line_number)
+{
+    MRSK_Value value;
+
+    value.type = MRSK_INT_VALUE;
+    value.u.int_value = receiver->u.object->u.map.count;
+
+    return value;
+}
@@ -1,6 +1,7 @@
 #ifndef PRIVATE_MURASAKI_H_INCLUDED
 #define PRIVATE_MURASAKI_H_INCLUDED
 #include <stdio.h>
+#include <time.h>
 #include "MEM.h"
 #include "MRSK.h"
 #include "MRSK_dev.h"
@@ -13,13 +14,25 @@
 #define MESSAGE_ARGUMENT_MAX            (256)
 #define LINE_BUF_SIZE                   (1024)
 #define STACK_ALLOC_SIZE                (256)
-#define ARRAY_ALLOC_SIZE                (256)
+#define ARRAY_MIN_ALLOC_SIZE            (8)
 #define HEAP_THRESHOLD_SIZE             (1024 * 256)
+#define NURSERY_SIZE                    (1024 * 256)
+#define HEAP_CHUNK_SIZE                 (1024)
+#define OBJECT_STACK_ALLOC_SIZE         (1024)
+#define GC_SLICE_WORK                   (20000)
+#define GC_PAUSE_BUCKET_COUNT           (11)
+#define FRAME_CHUNK_ENVIRONMENT_SIZE    (256)
+#define FRAME_CHUNK_VALUE_SIZE          (4096)
+#define NATIVE_REF_ALLOC_SIZE           (256)
+#define SHORT_STRING_SIZE               (16)
+#define NUMBER_FORMAT_BUF_SIZE          (64)
+#define VSTRING_ALLOC_SIZE              (64)
 
 typedef enum {
     PARSE_ERR = 1,
     CHARACTER_INVALID_ERR,
     FUNCTION_MULTIPLE_DEFINE_ERR,
+    FIELD_MULTIPLE_DEFINE_ERR,
     COMPILE_ERROR_COUNT_PLUS_1
 } CompileError;
 
@@ -49,6 +62,22 @@ typedef enum {
     NEW_ARRAY_ARGUMENT_TYPE_ERR,
     INC_DEC_OPERAND_TYPE_ERR,
     ARRAY_RESIZE_ARGUMENT_ERR,
+    ARRAY_RESERVE_ARGUMENT_ERR,
+    TYPED_ARRAY_ELEMENT_TYPE_ERR,
+    TYPED_ARRAY_ARGUMENT_ERR,
+    ARRAY_LIB_ARGUMENT_TYPE_ERR,
+    ARRAY_LIB_EMPTY_ARRAY_ERR,
+    ARRAY_LIB_RANGE_ERR,
+    ARRAY_LIB_SIZE_MISMATCH_ERR,
+    SORT_ELEMENT_TYPE_ERR,
+    SORT_COMPARE_RESULT_ERR,
+    SORT_ARRAY_MODIFIED_ERR,
+    MULTI_ARRAY_ROW_ASSIGN_ERR,
+    ARRAY_VIEW_RESIZE_ERR,
+    SLICE_ARGUMENT_ERR,
+    MAP_KEY_TYPE_ERR,
+    MEMBER_OPERAND_NOT_RECORD_ERR,
+    NO_SUCH_FIELD_ERR,
     RUNTIME_ERROR_COUNT_PLUS_1
 } RuntimeError;
 
@@ -95,6 +124,17 @@ typedef enum {
     INDEX_EXPRESSION,
     INCREMENT_EXPRESSION,
     DECREMENT_EXPRESSION,
+    MEMBER_EXPRESSION,
+    /* quickened forms, only set by the AST walker at run time */
+    INT_ADD_EXPRESSION,
+    INT_SUB_EXPRESSION,
+    INT_MUL_EXPRESSION,
+    INT_EQ_EXPRESSION,
+    INT_NE_EXPRESSION,
+    INT_GT_EXPRESSION,
+    INT_GE_EXPRESSION,
+    INT_LT_EXPRESSION,
+    INT_LE_EXPRESSION,
     EXPRESSION_TYPE_COUNT_PLUS_1
 } ExpressionType;
 
@@ -124,11 +164,13 @@ typedef struct {
 typedef struct {
     Expression *left;
     Expression *right;
+    MRSK_Boolean quickening_failed;
 } BinaryExpression;
 
 typedef struct {
     char *identifier;
     ArgumentList *argument;
+    struct FunctionDefinition_tag *function;
 } FunctionCallExpression;
 
 typedef struct ExpressionList_tag {
@@ -144,6 +186,7 @@ typedef struct {
 typedef struct {
     Expression *expression;
     char *identifier;
+    int selector;
     ArgumentList *argument;
 } MethodCallExpression;
 
@@ -151,6 +194,32 @@ typedef struct {
     Expression *operand;
 } IncrementOrDecrement;
 
+typedef struct {
+    char *name;
+    int local_index;
+    int global_index;
+} IdentifierExpression;
+
+/*
+ * record.name.  slot is where name is in every struct that has such a
+ * field, found by mrsk_fix_tree(), or -1 if they disagree; it is checked
+ * against the record's shape at run time before it is used.
+ */
+typedef struct {
+    Expression *expression;
+    char *member_name;
+    int slot;
+} MemberExpression;
+
+/*
+ * object is created once by mrsk_fix_tree() and shared by every
+ * evaluation of the literal; it is never collected.
+ */
+typedef struct {
+    char *string;
+    MRSK_Object *object;
+} StringExpression;
+
 struct Expression_tag {
     ExpressionType type;
     int line_number;
@@ -158,8 +227,8 @@ struct Expression_tag {
         MRSK_Boolean boolean_value;
         int int_value;
         double double_value;
-        char *string_value;
-        char *identifier;
+        StringExpression string_expression;
+        IdentifierExpression identifier;
         AssignExpression assign_expression;
         BinaryExpression binary_expression;
         Expression *minus_expression;
@@ -168,6 +237,7 @@ struct Expression_tag {
         ExpressionList *array_literal;
         IndexExpression index_expression;
         IncrementOrDecrement inc_dec;
+        MemberExpression member_expression;
     } u;
 };
 
@@ -184,6 +254,7 @@ typedef struct {
 
 typedef struct IdentifierList_tag {
     char *name;
+    int global_index;
     struct IdentifierList_tag *next;
 } IdentifierList;
 
@@ -253,9 +324,123 @@ typedef struct ParameterList_tag {
 typedef enum {
     MURASAKI_FUNCTION_DEFINITION = 1,
     NATIVE_FUNCTION_DEFINITION,
+    RECORD_DEFINITION,
     FUNCTION_DEFINITION_TYPE_COUNT_PLUS_1
 } FunctionDefinitionType;
 
+typedef enum {
+    PUSH_INT_OP = 1,
+    PUSH_DOUBLE_OP,
+    PUSH_BOOLEAN_OP,
+    PUSH_STRING_OP,
+    PUSH_NONE_OP,
+    PUSH_VARIABLE_OP,
+    STORE_VARIABLE_OP,
+    PUSH_ARRAY_ELEMENT_OP,
+    STORE_ARRAY_ELEMENT_OP,
+    INCREMENT_VARIABLE_OP,
+    DECREMENT_VARIABLE_OP,
+    PUSH_LOCAL_OP,
+    STORE_LOCAL_OP,
+    INCREMENT_LOCAL_OP,
+    DECREMENT_LOCAL_OP,
+    PUSH_GLOBAL_OP,
+    STORE_GLOBAL_OP,
+    INCREMENT_GLOBAL_OP,
+    DECREMENT_GLOBAL_OP,
+    INCREMENT_ARRAY_ELEMENT_OP,
+    DECREMENT_ARRAY_ELEMENT_OP,
+    PUSH_ARRAY_ELEMENT_N_OP,
+    STORE_ARRAY_ELEMENT_N_OP,
+    INCREMENT_ARRAY_ELEMENT_N_OP,
+    DECREMENT_ARRAY_ELEMENT_N_OP,
+    PUSH_FIELD_OP,
+    STORE_FIELD_OP,
+    INCREMENT_FIELD_OP,
+    DECREMENT_FIELD_OP,
+    ADD_OP,
+    SUB_OP,
+    MUL_OP,
+    DIV_OP,
+    MOD_OP,
+    EQ_OP,
+    NE_OP,
+    GT_OP,
+    GE_OP,
+    LT_OP,
+    LE_OP,
+    MINUS_OP,
+    LOGICAL_AND_OP,
+    LOGICAL_OR_OP,
+    CREATE_ARRAY_OP,
+    CALL_OP,
+    METHOD_CALL_OP,
+    POP_OP,
+    JUMP_OP,
+    JUMP_IF_FALSE_OP,
+    GLOBAL_OP,
+    RETURN_OP,
+    NOT_LVALUE_OP,
+    OPCODE_COUNT_PLUS_1
+} Opcode;
+
+typedef struct {
+    char *mnemonic;
+    int operand_count;
+    int stack_increment;
+} OpcodeInfo;
+
+typedef enum {
+    DOUBLE_CONSTANT = 1,
+    STRING_CONSTANT,
+    IDENTIFIER_CONSTANT,
+    IDENTIFIER_LIST_CONSTANT,
+    FUNCTION_CALL_CONSTANT,
+    CONSTANT_TYPE_COUNT_PLUS_1
+} ConstantType;
+
+typedef struct {
+    ConstantType type;
+    union {
+        double double_value;
+        MRSK_Object *string_object;
+        char *identifier;
+        IdentifierList *identifier_list;
+        FunctionCallExpression *function_call;
+    } u;
+} Constant;
+
+typedef struct {
+    int line_number;
+    int start_pc;
+    int pc_count;
+} LineNumber;
+
+typedef struct {
+    int code_size;
+    int *code;
+    int constant_count;
+    Constant *constant;
+    int line_number_size;
+    LineNumber *line_number;
+    int need_stack_size;
+    char **local_variable;
+} Executable;
+
+/*
+ * The layout shared by every instance of a struct: field[i] (interned)
+ * is the name of the instance's field[i].
+ */
+typedef struct {
+    char *name;
+    int field_count;
+    char **field;
+} RecordShape;
+
+/*
+ * A struct is a RECORD_DEFINITION, so that its name called like a
+ * function, with a value for each field in order, makes an instance.
+ */
 typedef struct FunctionDefinition_tag {
     char *name;
     FunctionDefinitionType type;
@@ -263,10 +448,17 @@ typedef struct FunctionDefinition_tag {
         struct {
             ParameterList *parameter;
             Block *block;
+            int parameter_count;
+            int local_variable_count;
+            char **local_variable;
+            Executable *executable;
          } murasaki_f;
         struct {
             MRSK_NativeFunctionProc *proc;
         } native_f;
+        struct {
+            RecordShape shape;
+        } record_f;
     } u;
     struct FunctionDefinition_tag *next;
 } FunctionDefinition;
@@ -292,86 +484,346 @@ typedef struct {
     } u;
 } StatementResult;
 
-typedef struct GlobalVariableRef_tag {
-    Variable *variable;
-    struct GlobalVariableRef_tag *next;
-} GlobalVariableRef;
-
-typedef struct RefInNativeFunc_tag {
-    MRSK_Object *object;
-    struct RefInNativeFunc_tag *next;
-} RefInNativeFunc;
+/* type tag of a local variable slot that has not been assigned yet */
+#define UNDEFINED_VALUE_TYPE ((MRSK_ValueType)0)
 
 struct MRSK_LocalEnvironment_tag {
+    int frame_size;
+    MRSK_Value *frame;
     Variable *variable;
-    GlobalVariableRef *global_variable;
-    RefInNativeFunc *ref_in_native_method;
+    int ref_base;
     struct MRSK_LocalEnvironment_tag *next;
 };
 
+/*
+ * Environments and their frame slots are carved out of chunks that are
+ * never moved, so an MRSK_LocalEnvironment pointer stays valid while the
+ * stack grows.  Chunks above current are kept for reuse.
+ */
+typedef struct CallFrameChunk_tag {
+    int environment_alloc_size;
+    int environment_count;
+    MRSK_LocalEnvironment *environment;
+    int value_alloc_size;
+    int value_count;
+    MRSK_Value *value;
+    struct CallFrameChunk_tag *prev;
+    struct CallFrameChunk_tag *next;
+} CallFrameChunk;
+
+/*
+ * Objects created by native functions are rooted on ref until the
+ * environment that created them is popped (back to its ref_base).
+ */
+typedef struct {
+    CallFrameChunk *first;
+    CallFrameChunk *current;
+    int ref_count;
+    int ref_alloc_size;
+    MRSK_Object **ref;
+} CallFrameStack;
+
 typedef struct {
     int stack_alloc_size;
     int stack_pointer;
     MRSK_Value *stack;
 } Stack;
 
+typedef struct {
+    int minor_count;
+    int major_count;
+    int slice_count;
+    clock_t minor_time;
+    clock_t major_time;
+    clock_t max_pause;
+    int pause_count[GC_PAUSE_BUCKET_COUNT];
+} GCStat;
+
+typedef struct {
+    int count;
+    int alloc_size;
+    MRSK_Object **object;
+} ObjectStack;
+
+typedef enum {
+    GC_IDLE = 1,
+    GC_MARKING,
+    GC_SWEEPING
+} GCPhase;
+
+/*
+ * Objects are allocated from HeapChunks and start out young, in the
+ * young list.  A minor collection traces only young objects, from the
+ * roots and from the old objects in remembered, and moves the live ones
+ * to header, the old list, where they stay.  Objects never move, so C
+ * code may keep pointers to them.  A minor collection runs when
+ * current_heap_size passes current_threshold.
+ *
+ * Once it also passes major_threshold, a major collection of the old
+ * list starts, and runs a slice of slice_work objects or values after
+ * each minor collection.  It marks the old objects reachable when it
+ * started (the roots are shaded at once, and then gray is traced, a
+ * big object maybe over several slices) and sweeps from sweep; objects
+ * promoted while it marks are black.
+ * Between major collections every old object is white.
+ */
 typedef struct {
     int current_heap_size;
     int current_threshold;
+    int major_threshold;
     MRSK_Object *header;
+    MRSK_Object *young;
+    struct HeapChunk_tag *chunk;
+    struct HeapChunk_tag *current_chunk;
+    int cursor;
+    ObjectStack remembered;
+    ObjectStack young_gray;
+    ObjectStack gray;
+    MRSK_Object *scan;
+    int scan_index;
+    GCPhase phase;
+    MRSK_Object *sweep;
+    int slice_work;
+    GCStat stat;
 } Heap;
 
+typedef enum {
+    ARRAY_OBJECT = 1,
+    STRING_OBJECT,
+    INT_ARRAY_OBJECT,
+    DOUBLE_ARRAY_OBJECT,
+    MULTI_ARRAY_OBJECT,
+    MAP_OBJECT,
+    RECORD_OBJECT,
+    OBJECT_TYPE_COUNT_PLUS_1
+} ObjectType;
+
+#define mrsk_is_array_object(type) \
+    ((type) == ARRAY_OBJECT || (type) == INT_ARRAY_OBJECT \
+     || (type) == DOUBLE_ARRAY_OBJECT)
+
+typedef struct {
+    int argument_count;
+    MRSK_MethodProc *proc;
+} Method;
+
+typedef struct {
+    int size;
+    Method *method;
+} MethodTable;
+
+/*
+ * Globals get a slot number the first time their name is seen (at
+ * compile time for names the program uses) and keep it for the life of
+ * the interpreter.  hash maps a name to its slot by open addressing;
+ * empty buckets hold -1.
+ */
+typedef struct {
+    int count;
+    int alloc_size;
+    Variable **variable;
+    int hash_size;
+    int *hash;
+} GlobalVariableTable;
+
+typedef struct StringPoolEntry_tag {
+    char *string;
+    unsigned int hash;
+    struct StringPoolEntry_tag *next;
+} StringPoolEntry;
+
+/*
+ * Every identifier and string literal the lexer reads is interned here,
+ * entries and strings in interpreter_storage.  bucket has hash_size
+ * (a power of 2) chains.
+ */
+typedef struct {
+    int count;
+    int hash_size;
+    StringPoolEntry **bucket;
+} StringPool;
+
 struct MRSK_Interpreter_tag {
     MEM_Storage interpreter_storage;
     MEM_Storage execute_storage;
-    Variable *variable;
+    GlobalVariableTable global;
+    StringPool string_pool;
     FunctionDefinition *function_list;
     StatementList *statement_list;
     int current_line_number;
     Stack stack;
     Heap heap;
     MRSK_LocalEnvironment *top_environment;
+    CallFrameStack frame_stack;
+    Executable *executable;
+    Executable *current_executable;
+    MRSK_ExecuteMode execute_mode;
+    int selector_count;
+    char **selector;
+    MethodTable method_table[OBJECT_TYPE_COUNT_PLUS_1];
+    FILE *dump_tree_fp;
+    FILE *gc_stat_fp;
 };
 
+/*
+ * All the array object types are MRSK_ARRAY_VALUE to the program.
+ * An ARRAY_OBJECT holds boxed values in array.value; INT_ARRAY_OBJECT
+ * and DOUBLE_ARRAY_OBJECT keep bare numbers in array.int_value and
+ * array.double_value, which the collector never needs to look into.
+ * If owner is set, array points into owner's storage and the array is
+ * a view of part of owner which keeps it alive.  A row of a multi
+ * dimensional array is written through and can't change its size; a
+ * slice() (owner is an array, never seen by the program) gets elements
+ * of its own the first time it is written.
+ */
 struct MRSK_Array_tag {
     int size;
     int alloc_size;
-    MRSK_Value *array;
+    union {
+        MRSK_Value *value;
+        int *int_value;
+        double *double_value;
+    } array;
+    MRSK_Object *owner;
 };
 
+/*
+ * new_array(d1, d2, ...) with two or more sizes: one block of
+ * d1 * d2 * ... elements in row major order.  element[i*stride[0] + ...]
+ * is [i][...]; stride[rank-1] is 1.  Indexing with fewer than rank
+ * subscripts gives a view (owner set) sharing the block and the tail
+ * of dim and stride; the last dimension's view is a plain ARRAY_OBJECT.
+ */
+typedef struct {
+    int rank;
+    int *dim;
+    int *stride;
+    MRSK_Value *element;
+    MRSK_Object *owner;
+} MRSK_MultiArray;
+
+/*
+ * A MAP_OBJECT is a Robin Hood hash table: a key sits at or after slot
+ * hash & (capacity - 1), and distance is how far after, plus 1 (0 is an
+ * empty slot).  A key never sits farther from its home slot than a key
+ * it was inserted past, so a search stops at the first slot whose
+ * distance is shorter than its own, and removal shifts the following
+ * run back one slot instead of leaving a tombstone.
+ */
+typedef struct {
+    unsigned int hash;
+    int distance;
+    MRSK_Value key;
+    MRSK_Value value;
+} MapEntry;
+
+typedef struct {
+    int count;
+    int capacity;
+    MapEntry *entry;
+} MRSK_Map;
+
+/* An instance of a struct; its field names are only in shape. */
+typedef struct {
+    RecordShape *shape;
+    MRSK_Value *field;
+} MRSK_Record;
+
+/*
+ * Growable storage for strings built by concatenation; the characters
+ * follow the header.  Several string objects may share one buffer, each
+ * seeing a prefix of it; length is how much of it is in use.
+ */
+typedef struct {
+    int ref_count;
+    int alloc_size;
+    int length;
+} StringBuffer;
+
+/*
+ * A string's characters are string[0..length-1].  If buffer is set,
+ * string points into it and is only guaranteed to be '\0' terminated
+ * through mrsk_get_string_chars().  Strings shorter than
+ * SHORT_STRING_SIZE are kept in short_string, and string points there,
+ * so readers never need to know which layout they have.  hash is
+ * computed on first use by mrsk_get_string_hash().
+ */
 struct MRSK_String_tag {
-    MRSK_Boolean is_literal;
     char *string;
+    int length;
+    unsigned int hash;
+    StringBuffer *buffer;
+    unsigned int is_literal:1;
+    unsigned int has_hash:1;
+    char short_string[SHORT_STRING_SIZE];
 };
 
-typedef enum {
-    ARRAY_OBJECT = 1,
-    STRING_OBJECT,
-    OBJECT_TYPE_COUNT_PLUS_1
-} ObjectType;
-
 #define dkc_is_object_value(type) \
-    ((type) == MRSK_STRING_VALUE || (type == MRSK_ARRAY_VALUE))
+    ((type) == MRSK_STRING_VALUE || (type == MRSK_ARRAY_VALUE) \
+     || (type) == MRSK_MAP_VALUE || (type) == MRSK_RECORD_VALUE)
 
 struct MRSK_Object_tag {
     ObjectType type;
     unsigned int marked:1;
+    unsigned int young:1;
+    unsigned int remembered:1;
+    unsigned int slot:16;
     union {
         MRSK_Array array;
+        MRSK_MultiArray multi_array;
         MRSK_String string;
+        MRSK_Map map;
+        MRSK_Record record;
     } u;
     struct MRSK_Object_tag *prev;
     struct MRSK_Object_tag *next;
 };
 
+/*
+ * Objects are allocated by bumping Heap.cursor through a chunk's slots,
+ * skipping the ones still in use; a free slot's type is 0.  slot in an
+ * object is its index in object[], which leads back to its chunk.
+ */
+typedef struct HeapChunk_tag {
+    int free_count;
+    struct HeapChunk_tag *next;
+    MRSK_Object object[HEAP_CHUNK_SIZE];
+} HeapChunk;
+
+/*
+ * An old object that gets a young one is remembered, as a minor
+ * collection doesn't otherwise look into the old generation.
+ */
+#define mrsk_young_barrier(inter, obj, value) \
+    (dkc_is_object_value((value)->type) && (value)->u.object->young \
+     && !(obj)->young ? mrsk_remember_object((inter), (obj)) : (void)0)
+
+/*
+ * Must come before every store of value into *slot, a slot of obj that
+ * the collector would find by tracing obj (for a view, its owner).
+ * While a major collection marks, what the slot held is shaded, so
+ * that everything reachable when the marking started gets marked.
+ */
+#define mrsk_write_barrier(inter, obj, slot, value) \
+    ((inter)->heap.phase == GC_MARKING && !(obj)->young \
+     ? mrsk_shade_values((inter), (obj), (slot), 1) : (void)0, \
+     mrsk_young_barrier((inter), (obj), (value)))
+
+/*
+ * A growable '\0' terminated string; string is NULL until the first
+ * append, and alloc_size doubles as it fills up.
+ */
 typedef struct {
     char *string;
+    int length;
+    int alloc_size;
 } VString;
 
 
 /* create.c */
 void mrsk_function_define(char *identifier, ParameterList *parameter_list,
                          Block *block);
+void mrsk_struct_define(char *identifier, IdentifierList *field_list);
 ParameterList *mrsk_create_parameter(char *identifier);
 ParameterList *mrsk_chain_parameter(ParameterList *list,
                                    char *identifier);
@@ -399,6 +851,8 @@ Expression *mrsk_create_function_call_expression(char *func_name,
 Expression *mrsk_create_method_call_expression(Expression *expression,
                                               char *method_name,
                                               ArgumentList *argument);
+Expression *mrsk_create_member_expression(Expression *expression,
+                                         char *member_name);
 Expression *mrsk_create_boolean_expression(MRSK_Boolean value);
 Expression *mrsk_create_none_expression(void);
 Statement *mrsk_create_global_statement(IdentifierList *identifier_list);
@@ -427,30 +881,126 @@ void mrsk_add_string_literal(int letter);
 void mrsk_reset_string_literal_buffer(void);
 char *mrsk_close_string_literal(void);
 
+/* string_pool.c */
+unsigned int mrsk_hash_string(char *str);
+char *mrsk_intern_string(MRSK_Interpreter *inter, char *str);
+void mrsk_dispose_string_pool(MRSK_Interpreter *inter);
+
 /* execute.c */
+void mrsk_declare_global_variable(MRSK_Interpreter *inter,
+                                  MRSK_LocalEnvironment *env,
+                                  IdentifierList *identifier_list,
+                                  int line_number);
 StatementResult
 mrsk_execute_statement_list(MRSK_Interpreter *inter,
                            MRSK_LocalEnvironment *env, StatementList *list);
 
+/* optimize.c */
+void mrsk_optimize_tree(MRSK_Interpreter *inter);
+
+/* dump_tree.c */
+void mrsk_dump_tree(MRSK_Interpreter *inter, FILE *fp);
+
+/* fix_tree.c */
+void mrsk_fix_tree(MRSK_Interpreter *inter);
+
 /* eval.c */
-MRSK_Value mrsk_eval_binary_expression(MRSK_Interpreter *inter,
+MRSK_LocalEnvironment *mrsk_alloc_local_environment(MRSK_Interpreter *inter,
+                                                    int frame_size);
+void mrsk_dispose_local_environment(MRSK_Interpreter *inter);
+void mrsk_dispose_frame_stack(MRSK_Interpreter *inter);
+Variable *mrsk_search_variable(MRSK_Interpreter *inter,
+                               MRSK_LocalEnvironment *env, char *identifier);
+MRSK_Value *mrsk_get_identifier_lvalue(MRSK_Interpreter *inter,
+                                       MRSK_LocalEnvironment *env,
+                                       char *identifier);
+MRSK_Value mrsk_get_array_element(MRSK_Interpreter *inter,
+                                  MRSK_Value *array, MRSK_Value *index,
+                                  int line_number);
+void mrsk_set_array_element(MRSK_Interpreter *inter, MRSK_Value *array,
+                            MRSK_Value *index, MRSK_Value *value,
+                            int line_number);
+MRSK_Value mrsk_inc_dec_array_element(MRSK_Interpreter *inter,
+                                      MRSK_Value *array, MRSK_Value *index,
+                                      int increment, int line_number);
+MRSK_Value mrsk_get_array_element_n(MRSK_Interpreter *inter,
+                                    MRSK_Value *array, int index_count,
+                                    MRSK_Value *index, int line_number);
+void mrsk_set_array_element_n(MRSK_Interpreter *inter, MRSK_Value *array,
+                              int index_count, MRSK_Value *index,
+                              MRSK_Value *value, int line_number);
+MRSK_Value mrsk_inc_dec_array_element_n(MRSK_Interpreter *inter,
+                                        MRSK_Value *array, int index_count,
+                                        MRSK_Value *index, int increment,
+                                        int line_number);
+MRSK_Value *mrsk_get_field(MRSK_Value *record, char *name, int slot,
+                           int line_number);
+MRSK_Value mrsk_construct_record(MRSK_Interpreter *inter, RecordShape *shape,
+                                 int arg_count, MRSK_Value *args,
+                                 int line_number);
+void mrsk_binary_operation(MRSK_Interpreter *inter, ExpressionType operator,
+                           MRSK_Value *left, MRSK_Value *right,
+                           MRSK_Value *result, int line_number);
+MRSK_Value mrsk_call_function_in_env(MRSK_Interpreter *inter,
                                      MRSK_LocalEnvironment *env,
-                                     ExpressionType operator,
-                                     Expression *left, Expression *right);
-MRSK_Value mrsk_eval_minus_expression(MRSK_Interpreter *inter,
-                                    MRSK_LocalEnvironment *env,
-                                    Expression *operand);
+                                     FunctionDefinition *func,
+                                     int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_invoke_method(MRSK_Interpreter *inter, MRSK_Value *receiver,
+                              int selector, int arg_count,
+                              MRSK_Value *args, int line_number);
 MRSK_Value mrsk_eval_expression(MRSK_Interpreter *inter,
                               MRSK_LocalEnvironment *env, Expression *expr);
 
+/* generate.c */
+void mrsk_generate(MRSK_Interpreter *inter);
+void mrsk_dispose_executable(Executable *exe);
+
+/* vm.c */
+MRSK_Value mrsk_vm_execute(MRSK_Interpreter *inter,
+                           MRSK_LocalEnvironment *env, Executable *exe);
+int mrsk_resolve_line_number(MRSK_Interpreter *inter, int line_number);
+
 /* heap.c */
 MRSK_Object *mrsk_literal_to_mrsk_string(MRSK_Interpreter *inter, char *str);
 MRSK_Object *mrsk_create_murasaki_string_i(MRSK_Interpreter *inter, char *str);
+MRSK_Object *mrsk_chain_string(MRSK_Interpreter *inter, MRSK_Object *left,
+                               char *right, int right_length);
+char *mrsk_get_string_chars(MRSK_Interpreter *inter, MRSK_Object *obj);
+MRSK_Object *mrsk_string_slice(MRSK_Interpreter *inter, MRSK_Object *obj,
+                               int start, int end);
+unsigned int mrsk_get_string_hash(MRSK_Object *obj);
+MRSK_Boolean mrsk_string_equals(MRSK_Object *left, MRSK_Object *right);
+int mrsk_compare_string(MRSK_Object *left, MRSK_Object *right);
 MRSK_Object *mrsk_create_array_i(MRSK_Interpreter *inter, int size);
-void mrsk_array_add(MRSK_Interpreter *inter, MRSK_Object *obj, MRSK_Value v);
+MRSK_Object *mrsk_create_typed_array_i(MRSK_Interpreter *inter,
+                                       ObjectType type, int size);
+MRSK_Object *mrsk_create_multi_array_i(MRSK_Interpreter *inter,
+                                       int rank, int *dim);
+MRSK_Object *mrsk_create_multi_array_view(MRSK_Interpreter *inter,
+                                          MRSK_Object *obj, int index_count,
+                                          int offset);
+MRSK_Object *mrsk_create_map_i(MRSK_Interpreter *inter);
+MRSK_Object *mrsk_create_record_i(MRSK_Interpreter *inter,
+                                  RecordShape *shape);
+MRSK_Value mrsk_fetch_array_element(MRSK_Object *obj, int index);
+void mrsk_store_array_element(MRSK_Interpreter *inter, MRSK_Object *obj,
+                              int index, MRSK_Value *v, int line_number);
+MRSK_Object *mrsk_array_slice(MRSK_Interpreter *inter, MRSK_Object *obj,
+                              int start, int end);
+void mrsk_array_unshare(MRSK_Interpreter *inter, MRSK_Object *obj);
+void mrsk_array_add(MRSK_Interpreter *inter, MRSK_Object *obj, MRSK_Value v,
+                    int line_number);
 void
 mrsk_array_resize(MRSK_Interpreter *inter, MRSK_Object *obj, int new_size);
+void mrsk_array_reserve(MRSK_Interpreter *inter, MRSK_Object *obj, int size);
+void mrsk_array_shrink_to_fit(MRSK_Interpreter *inter, MRSK_Object *obj);
 void mrsk_garbage_collect(MRSK_Interpreter *inter);
+void mrsk_remember_object(MRSK_Interpreter *inter, MRSK_Object *obj);
+void mrsk_shade_values(MRSK_Interpreter *inter, MRSK_Object *obj,
+                       MRSK_Value *v, int count);
+void mrsk_finish_scan(MRSK_Interpreter *inter, MRSK_Object *obj);
+void mrsk_print_gc_stat(MRSK_Interpreter *inter, FILE *fp);
+void mrsk_dispose_heap(MRSK_Interpreter *inter);
 
 
 /* util.c */
@@ -464,12 +1014,19 @@ Variable *
 mrsk_search_global_variable(MRSK_Interpreter *inter, char *identifier);
 Variable *mrsk_add_local_variable(MRSK_LocalEnvironment *env, char *identifier);
 Variable *mrsk_add_global_variable(MRSK_Interpreter *inter, char *identifier);
+int mrsk_intern_global_variable(MRSK_Interpreter *inter, char *identifier);
 MRSK_NativeFunctionProc *
 mrsk_search_native_function(MRSK_Interpreter *inter, char *name);
 FunctionDefinition *mrsk_search_function(char *name);
+int mrsk_intern_selector(MRSK_Interpreter *inter, char *name);
+FunctionDefinition *
+mrsk_resolve_function_call(FunctionCallExpression *fce, int line_number);
 char *mrsk_get_operator_string(ExpressionType type);
+int mrsk_format_int(char *buf, int value);
+int mrsk_format_double(char *buf, double value);
 void mrsk_vstr_clear(VString *v);
 void mrsk_vstr_append_string(VString *v, char *str);
+void mrsk_vstr_append_n(VString *v, char *str, int length);
 void mrsk_vstr_append_character(VString *v, int ch);
 
 /* error.c */
@@ -477,6 +1034,7 @@ void mrsk_compile_error(CompileError id, ...);
 void mrsk_runtime_error(int line_number, RuntimeError id, ...);
 
 /* native.c */
+void mrsk_check_argument_count(int arg_count, int true_count);
 MRSK_Value mrsk_nv_print_proc(MRSK_Interpreter *interpreter,
                             MRSK_LocalEnvironment *env,
                             int arg_count, MRSK_Value *args);
@@ -495,7 +1053,122 @@ MRSK_Value mrsk_nv_fputs_proc(MRSK_Interpreter *interpreter,
 MRSK_Value mrsk_nv_new_array_proc(MRSK_Interpreter *interpreter,
                                 MRSK_LocalEnvironment *env,
                                 int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_nv_int_array_proc(MRSK_Interpreter *interpreter,
+                                  MRSK_LocalEnvironment *env,
+                                  int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_nv_double_array_proc(MRSK_Interpreter *interpreter,
+                                     MRSK_LocalEnvironment *env,
+                                     int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_nm_array_add_proc(MRSK_Interpreter *interpreter,
+                                  MRSK_LocalEnvironment *env,
+                                  MRSK_Value *receiver,
+                                  int arg_count, MRSK_Value *args,
+                                  int line_number);
+MRSK_Value mrsk_nm_array_size_proc(MRSK_Interpreter *interpreter,
+                                   MRSK_LocalEnvironment *env,
+                                   MRSK_Value *receiver,
+                                   int arg_count, MRSK_Value *args,
+                                   int line_number);
+MRSK_Value mrsk_nm_array_resize_proc(MRSK_Interpreter *interpreter,
+                                     MRSK_LocalEnvironment *env,
+                                     MRSK_Value *receiver,
+                                     int arg_count, MRSK_Value *args,
+                                     int line_number);
+MRSK_Value mrsk_nm_array_reserve_proc(MRSK_Interpreter *interpreter,
+                                      MRSK_LocalEnvironment *env,
+                                      MRSK_Value *receiver,
+                                      int arg_count, MRSK_Value *args,
+                                      int line_number);
+MRSK_Value mrsk_nm_array_shrink_to_fit_proc(MRSK_Interpreter *interpreter,
+                                            MRSK_LocalEnvironment *env,
+                                            MRSK_Value *receiver,
+                                            int arg_count, MRSK_Value *args,
+                                            int line_number);
+MRSK_Value mrsk_nm_array_slice_proc(MRSK_Interpreter *interpreter,
+                                    MRSK_LocalEnvironment *env,
+                                    MRSK_Value *receiver,
+                                    int arg_count, MRSK_Value *args,
+                                    int line_number);
+MRSK_Value mrsk_nm_string_length_proc(MRSK_Interpreter *interpreter,
+                                      MRSK_LocalEnvironment *env,
+                                      MRSK_Value *receiver,
+                                      int arg_count, MRSK_Value *args,
+                                      int line_number);
+MRSK_Value mrsk_nm_string_slice_proc(MRSK_Interpreter *interpreter,
+                                     MRSK_LocalEnvironment *env,
+                                     MRSK_Value *receiver,
+                                     int arg_count, MRSK_Value *args,
+                                     int line_number);
 void mrsk_add_std_fp(MRSK_Interpreter *inter);
 
+/* array_lib.c */
+MRSK_Value mrsk_nv_sum_proc(MRSK_Interpreter *interpreter,
+                            MRSK_LocalEnvironment *env,
+                            int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_nv_min_proc(MRSK_Interpreter *interpreter,
+                            MRSK_LocalEnvironment *env,
+                            int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_nv_max_proc(MRSK_Interpreter *interpreter,
+                            MRSK_LocalEnvironment *env,
+                            int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_nv_fill_proc(MRSK_Interpreter *interpreter,
+                             MRSK_LocalEnvironment *env,
+                             int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_nv_copy_range_proc(MRSK_Interpreter *interpreter,
+                                   MRSK_LocalEnvironment *env,
+                                   int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_nv_index_of_proc(MRSK_Interpreter *interpreter,
+                                 MRSK_LocalEnvironment *env,
+                                 int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_nv_count_proc(MRSK_Interpreter *interpreter,
+                              MRSK_LocalEnvironment *env,
+                              int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_nv_dot_proc(MRSK_Interpreter *interpreter,
+                            MRSK_LocalEnvironment *env,
+                            int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_nv_sort_proc(MRSK_Interpreter *interpreter,
+                             MRSK_LocalEnvironment *env,
+                             int arg_count, MRSK_Value *args);
+
+/* map.c */
+MRSK_Value *mrsk_map_search(MRSK_Object *map, MRSK_Value *key,
+                            int line_number);
+void mrsk_map_set(MRSK_Interpreter *inter, MRSK_Object *map,
+                  MRSK_Value *key, MRSK_Value *value, int line_number);
+MRSK_Boolean mrsk_map_remove(MRSK_Interpreter *inter, MRSK_Object *map,
+                             MRSK_Value *key, int line_number);
+MRSK_Value mrsk_nv_new_map_proc(MRSK_Interpreter *interpreter,
+                                MRSK_LocalEnvironment *env,
+                                int arg_count, MRSK_Value *args);
+MRSK_Value mrsk_nm_map_get_proc(MRSK_Interpreter *interpreter,
+                                MRSK_LocalEnvironment *env,
+                                MRSK_Value *receiver,
+                                int arg_count, MRSK_Value *args,
+                                int line_number);
+MRSK_Value mrsk_nm_map_set_proc(MRSK_Interpreter *interpreter,
+                                MRSK_LocalEnvironment *env,
+                                MRSK_Value *receiver,
+                                int arg_count, MRSK_Value *args,
+                                int line_number);
+MRSK_Value mrsk_nm_map_has_proc(MRSK_Interpreter *interpreter,
+                                MRSK_LocalEnvironment *env,
+                                MRSK_Value *receiver,
+                                int arg_count, MRSK_Value *args,
+                                int line_number);
+MRSK_Value mrsk_nm_map_remove_proc(MRSK_Interpreter *interpreter,
+                                   MRSK_LocalEnvironment *env,
+                                   MRSK_Value *receiver,
+                                   int arg_count, MRSK_Value *args,
+                                   int line_number);
+MRSK_Value mrsk_nm_map_keys_proc(MRSK_Interpreter *interpreter,
+                                 MRSK_LocalEnvironment *env,
+                                 MRSK_Value *receiver,
+                                 int arg_count, MRSK_Value *args,
+                                 int line_number);
+MRSK_Value mrsk_nm_map_size_proc(MRSK_Interpreter *interpreter,
+                                 MRSK_LocalEnvironment *env,
+                                 MRSK_Value *receiver,
+                                 int arg_count, MRSK_Value *args,
+                                 int line_number);
 
 #endif /* PRIVATE_MURASAKI_H_INCLUDED */
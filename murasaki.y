@@ -22,7 +22,7 @@
 %token FUNCTION IF ELIF ELSE WHILE FOR RETURN_T BREAK CONTINUE NONE_T
        LP RP LC RC LB RB SEMICOLON COMMA ASSIGN LOGICAL_AND LOGICAL_OR
        EQ NE GT GE LT LE ADD SUB MUL DIV MOD TRUE_T FALSE_T GLOBAL_T
-       DOT INCREMENT DECREMENT
+       DOT INCREMENT DECREMENT STRUCT
 %type <parameter_list> parameter_list
 %type <argument_list> argument_list
 %type <expression> expression expression_opt
@@ -37,7 +37,7 @@
 %type <statement_list> statement_list
 %type <block> block
 %type <elif> elif elif_list
-%type <identifier_list> identifier_list
+%type <identifier_list> identifier_list field_list
 %%
 translation_unit
     : definition_or_statement
@@ -45,6 +45,7 @@ translation_unit
     ;
 definition_or_statement
     : function_definition
+    | struct_definition
     | statement
     {
         MRSK_Interpreter *inter = mrsk_get_current_interpreter();
@@ -61,6 +62,22 @@ function_definition
         mrsk_function_define($2, NULL, $5);
     }
     ;
+struct_definition
+    : STRUCT IDENTIFIER LC field_list RC
+    {
+        mrsk_struct_define($2, $4);
+    }
+    ;
+field_list
+    : IDENTIFIER SEMICOLON
+    {
+        $$ = mrsk_create_global_identifier($1);
+    }
+    | field_list IDENTIFIER SEMICOLON
+    {
+        $$ = mrsk_chain_identifier($1, $2);
+    }
+    ;
 parameter_list
     : IDENTIFIER
     {
@@ -189,6 +206,10 @@ postfix_expression
     {
         $$ = mrsk_create_method_call_expression($1, $3, NULL);
     }
+    | postfix_expression DOT IDENTIFIER
+    {
+        $$ = mrsk_create_member_expression($1, $3);
+    }
     | postfix_expression INCREMENT
     {
         $$ = mrsk_create_incdec_expression($1, INCREMENT_EXPRESSION);
@@ -251,7 +272,7 @@ expression_list
     {
         $$ = mrsk_create_expression_list($1);
     }
-    | expression COMMA expression
+    | expression_list COMMA expression
     {
         $$ = mrsk_chain_expression_list($1, $3);
     }
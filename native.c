@@ -1,3 +1,5 @@
+#include <limits.h>
+#include <string.h>
 #include "DBG.h"
 #include "MRSK_dev.h"
 #include "murasaki.h"
@@ -8,7 +10,7 @@ static MRSK_NativePointerInfo st_native_lib_info = {
     NATIVE_LIB_NAME
 };
 
-static void check_argument_count(int arg_count, int true_count)
+void mrsk_check_argument_count(int arg_count, int true_count)
 {
     if (arg_count < true_count) {
         mrsk_runtime_error(0, ARGUMENT_TOO_FEW_ERR, MESSAGE_ARGUMENT_END);
@@ -21,14 +23,25 @@ MRSK_Value mrsk_nv_print_proc(MRSK_Interpreter *interpreter, MRSK_LocalEnvironme
                               int arg_count, MRSK_Value *args)
 {
     MRSK_Value value;
+    char buf[NUMBER_FORMAT_BUF_SIZE];
     char *str;
 
     value.type = MRSK_NONE_VALUE;
 
-    check_argument_count(arg_count, 1);
-    str = MRSK_value_to_string(&args[0]);
-    printf("%s", str);
-    MEM_free(str);
+    mrsk_check_argument_count(arg_count, 1);
+    if (args[0].type == MRSK_STRING_VALUE) {
+        fwrite(args[0].u.object->u.string.string, 1,
+               args[0].u.object->u.string.length, stdout);
+    } else if (args[0].type == MRSK_INT_VALUE) {
+        fwrite(buf, 1, mrsk_format_int(buf, args[0].u.int_value), stdout);
+    } else if (args[0].type == MRSK_DOUBLE_VALUE) {
+        fwrite(buf, 1, mrsk_format_double(buf, args[0].u.double_value),
+               stdout);
+    } else {
+        str = MRSK_value_to_string(&args[0]);
+        printf("%s", str);
+        MEM_free(str);
+    }
 
     return value;
 }
@@ -39,14 +52,15 @@ MRSK_Value mrsk_nv_fopen_proc(MRSK_Interpreter *interpreter, MRSK_LocalEnvironme
     MRSK_Value value;
     FILE *fp;
 
-    check_argument_count(arg_count, 2);
+    mrsk_check_argument_count(arg_count, 2);
 
     if (args[0].type != MRSK_STRING_VALUE
         || args[1].type != MRSK_STRING_VALUE) {
         mrsk_runtime_error(0, FOPEN_ARGUMENT_TYPE_ERR, MESSAGE_ARGUMENT_END);
     }
 
-    fp = fopen(args[0].u.object->u.string.string, args[1].u.object->u.string.string);
+    fp = fopen(mrsk_get_string_chars(interpreter, args[0].u.object),
+               mrsk_get_string_chars(interpreter, args[1].u.object));
 
     if (fp == NULL) {
         value.type = MRSK_NONE_VALUE;
@@ -70,7 +84,7 @@ MRSK_Value mrsk_nv_fclose_proc(MRSK_Interpreter *interpreter, MRSK_LocalEnvironm
     MRSK_Value value;
     FILE *fp;
 
-    check_argument_count(arg_count, 1);
+    mrsk_check_argument_count(arg_count, 1);
 
     value.type = MRSK_NONE_VALUE;
     if (args[0].type != MRSK_NATIVE_POINTER_VALUE
@@ -88,10 +102,9 @@ MRSK_Value mrsk_nv_fgets_proc(MRSK_Interpreter *interpreter, MRSK_LocalEnvironme
     MRSK_Value value;
     FILE *fp;
     char buf[LINE_BUF_SIZE];
-    char *ret_buf = NULL;
-    int ret_len = 0;
+    VString line;
 
-    check_argument_count(arg_count, 1);
+    mrsk_check_argument_count(arg_count, 1);
 
     if (args[0].type != MRSK_NATIVE_POINTER_VALUE
         || !check_native_pointer(&args[0])) {
@@ -100,23 +113,17 @@ MRSK_Value mrsk_nv_fgets_proc(MRSK_Interpreter *interpreter, MRSK_LocalEnvironme
     }
     fp = args[0].u.native_pointer.pointer;
 
+    mrsk_vstr_clear(&line);
     while (fgets(buf, LINE_BUF_SIZE, fp)) {
-        int new_len;
-        new_len = ret_len + strlen(buf);
-        ret_buf = MEM_realloc(ret_buf, new_len + 1);
-        if (ret_len == 0) {
-            strcpy(ret_buf, buf);
-        } else {
-            strcat(ret_buf, buf);
-        }
-        ret_len = new_len;
-        if (ret_buf[ret_len-1] == '\n') {
+        mrsk_vstr_append_string(&line, buf);
+        if (line.string[line.length-1] == '\n') {
             break;
         }
     }
-    if (ret_len > 0) {
+    if (line.length > 0) {
         value.type = MRSK_STRING_VALUE;
-        value.u.object = MRSK_create_murasaki_string(interpreter, env, ret_buf);
+        value.u.object = MRSK_create_murasaki_string(interpreter, env,
+                                                     line.string);
     } else {
         value.type = MRSK_NONE_VALUE;
     }
@@ -130,7 +137,7 @@ MRSK_Value mrsk_nv_fputs_proc(MRSK_Interpreter *interpreter, MRSK_LocalEnvironme
     MRSK_Value value;
     FILE *fp;
 
-    check_argument_count(arg_count, 2);
+    mrsk_check_argument_count(arg_count, 2);
     value.type = MRSK_NONE_VALUE;
     if (args[0].type != MRSK_STRING_VALUE
         || (args[1].type != MRSK_NATIVE_POINTER_VALUE
@@ -138,7 +145,172 @@ MRSK_Value mrsk_nv_fputs_proc(MRSK_Interpreter *interpreter, MRSK_LocalEnvironme
         mrsk_runtime_error(0, FPUTS_ARGUMENT_TYPE_ERR, MESSAGE_ARGUMENT_END);
     }
     fp = args[1].u.native_pointer.pointer;
-    fputs(args[0].u.object->u.string.string, fp);
+    fputs(mrsk_get_string_chars(interpreter, args[0].u.object), fp);
+
+    return value;
+}
+
+/* A row of a multi dimensional array cannot change its size. */
+static void check_resizable(MRSK_Value *receiver, int line_number)
+{
+    MRSK_Object *owner = receiver->u.object->u.array.owner;
+
+    if (owner && owner->type == MULTI_ARRAY_OBJECT) {
+        mrsk_runtime_error(line_number, ARRAY_VIEW_RESIZE_ERR,
+                           MESSAGE_ARGUMENT_END);
+    }
+}
+
+MRSK_Value mrsk_nm_array_add_proc(MRSK_Interpreter *interpreter,
+                                  MRSK_LocalEnvironment *env,
+                                  MRSK_Value *receiver,
+                                  int arg_count, MRSK_Value *args,
+                                  int line_number)
+{
+    MRSK_Value value;
+
+    check_resizable(receiver, line_number);
+    mrsk_array_add(interpreter, receiver->u.object, args[0], line_number);
+    value.type = MRSK_NONE_VALUE;
+
+    return value;
+}
+
+MRSK_Value mrsk_nm_array_size_proc(MRSK_Interpreter *interpreter,
+                                   MRSK_LocalEnvironment *env,
+                                   MRSK_Value *receiver,
+                                   int arg_count, MRSK_Value *args,
+                                   int line_number)
+{
+    MRSK_Value value;
+    MRSK_Object *obj = receiver->u.object;
+
+    value.type = MRSK_INT_VALUE;
+    if (obj->type == MULTI_ARRAY_OBJECT) {
+        value.u.int_value = obj->u.multi_array.dim[0];
+    } else {
+        value.u.int_value = obj->u.array.size;
+    }
+
+    return value;
+}
+
+MRSK_Value mrsk_nm_array_resize_proc(MRSK_Interpreter *interpreter,
+                                     MRSK_LocalEnvironment *env,
+                                     MRSK_Value *receiver,
+                                     int arg_count, MRSK_Value *args,
+                                     int line_number)
+{
+    MRSK_Value value;
+
+    if (args[0].type != MRSK_INT_VALUE || args[0].u.int_value < 0) {
+        mrsk_runtime_error(line_number, ARRAY_RESIZE_ARGUMENT_ERR,
+                           MESSAGE_ARGUMENT_END);
+    }
+    check_resizable(receiver, line_number);
+    mrsk_array_resize(interpreter, receiver->u.object, args[0].u.int_value);
+    value.type = MRSK_NONE_VALUE;
+
+    return value;
+}
+
+MRSK_Value mrsk_nm_array_reserve_proc(MRSK_Interpreter *interpreter,
+                                      MRSK_LocalEnvironment *env,
+                                      MRSK_Value *receiver,
+                                      int arg_count, MRSK_Value *args,
+                                      int line_number)
+{
+    MRSK_Value value;
+
+    if (args[0].type != MRSK_INT_VALUE || args[0].u.int_value < 0) {
+        mrsk_runtime_error(line_number, ARRAY_RESERVE_ARGUMENT_ERR,
+                           MESSAGE_ARGUMENT_END);
+    }
+    check_resizable(receiver, line_number);
+    mrsk_array_reserve(interpreter, receiver->u.object, args[0].u.int_value);
+    value.type = MRSK_NONE_VALUE;
+
+    return value;
+}
+
+MRSK_Value mrsk_nm_array_shrink_to_fit_proc(MRSK_Interpreter *interpreter,
+                                            MRSK_LocalEnvironment *env,
+                                            MRSK_Value *receiver,
+                                            int arg_count, MRSK_Value *args,
+                                            int line_number)
+{
+    MRSK_Value value;
+
+    check_resizable(receiver, line_number);
+    mrsk_array_shrink_to_fit(interpreter, receiver->u.object);
+    value.type = MRSK_NONE_VALUE;
+
+    return value;
+}
+
+/* slice(start, end) takes [start, end); 0 <= start <= end <= size. */
+static void check_slice_range(MRSK_Value *args, int size, int line_number)
+{
+    if (args[0].type != MRSK_INT_VALUE || args[1].type != MRSK_INT_VALUE) {
+        mrsk_runtime_error(line_number, ARRAY_LIB_ARGUMENT_TYPE_ERR,
+                           STRING_MESSAGE_ARGUMENT, "name", "slice",
+                           MESSAGE_ARGUMENT_END);
+    }
+    if (args[0].u.int_value < 0 || args[0].u.int_value > args[1].u.int_value
+        || args[1].u.int_value > size) {
+        mrsk_runtime_error(line_number, SLICE_ARGUMENT_ERR,
+                           INT_MESSAGE_ARGUMENT, "start", args[0].u.int_value,
+                           INT_MESSAGE_ARGUMENT, "end", args[1].u.int_value,
+                           INT_MESSAGE_ARGUMENT, "size", size,
+                           MESSAGE_ARGUMENT_END);
+    }
+}
+
+MRSK_Value mrsk_nm_array_slice_proc(MRSK_Interpreter *interpreter,
+                                    MRSK_LocalEnvironment *env,
+                                    MRSK_Value *receiver,
+                                    int arg_count, MRSK_Value *args,
+                                    int line_number)
+{
+    MRSK_Value value;
+
+    check_slice_range(args, receiver->u.object->u.array.size, line_number);
+    value.type = MRSK_ARRAY_VALUE;
+    value.u.object = mrsk_array_slice(interpreter, receiver->u.object,
+                                      args[0].u.int_value,
+                                      args[1].u.int_value);
+
+    return value;
+}
+
+MRSK_Value mrsk_nm_string_length_proc(MRSK_Interpreter *interpreter,
+                                      MRSK_LocalEnvironment *env,
+                                      MRSK_Value *receiver,
+                                      int arg_count, MRSK_Value *args,
+                                      int line_number)
+{
+    MRSK_Value value;
+
+    value.type = MRSK_INT_VALUE;
+    value.u.int_value = receiver->u.object->u.string.length;
+
+    return value;
+}
+
+MRSK_Value mrsk_nm_string_slice_proc(MRSK_Interpreter *interpreter,
+                                     MRSK_LocalEnvironment *env,
+                                     MRSK_Value *receiver,
+                                     int arg_count, MRSK_Value *args,
+                                     int line_number)
+{
+    MRSK_Value value;
+
+    check_slice_range(args, receiver->u.object->u.string.length,
+                      line_number);
+    value.type = MRSK_STRING_VALUE;
+    value.u.object = mrsk_string_slice(interpreter, receiver->u.object,
+                                       args[0].u.int_value,
+                                       args[1].u.int_value);
 
     return value;
 }
@@ -161,45 +333,90 @@ void mrsk_add_std_fp(MRSK_Interpreter *inter)
 
 }
 
-MRSK_Value new_array_sub(MRSK_Interpreter *inter, MRSK_LocalEnvironment *env,
-                         int arg_count, MRSK_Value *args, int arg_idx)
+/*
+ * new_array(n) makes an array of n None; new_array(n, m, ...) makes one
+ * contiguous multi dimensional array rather than an array of arrays.
+ * Element offsets are ints, so the sizes' product has to fit in one;
+ * it is taken in a double so that it can't overflow on the way.
+ */
+MRSK_Value mrsk_nv_new_array_proc(MRSK_Interpreter *interpreter, MRSK_LocalEnvironment *env,
+                                  int arg_count, MRSK_Value *args)
 {
-    MRSK_Value ret;
-    int size;
+    MRSK_Value value;
+    double total = 1.0;
+    int *dim;
     int i;
 
-    if (args[arg_idx].type != MRSK_INT_VALUE) {
-        mrsk_runtime_error(0, NEW_ARRAY_ARGUMENT_TYPE_ERR, MESSAGE_ARGUMENT_END);
+    if (arg_count < 1) {
+        mrsk_runtime_error(0, ARGUMENT_TOO_FEW_ERR, MESSAGE_ARGUMENT_END);
     }
-
-    size = args[arg_idx].u.int_value;
-
-    ret.type = MRSK_ARRAY_VALUE;
-    ret.u.object = MRSK_create_array(inter, env, size);
-
-    if (arg_idx == arg_count-1) {
-        for (i=0; i<size; i++) {
-            ret.u.object->u.array.array[i].type = MRSK_NONE_VALUE;
+    for (i = 0; i < arg_count; i++) {
+        if (args[i].type != MRSK_INT_VALUE || args[i].u.int_value < 0) {
+            mrsk_runtime_error(0, NEW_ARRAY_ARGUMENT_TYPE_ERR,
+                               MESSAGE_ARGUMENT_END);
         }
-    } else {
-        for (i=0; i<size; i++) {
-            ret.u.object->u.array.array[i] = new_array_sub(inter, env, arg_count, args, arg_idx+1);
+        total *= args[i].u.int_value;
+    }
+    if (total > INT_MAX) {
+        mrsk_runtime_error(0, NEW_ARRAY_ARGUMENT_TYPE_ERR,
+                           MESSAGE_ARGUMENT_END);
+    }
+
+    value.type = MRSK_ARRAY_VALUE;
+    if (arg_count == 1) {
+        value.u.object = mrsk_create_array_i(interpreter,
+                                             args[0].u.int_value);
+        for (i = 0; i < args[0].u.int_value; i++) {
+            value.u.object->u.array.array.value[i].type = MRSK_NONE_VALUE;
         }
+        return value;
+    }
+    dim = MEM_malloc(sizeof(int) * arg_count);
+    for (i = 0; i < arg_count; i++) {
+        dim[i] = args[i].u.int_value;
     }
+    value.u.object = mrsk_create_multi_array_i(interpreter, arg_count, dim);
+    MEM_free(dim);
 
-    return ret;
+    return value;
 }
 
-MRSK_Value mrsk_nv_new_array_proc(MRSK_Interpreter *interpreter, MRSK_LocalEnvironment *env,
-                                  int arg_count, MRSK_Value *args)
+static MRSK_Value new_typed_array(MRSK_Interpreter *inter,
+                                  MRSK_LocalEnvironment *env,
+                                  int arg_count, MRSK_Value *args,
+                                  ObjectType type, char *name)
 {
     MRSK_Value value;
 
     if (arg_count < 1) {
         mrsk_runtime_error(0, ARGUMENT_TOO_FEW_ERR, MESSAGE_ARGUMENT_END);
+    } else if (arg_count > 1) {
+        mrsk_runtime_error(0, ARGUMENT_TOO_MANY_ERR, MESSAGE_ARGUMENT_END);
     }
-
-    value = new_array_sub(interpreter, env, arg_count, args, 0);
+    if (args[0].type != MRSK_INT_VALUE || args[0].u.int_value < 0) {
+        mrsk_runtime_error(0, TYPED_ARRAY_ARGUMENT_ERR,
+                           STRING_MESSAGE_ARGUMENT, "name", name,
+                           MESSAGE_ARGUMENT_END);
+    }
+    value.type = MRSK_ARRAY_VALUE;
+    value.u.object = mrsk_create_typed_array_i(inter, type,
+                                               args[0].u.int_value);
 
     return value;
 }
+
+MRSK_Value mrsk_nv_int_array_proc(MRSK_Interpreter *interpreter,
+                                  MRSK_LocalEnvironment *env,
+                                  int arg_count, MRSK_Value *args)
+{
+    return new_typed_array(interpreter, env, arg_count, args,
+                           INT_ARRAY_OBJECT, "int_array");
+}
+
+MRSK_Value mrsk_nv_double_array_proc(MRSK_Interpreter *interpreter,
+                                     MRSK_LocalEnvironment *env,
+                                     int arg_count, MRSK_Value *args)
+{
+    return new_typed_array(interpreter, env, arg_count, args,
+                           DOUBLE_ARRAY_OBJECT, "double_array");
+}
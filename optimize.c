@@ -0,0 +1,560 @@
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+#include "MEM.h"
+#include "DBG.h"
+#include "murasaki.h"
+
+static void optimize_expression(Expression *expr);
+static StatementList *optimize_statement_list(StatementList *list);
+
+static MRSK_Boolean is_number_literal(Expression *expr)
+{
+    return expr->type == INT_EXPRESSION || expr->type == DOUBLE_EXPRESSION;
+}
+
+static double literal_to_double(Expression *expr)
+{
+    if (expr->type == INT_EXPRESSION) {
+        return expr->u.int_value;
+    }
+    return expr->u.double_value;
+}
+
+static void set_int_literal(Expression *expr, int value)
+{
+    expr->type = INT_EXPRESSION;
+    expr->u.int_value = value;
+}
+
+static void set_double_literal(Expression *expr, double value)
+{
+    expr->type = DOUBLE_EXPRESSION;
+    expr->u.double_value = value;
+}
+
+static void set_boolean_literal(Expression *expr, MRSK_Boolean value)
+{
+    expr->type = BOOLEAN_EXPRESSION;
+    expr->u.boolean_value = value;
+}
+
+/* Replaces expr by its operand, keeping expr's line number. */
+static void replace_expression(Expression *expr, Expression *operand)
+{
+    int line_number = expr->line_number;
+
+    *expr = *operand;
+    expr->line_number = line_number;
+}
+
+static MRSK_Boolean fold_int(Expression *expr, int left, int right)
+{
+    ExpressionType operator = expr->type;
+
+    /* left to the run time, where they are errors or traps as before */
+    if ((operator == DIV_EXPRESSION || operator == MOD_EXPRESSION)
+        && (right == 0 || (left == INT_MIN && right == -1))) {
+        return MRSK_FALSE;
+    }
+    if (operator == ADD_EXPRESSION) {
+        set_int_literal(expr, left + right);
+    } else if (operator == SUB_EXPRESSION) {
+        set_int_literal(expr, left - right);
+    } else if (operator == MUL_EXPRESSION) {
+        set_int_literal(expr, left * right);
+    } else if (operator == DIV_EXPRESSION) {
+        set_int_literal(expr, left / right);
+    } else if (operator == MOD_EXPRESSION) {
+        set_int_literal(expr, left % right);
+    } else if (operator == EQ_EXPRESSION) {
+        set_boolean_literal(expr, left == right);
+    } else if (operator == NE_EXPRESSION) {
+        set_boolean_literal(expr, left != right);
+    } else if (operator == GT_EXPRESSION) {
+        set_boolean_literal(expr, left > right);
+    } else if (operator == GE_EXPRESSION) {
+        set_boolean_literal(expr, left >= right);
+    } else if (operator == LT_EXPRESSION) {
+        set_boolean_literal(expr, left < right);
+    } else if (operator == LE_EXPRESSION) {
+        set_boolean_literal(expr, left <= right);
+    } else {
+        return MRSK_FALSE;
+    }
+    return MRSK_TRUE;
+}
+
+static MRSK_Boolean fold_double(Expression *expr, double left, double right)
+{
+    ExpressionType operator = expr->type;
+
+    if (operator == ADD_EXPRESSION) {
+        set_double_literal(expr, left + right);
+    } else if (operator == SUB_EXPRESSION) {
+        set_double_literal(expr, left - right);
+    } else if (operator == MUL_EXPRESSION) {
+        set_double_literal(expr, left * right);
+    } else if (operator == DIV_EXPRESSION) {
+        set_double_literal(expr, left / right);
+    } else if (operator == MOD_EXPRESSION) {
+        set_double_literal(expr, fmod(left, right));
+    } else if (operator == EQ_EXPRESSION) {
+        set_boolean_literal(expr, left == right);
+    } else if (operator == NE_EXPRESSION) {
+        set_boolean_literal(expr, left != right);
+    } else if (operator == GT_EXPRESSION) {
+        set_boolean_literal(expr, left > right);
+    } else if (operator == GE_EXPRESSION) {
+        set_boolean_literal(expr, left >= right);
+    } else if (operator == LT_EXPRESSION) {
+        set_boolean_literal(expr, left < right);
+    } else if (operator == LE_EXPRESSION) {
+        set_boolean_literal(expr, left <= right);
+    } else {
+        return MRSK_FALSE;
+    }
+    return MRSK_TRUE;
+}
+
+static MRSK_Boolean fold_string_compare(Expression *expr,
+                                        char *left, char *right)
+{
+    ExpressionType operator = expr->type;
+    int cmp = strcmp(left, right);
+
+    if (operator == EQ_EXPRESSION) {
+        set_boolean_literal(expr, cmp == 0);
+    } else if (operator == NE_EXPRESSION) {
+        set_boolean_literal(expr, cmp != 0);
+    } else if (operator == GT_EXPRESSION) {
+        set_boolean_literal(expr, cmp > 0);
+    } else if (operator == GE_EXPRESSION) {
+        set_boolean_literal(expr, cmp >= 0);
+    } else if (operator == LT_EXPRESSION) {
+        set_boolean_literal(expr, cmp < 0);
+    } else if (operator == LE_EXPRESSION) {
+        set_boolean_literal(expr, cmp <= 0);
+    } else {
+        return MRSK_FALSE;
+    }
+    return MRSK_TRUE;
+}
+
+/*
+ * "str" + literal.  The right operand is converted exactly as
+ * chain_string() would do it at run time.
+ */
+static MRSK_Boolean fold_string_concatenation(Expression *expr,
+                                              char *left, Expression *right)
+{
+    MRSK_Value v;
+    char *right_str;
+    char *str;
+
+    if (right->type == STRING_EXPRESSION) {
+        right_str = right->u.string_expression.string;
+    } else {
+        if (right->type == INT_EXPRESSION) {
+            v.type = MRSK_INT_VALUE;
+            v.u.int_value = right->u.int_value;
+        } else if (right->type == DOUBLE_EXPRESSION) {
+            v.type = MRSK_DOUBLE_VALUE;
+            v.u.double_value = right->u.double_value;
+        } else if (right->type == BOOLEAN_EXPRESSION) {
+            v.type = MRSK_BOOLEAN_VALUE;
+            v.u.boolean_value = right->u.boolean_value;
+        } else {
+            return MRSK_FALSE;
+        }
+        right_str = MRSK_value_to_string(&v);
+    }
+    str = MEM_malloc(strlen(left) + strlen(right_str) + 1);
+    strcpy(str, left);
+    strcat(str, right_str);
+    if (right->type != STRING_EXPRESSION) {
+        MEM_free(right_str);
+    }
+    expr->type = STRING_EXPRESSION;
+    expr->u.string_expression.string
+        = mrsk_intern_string(mrsk_get_current_interpreter(), str);
+    MEM_free(str);
+
+    return MRSK_TRUE;
+}
+
+/*
+ * Folds only the operand combinations that cannot fail at run time, so
+ * every error still comes from the same line when the program runs.
+ */
+static MRSK_Boolean fold_binary_expression(Expression *expr)
+{
+    Expression *left = expr->u.binary_expression.left;
+    Expression *right = expr->u.binary_expression.right;
+
+    if (left->type == INT_EXPRESSION && right->type == INT_EXPRESSION) {
+        return fold_int(expr, left->u.int_value, right->u.int_value);
+    } else if (is_number_literal(left) && is_number_literal(right)) {
+        return fold_double(expr, literal_to_double(left),
+                           literal_to_double(right));
+    } else if (left->type == BOOLEAN_EXPRESSION
+               && right->type == BOOLEAN_EXPRESSION) {
+        if (expr->type == EQ_EXPRESSION) {
+            set_boolean_literal(expr, left->u.boolean_value
+                                == right->u.boolean_value);
+            return MRSK_TRUE;
+        } else if (expr->type == NE_EXPRESSION) {
+            set_boolean_literal(expr, left->u.boolean_value
+                                != right->u.boolean_value);
+            return MRSK_TRUE;
+        }
+    } else if (left->type == STRING_EXPRESSION
+               && expr->type == ADD_EXPRESSION) {
+        return fold_string_concatenation(expr, left->u.string_expression.string,
+                                         right);
+    } else if (left->type == STRING_EXPRESSION
+               && right->type == STRING_EXPRESSION) {
+        return fold_string_compare(expr, left->u.string_expression.string,
+                                   right->u.string_expression.string);
+    }
+    return MRSK_FALSE;
+}
+
+/*
+ * The value type an expression always has, or 0 when it depends on run
+ * time values.  Only what the identities below need is tracked.
+ */
+static MRSK_ValueType static_type(Expression *expr)
+{
+    MRSK_ValueType left;
+    MRSK_ValueType right;
+
+    if (expr->type == INT_EXPRESSION) {
+        return MRSK_INT_VALUE;
+    } else if (expr->type == DOUBLE_EXPRESSION) {
+        return MRSK_DOUBLE_VALUE;
+    } else if (dkc_is_math_operator(expr->type)) {
+        left = static_type(expr->u.binary_expression.left);
+        right = static_type(expr->u.binary_expression.right);
+        if (left == MRSK_INT_VALUE && right == MRSK_INT_VALUE) {
+            return MRSK_INT_VALUE;
+        }
+        if ((left == MRSK_INT_VALUE || left == MRSK_DOUBLE_VALUE)
+            && (right == MRSK_INT_VALUE || right == MRSK_DOUBLE_VALUE)) {
+            return MRSK_DOUBLE_VALUE;
+        }
+    } else if (expr->type == MINUS_EXPRESSION) {
+        return static_type(expr->u.minus_expression);
+    } else if (expr->type == ASSIGN_EXPRESSION) {
+        return static_type(expr->u.assign_expression.operand);
+    }
+    return 0;
+}
+
+static MRSK_Boolean is_int_literal_of(Expression *expr, int value)
+{
+    return expr->type == INT_EXPRESSION && expr->u.int_value == value;
+}
+
+/*
+ * x+0, 0+x, x-0, x*1, 1*x and x/1 become x when x is known to be a
+ * number.  The literal is an int so the result type is x's own.
+ */
+static void simplify_binary_expression(Expression *expr)
+{
+    Expression *left = expr->u.binary_expression.left;
+    Expression *right = expr->u.binary_expression.right;
+    MRSK_ValueType left_type = static_type(left);
+    MRSK_ValueType right_type = static_type(right);
+    MRSK_Boolean left_is_number;
+    MRSK_Boolean right_is_number;
+
+    left_is_number = (left_type == MRSK_INT_VALUE
+                      || left_type == MRSK_DOUBLE_VALUE);
+    right_is_number = (right_type == MRSK_INT_VALUE
+                       || right_type == MRSK_DOUBLE_VALUE);
+
+    if ((expr->type == ADD_EXPRESSION || expr->type == SUB_EXPRESSION)
+        && left_is_number && is_int_literal_of(right, 0)) {
+        replace_expression(expr, left);
+    } else if (expr->type == ADD_EXPRESSION
+               && right_is_number && is_int_literal_of(left, 0)) {
+        replace_expression(expr, right);
+    } else if ((expr->type == MUL_EXPRESSION || expr->type == DIV_EXPRESSION)
+               && left_is_number && is_int_literal_of(right, 1)) {
+        replace_expression(expr, left);
+    } else if (expr->type == MUL_EXPRESSION
+               && right_is_number && is_int_literal_of(left, 1)) {
+        replace_expression(expr, right);
+    }
+}
+
+/*
+ * Only a literal boolean on the left can decide the result; the right
+ * operand is folded in only when it is a boolean literal as well.
+ */
+static void fold_logical_expression(Expression *expr)
+{
+    Expression *left = expr->u.binary_expression.left;
+    Expression *right = expr->u.binary_expression.right;
+    MRSK_Boolean decided;
+
+    if (left->type != BOOLEAN_EXPRESSION) {
+        return;
+    }
+    decided = (expr->type == LOGICAL_AND_EXPRESSION) ? MRSK_FALSE : MRSK_TRUE;
+    if (left->u.boolean_value == decided) {
+        set_boolean_literal(expr, decided);
+    } else if (right->type == BOOLEAN_EXPRESSION) {
+        set_boolean_literal(expr, right->u.boolean_value);
+    }
+}
+
+static void optimize_argument_list(ArgumentList *arg_list)
+{
+    ArgumentList *pos;
+
+    for (pos = arg_list; pos; pos = pos->next) {
+        optimize_expression(pos->expression);
+    }
+}
+
+static void optimize_expression(Expression *expr)
+{
+    ExpressionList *pos;
+
+    if (expr == NULL) {
+        return;
+    }
+    switch (expr->type) {
+        case BOOLEAN_EXPRESSION:
+        case INT_EXPRESSION:
+        case DOUBLE_EXPRESSION:
+        case STRING_EXPRESSION:
+        case IDENTIFIER_EXPRESSION:
+        case NONE_EXPRESSION:
+            break;
+        case ASSIGN_EXPRESSION:
+            optimize_expression(expr->u.assign_expression.left);
+            optimize_expression(expr->u.assign_expression.operand);
+            break;
+        case ADD_EXPRESSION:
+        case SUB_EXPRESSION:
+        case MUL_EXPRESSION:
+        case DIV_EXPRESSION:
+        case MOD_EXPRESSION:
+        case EQ_EXPRESSION:
+        case NE_EXPRESSION:
+        case GT_EXPRESSION:
+        case GE_EXPRESSION:
+        case LT_EXPRESSION:
+        case LE_EXPRESSION:
+            optimize_expression(expr->u.binary_expression.left);
+            optimize_expression(expr->u.binary_expression.right);
+            if (!fold_binary_expression(expr)) {
+                simplify_binary_expression(expr);
+            }
+            break;
+        case LOGICAL_AND_EXPRESSION:
+        case LOGICAL_OR_EXPRESSION:
+            optimize_expression(expr->u.binary_expression.left);
+            optimize_expression(expr->u.binary_expression.right);
+            fold_logical_expression(expr);
+            break;
+        case MINUS_EXPRESSION:
+            optimize_expression(expr->u.minus_expression);
+            if (expr->u.minus_expression->type == INT_EXPRESSION) {
+                set_int_literal(expr, -expr->u.minus_expression->u.int_value);
+            } else if (expr->u.minus_expression->type == DOUBLE_EXPRESSION) {
+                set_double_literal(expr, -expr->u.minus_expression
+                                   ->u.double_value);
+            }
+            break;
+        case FUNCTION_CALL_EXPRESSION:
+            optimize_argument_list(expr->u.function_call_expression.argument);
+            break;
+        case METHOD_CALL_EXPRESSION:
+            optimize_expression(expr->u.method_call_expression.expression);
+            optimize_argument_list(expr->u.method_call_expression.argument);
+            break;
+        case ARRAY_EXPRESSION:
+            for (pos = expr->u.array_literal; pos; pos = pos->next) {
+                optimize_expression(pos->expression);
+            }
+            break;
+        case INDEX_EXPRESSION:
+            optimize_expression(expr->u.index_expression.array);
+            optimize_expression(expr->u.index_expression.index);
+            break;
+        case INCREMENT_EXPRESSION:
+        case DECREMENT_EXPRESSION:
+            optimize_expression(expr->u.inc_dec.operand);
+            break;
+        case MEMBER_EXPRESSION:
+            optimize_expression(expr->u.member_expression.expression);
+            break;
+        case INT_ADD_EXPRESSION:
+        case INT_SUB_EXPRESSION:
+        case INT_MUL_EXPRESSION:
+        case INT_EQ_EXPRESSION:
+        case INT_NE_EXPRESSION:
+        case INT_GT_EXPRESSION:
+        case INT_GE_EXPRESSION:
+        case INT_LT_EXPRESSION:
+        case INT_LE_EXPRESSION:
+        case EXPRESSION_TYPE_COUNT_PLUS_1:
+        default:
+            DBG_panic(("bad case. type..%d\n", expr->type));
+    }
+}
+
+static MRSK_Boolean is_boolean_literal(Expression *expr, MRSK_Boolean value)
+{
+    return expr->type == BOOLEAN_EXPRESSION
+        && expr->u.boolean_value == value;
+}
+
+static StatementList *block_statement_list(Block *block)
+{
+    return block ? block->statement_list : NULL;
+}
+
+static void optimize_block(Block *block)
+{
+    if (block) {
+        block->statement_list = optimize_statement_list(block->statement_list);
+    }
+}
+
+/*
+ * Drops the branches whose condition is the literal False and cuts the
+ * chain at the first literal True.  Returns what replaces the statement:
+ * the statement itself, the statements of the branch that is always
+ * taken, or NULL.
+ */
+static StatementList *optimize_if_statement(Statement *statement,
+                                            StatementList *self)
+{
+    IfStatement *if_s = &statement->u.if_s;
+    Elif **elif_p;
+
+    optimize_expression(if_s->condition);
+    optimize_block(if_s->then_block);
+    for (elif_p = &if_s->elif_list; *elif_p; ) {
+        optimize_expression((*elif_p)->condition);
+        optimize_block((*elif_p)->block);
+        if (is_boolean_literal((*elif_p)->condition, MRSK_FALSE)) {
+            *elif_p = (*elif_p)->next;
+        } else if (is_boolean_literal((*elif_p)->condition, MRSK_TRUE)) {
+            if_s->else_block = (*elif_p)->block;
+            *elif_p = NULL;
+        } else {
+            elif_p = &(*elif_p)->next;
+        }
+    }
+    optimize_block(if_s->else_block);
+
+    while (is_boolean_literal(if_s->condition, MRSK_FALSE)
+           && if_s->elif_list) {
+        if_s->condition = if_s->elif_list->condition;
+        if_s->then_block = if_s->elif_list->block;
+        if_s->elif_list = if_s->elif_list->next;
+    }
+    if (is_boolean_literal(if_s->condition, MRSK_TRUE)) {
+        return block_statement_list(if_s->then_block);
+    } else if (is_boolean_literal(if_s->condition, MRSK_FALSE)) {
+        return block_statement_list(if_s->else_block);
+    }
+    return self;
+}
+
+static StatementList *optimize_statement(StatementList *self)
+{
+    Statement *statement = self->statement;
+
+    switch (statement->type) {
+        case EXPRESSION_STATEMENT:
+            optimize_expression(statement->u.expression_s);
+            break;
+        case GLOBAL_STATEMENT:
+            break;
+        case IF_STATEMENT:
+            return optimize_if_statement(statement, self);
+        case WHILE_STATEMENT:
+            optimize_expression(statement->u.while_s.condition);
+            if (is_boolean_literal(statement->u.while_s.condition,
+                                   MRSK_FALSE)) {
+                return NULL;
+            }
+            optimize_block(statement->u.while_s.block);
+            break;
+        case FOR_STATEMENT:
+            optimize_expression(statement->u.for_s.init);
+            optimize_expression(statement->u.for_s.condition);
+            if (statement->u.for_s.condition
+                && is_boolean_literal(statement->u.for_s.condition,
+                                      MRSK_FALSE)) {
+                if (statement->u.for_s.init == NULL) {
+                    return NULL;
+                }
+                statement->type = EXPRESSION_STATEMENT;
+                statement->u.expression_s = statement->u.for_s.init;
+                break;
+            }
+            optimize_expression(statement->u.for_s.post);
+            optimize_block(statement->u.for_s.block);
+            break;
+        case RETURN_STATEMENT:
+            optimize_expression(statement->u.return_s.return_value);
+            break;
+        case BREAK_STATEMENT:
+        case CONTINUE_STATEMENT:
+            break;
+        case STATEMENT_TYPE_COUNT_PLUS_1:
+        default:
+            DBG_panic(("bad case...%d", statement->type));
+    }
+    return self;
+}
+
+static StatementList *optimize_statement_list(StatementList *list)
+{
+    StatementList *head = NULL;
+    StatementList **tail_p = &head;
+    StatementList *pos;
+    StatementList *next;
+    StatementList *replaced;
+
+    for (pos = list; pos; pos = next) {
+        next = pos->next;
+        replaced = optimize_statement(pos);
+        *tail_p = replaced;
+        for (; *tail_p; tail_p = &(*tail_p)->next) {
+            if (*tail_p == pos) {
+                tail_p = &pos->next;
+                break;
+            }
+        }
+    }
+    *tail_p = NULL;
+
+    return head;
+}
+
+/*
+ * Runs between parsing and mrsk_fix_tree(): folds constant
+ * subexpressions (string concatenations included, so they no longer
+ * allocate on every run), applies numeric identities, and removes
+ * branches and loops whose literal conditions can never be taken.
+ */
+void mrsk_optimize_tree(MRSK_Interpreter *inter)
+{
+    FunctionDefinition *pos;
+
+    for (pos = inter->function_list; pos; pos = pos->next) {
+        if (pos->type == MURASAKI_FUNCTION_DEFINITION) {
+            optimize_block(pos->u.murasaki_f.block);
+        }
+    }
+    inter->statement_list = optimize_statement_list(inter->statement_list);
+}
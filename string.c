@@ -36,23 +36,13 @@ void mrsk_reset_string_literal_buffer(void)
 
 char *mrsk_close_string_literal(void)
 {
-    char *new_str;
+    mrsk_add_string_literal('\0');
 
-    new_str = mrsk_malloc(st_string_literal_buffer_size + 1);
-
-    memcpy(new_str, st_string_literal_buffer, st_string_literal_buffer_size);
-    new_str[st_string_literal_buffer_size] = '\0';
-
-    return new_str;
+    return mrsk_intern_string(mrsk_get_current_interpreter(),
+                              st_string_literal_buffer);
 }
 
 char * mrsk_create_identifier(char *str)
 {
-    char *new_str;
-
-    new_str = mrsk_malloc(strlen(str) + 1);
-
-    strcpy(new_str, str);
-
-    return new_str;
+    return mrsk_intern_string(mrsk_get_current_interpreter(), str);
 }
@@ -0,0 +1,91 @@
+#include <string.h>
+#include "MEM.h"
+#include "DBG.h"
+#include "murasaki.h"
+
+#define STRING_POOL_INITIAL_SIZE    (256)
+
+unsigned int mrsk_hash_string(char *str)
+{
+    unsigned int h = 0;
+
+    for (; *str; str++) {
+        h = h * 31 + (unsigned char)*str;
+    }
+    return h;
+}
+
+static void rehash_string_pool(StringPool *pool)
+{
+    StringPoolEntry **new_bucket;
+    StringPoolEntry *pos;
+    StringPoolEntry *next;
+    int new_size;
+    unsigned int i;
+    int j;
+
+    new_size = pool->hash_size ? pool->hash_size * 2
+        : STRING_POOL_INITIAL_SIZE;
+    new_bucket = MEM_malloc(sizeof(StringPoolEntry*) * new_size);
+    for (j = 0; j < new_size; j++) {
+        new_bucket[j] = NULL;
+    }
+    for (j = 0; j < pool->hash_size; j++) {
+        for (pos = pool->bucket[j]; pos; pos = next) {
+            next = pos->next;
+            i = pos->hash & (new_size - 1);
+            pos->next = new_bucket[i];
+            new_bucket[i] = pos;
+        }
+    }
+    MEM_free(pool->bucket);
+    pool->bucket = new_bucket;
+    pool->hash_size = new_size;
+}
+
+/*
+ * Returns the canonical copy of str, which lives as long as the
+ * interpreter.  Names and literals from the lexer, and names registered
+ * by natives, all go through here, so two names are equal exactly when
+ * their pointers are.
+ */
+char * mrsk_intern_string(MRSK_Interpreter *inter, char *str)
+{
+    StringPool *pool = &inter->string_pool;
+    StringPoolEntry *pos;
+    unsigned int hash;
+    unsigned int i;
+
+    hash = mrsk_hash_string(str);
+    if (pool->hash_size > 0) {
+        for (pos = pool->bucket[hash & (pool->hash_size - 1)]; pos;
+             pos = pos->next) {
+            if (pos->hash == hash && !strcmp(pos->string, str)) {
+                return pos->string;
+            }
+        }
+    }
+    if (pool->count >= pool->hash_size) {
+        rehash_string_pool(pool);
+    }
+    pos = MEM_storage_malloc(inter->interpreter_storage,
+                             sizeof(StringPoolEntry));
+    pos->string = MEM_storage_malloc(inter->interpreter_storage,
+                                     strlen(str) + 1);
+    strcpy(pos->string, str);
+    pos->hash = hash;
+    i = hash & (pool->hash_size - 1);
+    pos->next = pool->bucket[i];
+    pool->bucket[i] = pos;
+    pool->count++;
+
+    return pos->string;
+}
+
+void mrsk_dispose_string_pool(MRSK_Interpreter *inter)
+{
+    MEM_free(inter->string_pool.bucket);
+    inter->string_pool.bucket = NULL;
+    inter->string_pool.hash_size = 0;
+    inter->string_pool.count = 0;
+}
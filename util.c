@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "MEM.h"
 #include "DBG.h"
 #include "murasaki.h"
@@ -23,13 +25,53 @@ FunctionDefinition * mrsk_search_function(char *name)
 
     inter = mrsk_get_current_interpreter();
     for (pos=inter->function_list; pos; pos=pos->next) {
-        if (!strcmp(pos->name, name)) {
+        if (pos->name == name) {
             break;
         }
     }
     return pos;
 }
 
+/*
+ * Call sites are bound by mrsk_fix_tree(), so this is only reached for
+ * names that were not defined at that time.  A function registered
+ * later is bound here on first use; otherwise it's a runtime error at
+ * the call's line.
+ */
+FunctionDefinition *
+mrsk_resolve_function_call(FunctionCallExpression *fce, int line_number)
+{
+    fce->function = mrsk_search_function(fce->identifier);
+    if (fce->function == NULL) {
+        mrsk_runtime_error(line_number, FUNCTION_NOT_FOUND_ERR,
+                           STRING_MESSAGE_ARGUMENT, "name", fce->identifier,
+                           MESSAGE_ARGUMENT_END);
+    }
+    return fce->function;
+}
+
+/*
+ * Method names are interned once, at parse time or when a method is
+ * registered, so dispatch can index MethodTable by selector.  name must
+ * come from mrsk_intern_string().
+ */
+int mrsk_intern_selector(MRSK_Interpreter *inter, char *name)
+{
+    int i;
+
+    for (i = 0; i < inter->selector_count; i++) {
+        if (inter->selector[i] == name) {
+            return i;
+        }
+    }
+    inter->selector = MEM_realloc(inter->selector,
+                                  sizeof(char*) * (inter->selector_count + 1));
+    inter->selector[inter->selector_count] = name;
+    inter->selector_count++;
+
+    return inter->selector_count - 1;
+}
+
 void * mrsk_malloc(size_t size)
 {
     void *p;
@@ -59,7 +101,7 @@ Variable * mrsk_search_local_variable(MRSK_LocalEnvironment *env, char *identifi
     }
 
     for (pos=env->variable; pos; pos=pos->next) {
-        if (!strcmp(pos->name, identifier)) {
+        if (pos->name == identifier) {
             break;
         }
     }
@@ -71,17 +113,110 @@ Variable * mrsk_search_local_variable(MRSK_LocalEnvironment *env, char *identifi
     }
 }
 
-Variable * mrsk_search_global_variable(MRSK_Interpreter *inter, char *identifier)
+#define GLOBAL_HASH_INITIAL_SIZE    (64)
+#define GLOBAL_ALLOC_SIZE           (64)
+
+/* Names are interned (see string_pool.c), so they compare by pointer. */
+static int search_global_index(GlobalVariableTable *global, char *identifier)
 {
-    Variable *pos;
+    unsigned int mask;
+    unsigned int i;
+    int index;
 
-    for (pos=inter->variable; pos; pos=pos->next) {
-        if (!strcmp(pos->name, identifier)) {
-            return pos;
+    if (global->hash_size == 0) {
+        return -1;
+    }
+    mask = global->hash_size - 1;
+    for (i = mrsk_hash_string(identifier) & mask; ; i = (i + 1) & mask) {
+        index = global->hash[i];
+        if (index < 0) {
+            return -1;
+        }
+        if (global->variable[index]->name == identifier) {
+            return index;
         }
     }
+}
 
-    return NULL;
+static void set_global_hash(GlobalVariableTable *global, int index)
+{
+    unsigned int mask = global->hash_size - 1;
+    unsigned int i;
+
+    for (i = mrsk_hash_string(global->variable[index]->name) & mask;
+         global->hash[i] >= 0; i = (i + 1) & mask)
+        ;
+    global->hash[i] = index;
+}
+
+static void rehash_global_table(GlobalVariableTable *global)
+{
+    int i;
+
+    if (global->hash_size == 0) {
+        global->hash_size = GLOBAL_HASH_INITIAL_SIZE;
+    } else {
+        global->hash_size *= 2;
+    }
+    global->hash = MEM_realloc(global->hash,
+                               sizeof(int) * global->hash_size);
+    for (i = 0; i < global->hash_size; i++) {
+        global->hash[i] = -1;
+    }
+    for (i = 0; i < global->count; i++) {
+        set_global_hash(global, i);
+    }
+}
+
+/*
+ * Returns the slot of the global named identifier, creating it if
+ * needed.  A new slot holds UNDEFINED_VALUE_TYPE until it's assigned.
+ */
+int mrsk_intern_global_variable(MRSK_Interpreter *inter, char *identifier)
+{
+    GlobalVariableTable *global = &inter->global;
+    Variable *new_variable;
+    int index;
+
+    index = search_global_index(global, identifier);
+    if (index >= 0) {
+        return index;
+    }
+    if (global->alloc_size < global->count + 1) {
+        global->alloc_size += GLOBAL_ALLOC_SIZE;
+        global->variable = MEM_realloc(global->variable,
+                                       sizeof(Variable*)
+                                       * global->alloc_size);
+    }
+    new_variable = MEM_storage_malloc(inter->interpreter_storage,
+                                      sizeof(Variable));
+    new_variable->name = identifier;
+    new_variable->value.type = UNDEFINED_VALUE_TYPE;
+    new_variable->next = NULL;
+    index = global->count;
+    global->variable[index] = new_variable;
+    global->count++;
+
+    if (global->count * 2 > global->hash_size) {
+        rehash_global_table(global);
+    } else {
+        set_global_hash(global, index);
+    }
+
+    return index;
+}
+
+Variable * mrsk_search_global_variable(MRSK_Interpreter *inter, char *identifier)
+{
+    int index;
+
+    index = search_global_index(&inter->global, identifier);
+    if (index < 0
+        || inter->global.variable[index]->value.type == UNDEFINED_VALUE_TYPE) {
+        return NULL;
+    }
+
+    return inter->global.variable[index];
 }
 
 Variable * mrsk_add_local_variable(MRSK_LocalEnvironment *env, char *identifier)
@@ -98,22 +233,20 @@ Variable * mrsk_add_local_variable(MRSK_LocalEnvironment *env, char *identifier)
 
 Variable * mrsk_add_global_variable(MRSK_Interpreter *inter, char *identifier)
 {
-    Variable *new_variable;
+    int index;
 
-    new_variable = mrsk_execute_malloc(inter, sizeof(Variable));
-    new_variable->name = mrsk_execute_malloc(inter, strlen(identifier)+1);
-    strcpy(new_variable->name, identifier);
-    new_variable->next = inter->variable;
-    inter->variable = new_variable;
+    index = mrsk_intern_global_variable(inter, identifier);
 
-    return new_variable;
+    return inter->global.variable[index];
 }
 
 void MRSK_add_global_variable(MRSK_Interpreter *inter, char *identifier, MRSK_Value *value)
 {
     Variable *new_variable;
 
-    new_variable = mrsk_add_global_variable(inter, identifier);
+    new_variable = mrsk_add_global_variable(inter,
+                                            mrsk_intern_string(inter,
+                                                               identifier));
     new_variable->value = *value;
 
 }
@@ -155,16 +288,16 @@ char * mrsk_get_operator_string(ExpressionType type)
             str = "!=";
             break;
         case GT_EXPRESSION:
-            str = "<";
+            str = ">";
             break;
         case GE_EXPRESSION:
-            str = "<=";
+            str = ">=";
             break;
         case LT_EXPRESSION:
-            str = ">";
+            str = "<";
             break;
         case LE_EXPRESSION:
-            str = ">=";
+            str = "<=";
             break;
         case LOGICAL_AND_EXPRESSION:
             str = "and";
@@ -182,6 +315,16 @@ char * mrsk_get_operator_string(ExpressionType type)
         case INDEX_EXPRESSION:  /* FALLTHRU */
         case INCREMENT_EXPRESSION:  /* FALLTHRU */
         case DECREMENT_EXPRESSION:  /* FALLTHRU */
+        case MEMBER_EXPRESSION:  /* FALLTHRU */
+        case INT_ADD_EXPRESSION:  /* FALLTHRU */
+        case INT_SUB_EXPRESSION:  /* FALLTHRU */
+        case INT_MUL_EXPRESSION:  /* FALLTHRU */
+        case INT_EQ_EXPRESSION:  /* FALLTHRU */
+        case INT_NE_EXPRESSION:  /* FALLTHRU */
+        case INT_GT_EXPRESSION:  /* FALLTHRU */
+        case INT_GE_EXPRESSION:  /* FALLTHRU */
+        case INT_LT_EXPRESSION:  /* FALLTHRU */
+        case INT_LE_EXPRESSION:  /* FALLTHRU */
         case EXPRESSION_TYPE_COUNT_PLUS_1:
         default:
             DBG_panic(("bad expression type..%d\n", type));
@@ -193,86 +336,306 @@ char * mrsk_get_operator_string(ExpressionType type)
 void mrsk_vstr_clear(VString *v)
 {
     v->string = NULL;
+    v->length = 0;
+    v->alloc_size = 0;
 }
 
-static int my_strlen(char *str)
+/* Makes room for length more characters and the terminating '\0'. */
+static void vstr_reserve(VString *v, int length)
 {
-    if (str == NULL) {
-        return 0;
+    int new_size;
+
+    if (v->length + length + 1 <= v->alloc_size) {
+        return;
+    }
+    new_size = v->alloc_size ? v->alloc_size * 2 : VSTRING_ALLOC_SIZE;
+    while (new_size < v->length + length + 1) {
+        new_size *= 2;
     }
-    return strlen(str);
+    v->string = MEM_realloc(v->string, new_size);
+    v->alloc_size = new_size;
 }
 
-void mrsk_vstr_append_string(VString *v, char *str)
+void mrsk_vstr_append_n(VString *v, char *str, int length)
 {
-    int new_size;
-    int old_len;
+    vstr_reserve(v, length);
+    memcpy(&v->string[v->length], str, length);
+    v->length += length;
+    v->string[v->length] = '\0';
+}
 
-    old_len = my_strlen(v->string);
-    new_size = old_len + strlen(str) + 1;
-    v->string = MEM_realloc(v->string, new_size);
-    strcpy(&v->string[old_len], str);
+void mrsk_vstr_append_string(VString *v, char *str)
+{
+    mrsk_vstr_append_n(v, str, strlen(str));
 }
 
 void mrsk_vstr_append_character(VString *v, int ch)
 {
-    int current_len;
+    vstr_reserve(v, 1);
+    v->string[v->length] = ch;
+    v->length++;
+    v->string[v->length] = '\0';
+}
 
-    current_len = my_strlen(v->string);
-    v->string = MEM_realloc(v->string, current_len + 2);
-    v->string[current_len] = ch;
-    v->string[current_len+1] = '\0';
+/*
+ * Writes the decimal form of value to buf, which needs
+ * NUMBER_FORMAT_BUF_SIZE bytes, and returns its length.
+ */
+int mrsk_format_int(char *buf, int value)
+{
+    char digit[NUMBER_FORMAT_BUF_SIZE];
+    unsigned int u;
+    int len = 0;
+    int i = 0;
+
+    if (value < 0) {
+        buf[len++] = '-';
+        u = -(unsigned int)value;
+    } else {
+        u = value;
+    }
+    do {
+        digit[i++] = '0' + u % 10;
+        u /= 10;
+    } while (u > 0);
+    while (i > 0) {
+        buf[len++] = digit[--i];
+    }
+    buf[len] = '\0';
+
+    return len;
 }
 
-char * MRSK_value_to_string(MRSK_Value *value)
+#define EXACT_DOUBLE_DIGITS     (15)
+#define EXACT_DOUBLE_LIMIT      (1e15)
+#define EXACT_DOUBLE_MIN        (1e-4)
+
+/*
+ * Fast path for values with a short exact decimal form, such as 12.25:
+ * the smallest scale = 10^k that makes value * scale a whole number
+ * below 10^15 that divides back to value.  Both factors are exact
+ * doubles, so that decimal reads back as value.  The product may only
+ * come out whole at a k past the shortest one (4.35 * 100 is
+ * 434.99999999999994), so trailing zeros are dropped; no other decimal
+ * of 15 digits or fewer reads back as the same double.  Returns -1 if
+ * there's no such k, or if %g would use an exponent for value.
+ */
+static int format_short_double(char *buf, double value)
+{
+    char digit[NUMBER_FORMAT_BUF_SIZE];
+    double abs_value = value < 0 ? -value : value;
+    double scale = 1.0;
+    double scaled;
+    double n;
+    int frac_digits;
+    int len = 0;
+    int i = 0;
+
+    if (abs_value != 0.0 && abs_value < EXACT_DOUBLE_MIN) {
+        return -1;
+    }
+    for (frac_digits = 0; frac_digits <= EXACT_DOUBLE_DIGITS; frac_digits++) {
+        scaled = abs_value * scale;
+        if (scaled >= EXACT_DOUBLE_LIMIT) {
+            return -1;
+        }
+        n = floor(scaled);
+        if (n == scaled && n / scale == abs_value) {
+            break;
+        }
+        scale *= 10.0;
+    }
+    if (frac_digits > EXACT_DOUBLE_DIGITS) {
+        return -1;
+    }
+    while (frac_digits > 0 && fmod(n, 10.0) == 0.0) {
+        n /= 10.0;
+        frac_digits--;
+    }
+    do {
+        digit[i++] = '0' + (int)fmod(n, 10.0);
+        n = floor(n / 10.0);
+    } while (n > 0 || i <= frac_digits);
+    /* -0.0 compares equal to 0.0; only its reciprocal tells */
+    if (value < 0 || (value == 0.0 && 1.0 / value < 0)) {
+        buf[len++] = '-';
+    }
+    while (i > 0) {
+        if (i == frac_digits) {
+            buf[len++] = '.';
+        }
+        buf[len++] = digit[--i];
+    }
+    if (frac_digits == 0) {
+        buf[len++] = '.';
+        buf[len++] = '0';
+    }
+    buf[len] = '\0';
+
+    return len;
+}
+
+/*
+ * Otherwise the shortest of %.15g, %.16g and %.17g that reads back as
+ * the same double.  A ".0" keeps whole numbers distinguishable from
+ * ints.
+ */
+int mrsk_format_double(char *buf, double value)
+{
+    int precision;
+    int len;
+
+    len = format_short_double(buf, value);
+    if (len >= 0) {
+        return len;
+    }
+    for (precision = 15; ; precision++) {
+        len = sprintf(buf, "%.*g", precision, value);
+        if (precision == 17 || strtod(buf, NULL) == value) {
+            break;
+        }
+    }
+    if (strspn(buf, "-0123456789") == (size_t)len) {
+        strcpy(&buf[len], ".0");
+        len += 2;
+    }
+    return len;
+}
+
+static void append_value(VString *v, MRSK_Value *value);
+
+/* Prints a multi dimensional array as nested arrays. */
+static void append_multi_array(VString *v, MRSK_MultiArray *multi,
+                               int dim_index, MRSK_Value *element)
 {
-    VString vstr;
-    char buf[LINE_BUF_SIZE];
     int i;
 
-    mrsk_vstr_clear(&vstr);
+    mrsk_vstr_append_character(v, '(');
+    for (i = 0; i < multi->dim[dim_index]; i++) {
+        if (i > 0) {
+            mrsk_vstr_append_string(v, ", ");
+        }
+        if (dim_index == multi->rank - 1) {
+            append_value(v, &element[i]);
+        } else {
+            append_multi_array(v, multi, dim_index + 1,
+                               element + i * multi->stride[dim_index]);
+        }
+    }
+    mrsk_vstr_append_character(v, ')');
+}
+
+/* {key: value, ...} in table order. */
+static void append_map(VString *v, MRSK_Map *map)
+{
+    int i;
+    MRSK_Boolean first = MRSK_TRUE;
+
+    mrsk_vstr_append_character(v, '{');
+    for (i = 0; i < map->capacity; i++) {
+        if (map->entry[i].distance == 0) {
+            continue;
+        }
+        if (!first) {
+            mrsk_vstr_append_string(v, ", ");
+        }
+        append_value(v, &map->entry[i].key);
+        mrsk_vstr_append_string(v, ": ");
+        append_value(v, &map->entry[i].value);
+        first = MRSK_FALSE;
+    }
+    mrsk_vstr_append_character(v, '}');
+}
+
+/* Name(field, ...), as the record would be made. */
+static void append_record(VString *v, MRSK_Record *record)
+{
+    int i;
+
+    mrsk_vstr_append_string(v, record->shape->name);
+    mrsk_vstr_append_character(v, '(');
+    for (i = 0; i < record->shape->field_count; i++) {
+        if (i > 0) {
+            mrsk_vstr_append_string(v, ", ");
+        }
+        append_value(v, &record->field[i]);
+    }
+    mrsk_vstr_append_character(v, ')');
+}
 
-    switch(value->type) {
+static void append_value(VString *v, MRSK_Value *value)
+{
+    char buf[NUMBER_FORMAT_BUF_SIZE];
+    MRSK_Object *array;
+    MRSK_Value element;
+    int i;
+
+    switch (value->type) {
         case MRSK_BOOLEAN_VALUE:
             if (value->u.boolean_value) {
-                mrsk_vstr_append_string(&vstr, "true");
+                mrsk_vstr_append_string(v, "true");
             } else {
-                mrsk_vstr_append_string(&vstr, "false");
+                mrsk_vstr_append_string(v, "false");
             }
             break;
         case MRSK_INT_VALUE:
-            sprintf(buf, "%d", value->u.int_value);
-            mrsk_vstr_append_string(&vstr, buf);
+            mrsk_vstr_append_n(v, buf,
+                               mrsk_format_int(buf, value->u.int_value));
             break;
         case MRSK_DOUBLE_VALUE:
-            sprintf(buf, "%f", value->u.double_value);
-            mrsk_vstr_append_string(&vstr, buf);
+            mrsk_vstr_append_n(v, buf,
+                               mrsk_format_double(buf,
+                                                  value->u.double_value));
             break;
         case MRSK_STRING_VALUE:
-            mrsk_vstr_append_string(&vstr, value->u.object->u.string.string);
+            mrsk_vstr_append_n(v, value->u.object->u.string.string,
+                               value->u.object->u.string.length);
             break;
         case MRSK_NATIVE_POINTER_VALUE:
             sprintf(buf, "(%s:%p)",
                     value->u.native_pointer.info->name,
                     value->u.native_pointer.pointer);
-            mrsk_vstr_append_string(&vstr, buf);
+            mrsk_vstr_append_string(v, buf);
             break;
         case MRSK_NONE_VALUE:
-            mrsk_vstr_append_string(&vstr, "(");
-            for (i=0; i<value->u.object->u.array.size; i++) {
-                char *new_str;
+            mrsk_vstr_append_string(v, "None");
+            break;
+        case MRSK_ARRAY_VALUE:
+            array = value->u.object;
+            if (array->type == MULTI_ARRAY_OBJECT) {
+                append_multi_array(v, &array->u.multi_array, 0,
+                                   array->u.multi_array.element);
+                break;
+            }
+            mrsk_vstr_append_character(v, '(');
+            for (i = 0; i < array->u.array.size; i++) {
                 if (i > 0) {
-                    mrsk_vstr_append_string(&vstr, ", ");
+                    mrsk_vstr_append_string(v, ", ");
                 }
-                new_str = MRSK_value_to_string(&value->u.object->u.array.array[i]);
-                mrsk_vstr_append_string(&vstr, new_str);
-                MEM_free(new_str);
+                element = mrsk_fetch_array_element(array, i);
+                append_value(v, &element);
             }
-            mrsk_vstr_append_string(&vstr, ")");
+            mrsk_vstr_append_character(v, ')');
+            break;
+        case MRSK_MAP_VALUE:
+            append_map(v, &value->u.object->u.map);
+            break;
+        case MRSK_RECORD_VALUE:
+            append_record(v, &value->u.object->u.record);
             break;
         default:
             DBG_panic(("value-type..%d\n", value->type));
-        }
+    }
+}
+
+/* Arrays are formatted element by element into the same VString. */
+char * MRSK_value_to_string(MRSK_Value *value)
+{
+    VString vstr;
+
+    mrsk_vstr_clear(&vstr);
+    vstr_reserve(&vstr, 0);
+    append_value(&vstr, value);
 
-        return vstr.string;
+    return vstr.string;
 }
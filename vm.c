@@ -0,0 +1,590 @@
+#include "MEM.h"
+#include "DBG.h"
+#include "murasaki.h"
+
+#define STK(inter, sp) \
+    ((inter)->stack.stack[(inter)->stack.stack_pointer+(sp)])
+#define STI(inter, sp) (STK(inter, sp).u.int_value)
+#define STD(inter, sp) (STK(inter, sp).u.double_value)
+#define STB(inter, sp) (STK(inter, sp).u.boolean_value)
+
+static void expand_stack(MRSK_Interpreter *inter, int need_stack_size)
+{
+    int revalue_up_size;
+
+    if (inter->stack.stack_pointer + need_stack_size
+        <= inter->stack.stack_alloc_size) {
+        return;
+    }
+    revalue_up_size = inter->stack.stack_pointer + need_stack_size
+        + STACK_ALLOC_SIZE;
+    inter->stack.stack = MEM_realloc(inter->stack.stack,
+                                     sizeof(MRSK_Value) * revalue_up_size);
+    inter->stack.stack_alloc_size = revalue_up_size;
+}
+
+/* The table is in start_pc order. */
+static int get_line_number(Executable *exe, int pc)
+{
+    int low = 0;
+    int high = exe->line_number_size;
+    int mid;
+
+    /* the last entry starting at or before pc */
+    while (high - low > 1) {
+        mid = (low + high) / 2;
+        if (exe->line_number[mid].start_pc <= pc) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < exe->line_number_size
+        && pc >= exe->line_number[low].start_pc
+        && pc < exe->line_number[low].start_pc
+        + exe->line_number[low].pc_count) {
+        return exe->line_number[low].line_number;
+    }
+    return 0;
+}
+
+/*
+ * Helpers that want a line number only to report an error are given
+ * the pc instead, as VM_LOCATION(pc), so that the table is searched
+ * only if the error happens.  The pc is in inter->current_executable:
+ * such a helper never runs murasaki code before it reports.
+ */
+#define VM_LOCATION(pc)     (-(pc) - 1)
+
+int mrsk_resolve_line_number(MRSK_Interpreter *inter, int line_number)
+{
+    if (line_number >= 0) {
+        return line_number;
+    }
+    if (inter->current_executable == NULL) {
+        return 0;
+    }
+    return get_line_number(inter->current_executable, -line_number - 1);
+}
+
+static void binary_operation(MRSK_Interpreter *inter, int pc,
+                             ExpressionType operator)
+{
+    MRSK_Value result;
+
+    mrsk_binary_operation(inter, operator, &STK(inter, -2), &STK(inter, -1),
+                          &result, VM_LOCATION(pc));
+    STK(inter, -2) = result;
+    inter->stack.stack_pointer--;
+}
+
+static void check_boolean(Executable *exe, int pc, MRSK_Value *value)
+{
+    if (value->type != MRSK_BOOLEAN_VALUE) {
+        mrsk_runtime_error(get_line_number(exe, pc), NOT_BOOLEAN_TYPE_ERR,
+                           MESSAGE_ARGUMENT_END);
+    }
+}
+
+static void push_variable(MRSK_Interpreter *inter, MRSK_LocalEnvironment *env,
+                          Executable *exe, int pc, char *identifier)
+{
+    Variable *vp;
+
+    vp = mrsk_search_variable(inter, env, identifier);
+    if (vp == NULL) {
+        mrsk_runtime_error(get_line_number(exe, pc), VARIABLE_NOT_FOUND_ERR,
+                           STRING_MESSAGE_ARGUMENT, "name", identifier,
+                           MESSAGE_ARGUMENT_END);
+    }
+    STK(inter, 0) = vp->value;
+    inter->stack.stack_pointer++;
+}
+
+static void push_local(MRSK_Interpreter *inter, MRSK_LocalEnvironment *env,
+                       Executable *exe, int pc, int index)
+{
+    if (env->frame[index].type == UNDEFINED_VALUE_TYPE) {
+        mrsk_runtime_error(get_line_number(exe, pc), VARIABLE_NOT_FOUND_ERR,
+                           STRING_MESSAGE_ARGUMENT, "name",
+                           exe->local_variable[index],
+                           MESSAGE_ARGUMENT_END);
+    }
+    STK(inter, 0) = env->frame[index];
+    inter->stack.stack_pointer++;
+}
+
+static void push_global(MRSK_Interpreter *inter, Executable *exe, int pc,
+                        int index)
+{
+    Variable *vp = inter->global.variable[index];
+
+    if (vp->value.type == UNDEFINED_VALUE_TYPE) {
+        mrsk_runtime_error(get_line_number(exe, pc), VARIABLE_NOT_FOUND_ERR,
+                           STRING_MESSAGE_ARGUMENT, "name", vp->name,
+                           MESSAGE_ARGUMENT_END);
+    }
+    STK(inter, 0) = vp->value;
+    inter->stack.stack_pointer++;
+}
+
+static void inc_dec(Executable *exe, int pc, MRSK_Value *operand,
+                    MRSK_Value *result, int increment)
+{
+    if (operand->type != MRSK_INT_VALUE) {
+        mrsk_runtime_error(get_line_number(exe, pc), INC_DEC_OPERAND_TYPE_ERR,
+                           MESSAGE_ARGUMENT_END);
+    }
+    result->type = MRSK_INT_VALUE;
+    result->u.int_value = operand->u.int_value;
+    operand->u.int_value += increment;
+}
+
+static void create_array(MRSK_Interpreter *inter, int size)
+{
+    MRSK_Object *array;
+    int i;
+
+    array = mrsk_create_array_i(inter, size);
+    for (i = 0; i < size; i++) {
+        array->u.array.array.value[i] = STK(inter, -size+i);
+    }
+    inter->stack.stack_pointer -= size;
+    STK(inter, 0).type = MRSK_ARRAY_VALUE;
+    STK(inter, 0).u.object = array;
+    inter->stack.stack_pointer++;
+}
+
+/*
+ * The field named by the operands of the *_FIELD_OP at pc.  The usual
+ * case, where the slot guess holds, is done here so that the line
+ * number is only looked up for the others.
+ */
+static MRSK_Value *get_field(Executable *exe, int pc, MRSK_Value *record)
+{
+    char *name = exe->constant[exe->code[pc+1]].u.identifier;
+    int slot = exe->code[pc+2];
+    RecordShape *shape;
+
+    if (record->type == MRSK_RECORD_VALUE) {
+        shape = record->u.object->u.record.shape;
+        if (slot >= 0 && slot < shape->field_count
+            && shape->field[slot] == name) {
+            return &record->u.object->u.record.field[slot];
+        }
+    }
+    return mrsk_get_field(record, name, slot, VM_LOCATION(pc));
+}
+
+static MRSK_Value call_murasaki_function(MRSK_Interpreter *inter,
+                                         MRSK_LocalEnvironment *env,
+                                         FunctionDefinition *func,
+                                         int arg_count, int line_number)
+{
+    int i;
+
+    if (arg_count > func->u.murasaki_f.parameter_count) {
+        mrsk_runtime_error(line_number, ARGUMENT_TOO_MANY_ERR,
+                           MESSAGE_ARGUMENT_END);
+    } else if (arg_count < func->u.murasaki_f.parameter_count) {
+        mrsk_runtime_error(line_number, ARGUMENT_TOO_FEW_ERR,
+                           MESSAGE_ARGUMENT_END);
+    }
+    for (i = 0; i < arg_count; i++) {
+        env->frame[i] = STK(inter, -arg_count+i);
+    }
+    inter->stack.stack_pointer -= arg_count;
+
+    return mrsk_vm_execute(inter, env, func->u.murasaki_f.executable);
+}
+
+static void call_function(MRSK_Interpreter *inter, int pc,
+                          FunctionCallExpression *fce, int arg_count)
+{
+    FunctionDefinition *func;
+    MRSK_LocalEnvironment *local_env;
+    MRSK_Value value;
+
+    func = fce->function;
+    if (func == NULL) {
+        func = mrsk_resolve_function_call(fce, VM_LOCATION(pc));
+    }
+
+    if (func->type == MURASAKI_FUNCTION_DEFINITION) {
+        local_env = mrsk_alloc_local_environment(inter,
+                                                 func->u.murasaki_f
+                                                 .local_variable_count);
+    } else {
+        local_env = mrsk_alloc_local_environment(inter, 0);
+    }
+
+    switch (func->type) {
+        case MURASAKI_FUNCTION_DEFINITION:
+            value = call_murasaki_function(inter, local_env, func, arg_count,
+                                           VM_LOCATION(pc));
+            break;
+        case NATIVE_FUNCTION_DEFINITION:
+            value = func->u.native_f.proc(inter, local_env, arg_count,
+                                          &STK(inter, -arg_count));
+            inter->stack.stack_pointer -= arg_count;
+            break;
+        case RECORD_DEFINITION:
+            value = mrsk_construct_record(inter, &func->u.record_f.shape,
+                                          arg_count, &STK(inter, -arg_count),
+                                          VM_LOCATION(pc));
+            inter->stack.stack_pointer -= arg_count;
+            break;
+        case FUNCTION_DEFINITION_TYPE_COUNT_PLUS_1:
+        default:
+            DBG_panic(("bad case..%d\n", func->type));
+    }
+    mrsk_dispose_local_environment(inter);
+
+    STK(inter, 0) = value;
+    inter->stack.stack_pointer++;
+}
+
+/* Native methods are given the line number itself, not VM_LOCATION(). */
+static void invoke_method(MRSK_Interpreter *inter, Executable *exe, int pc,
+                          int selector, int arg_count)
+{
+    MRSK_Value result;
+
+    result = mrsk_invoke_method(inter, &STK(inter, -arg_count-1),
+                                selector, arg_count,
+                                &STK(inter, -arg_count),
+                                get_line_number(exe, pc));
+    inter->stack.stack_pointer -= arg_count;
+    STK(inter, -1) = result;
+}
+
+MRSK_Value mrsk_vm_execute(MRSK_Interpreter *inter,
+                           MRSK_LocalEnvironment *env, Executable *exe)
+{
+    int *code = exe->code;
+    Constant *constant = exe->constant;
+    int base;
+    int pc;
+    int count;
+    MRSK_Value *dest;
+    MRSK_Value ret;
+    Executable *caller = inter->current_executable;
+
+    expand_stack(inter, exe->need_stack_size);
+    base = inter->stack.stack_pointer;
+    inter->current_executable = exe;
+
+    for (pc = 0; ; ) {
+        switch ((Opcode)code[pc]) {
+            case PUSH_INT_OP:
+                STK(inter, 0).type = MRSK_INT_VALUE;
+                STI(inter, 0) = code[pc+1];
+                inter->stack.stack_pointer++;
+                pc += 2;
+                break;
+            case PUSH_DOUBLE_OP:
+                STK(inter, 0).type = MRSK_DOUBLE_VALUE;
+                STD(inter, 0) = constant[code[pc+1]].u.double_value;
+                inter->stack.stack_pointer++;
+                pc += 2;
+                break;
+            case PUSH_BOOLEAN_OP:
+                STK(inter, 0).type = MRSK_BOOLEAN_VALUE;
+                STB(inter, 0) = (MRSK_Boolean)code[pc+1];
+                inter->stack.stack_pointer++;
+                pc += 2;
+                break;
+            case PUSH_STRING_OP:
+                STK(inter, 0).type = MRSK_STRING_VALUE;
+                STK(inter, 0).u.object = constant[code[pc+1]].u.string_object;
+                inter->stack.stack_pointer++;
+                pc += 2;
+                break;
+            case PUSH_NONE_OP:
+                STK(inter, 0).type = MRSK_NONE_VALUE;
+                inter->stack.stack_pointer++;
+                pc++;
+                break;
+            case PUSH_VARIABLE_OP:
+                push_variable(inter, env, exe, pc,
+                              constant[code[pc+1]].u.identifier);
+                pc += 2;
+                break;
+            case STORE_VARIABLE_OP:
+                dest = mrsk_get_identifier_lvalue(inter, env,
+                                                  constant[code[pc+1]]
+                                                  .u.identifier);
+                *dest = STK(inter, -1);
+                pc += 2;
+                break;
+            case PUSH_LOCAL_OP:
+                push_local(inter, env, exe, pc, code[pc+1]);
+                pc += 2;
+                break;
+            case STORE_LOCAL_OP:
+                env->frame[code[pc+1]] = STK(inter, -1);
+                pc += 2;
+                break;
+            case INCREMENT_LOCAL_OP:
+            case DECREMENT_LOCAL_OP:
+                inc_dec(exe, pc, &env->frame[code[pc+1]], &STK(inter, 0),
+                        code[pc] == INCREMENT_LOCAL_OP ? 1 : -1);
+                inter->stack.stack_pointer++;
+                pc += 2;
+                break;
+            case PUSH_ARRAY_ELEMENT_OP:
+                STK(inter, -2) = mrsk_get_array_element(inter,
+                                                        &STK(inter, -2),
+                                                        &STK(inter, -1),
+                                                        VM_LOCATION(pc));
+                inter->stack.stack_pointer--;
+                pc++;
+                break;
+            case PUSH_ARRAY_ELEMENT_N_OP:
+                count = code[pc+1];
+                STK(inter, -count-1)
+                    = mrsk_get_array_element_n(inter, &STK(inter, -count-1),
+                                               count, &STK(inter, -count),
+                                               VM_LOCATION(pc));
+                inter->stack.stack_pointer -= count;
+                pc += 2;
+                break;
+            case STORE_ARRAY_ELEMENT_OP:
+                mrsk_set_array_element(inter, &STK(inter, -2),
+                                       &STK(inter, -1),
+                                       &STK(inter, -3),
+                                       VM_LOCATION(pc));
+                inter->stack.stack_pointer -= 2;
+                pc++;
+                break;
+            case STORE_ARRAY_ELEMENT_N_OP:
+                count = code[pc+1];
+                mrsk_set_array_element_n(inter, &STK(inter, -count-1), count,
+                                         &STK(inter, -count),
+                                         &STK(inter, -count-2),
+                                         VM_LOCATION(pc));
+                inter->stack.stack_pointer -= count + 1;
+                pc += 2;
+                break;
+            case PUSH_GLOBAL_OP:
+                push_global(inter, exe, pc, code[pc+1]);
+                pc += 2;
+                break;
+            case STORE_GLOBAL_OP:
+                inter->global.variable[code[pc+1]]->value = STK(inter, -1);
+                pc += 2;
+                break;
+            case INCREMENT_GLOBAL_OP:
+            case DECREMENT_GLOBAL_OP:
+                inc_dec(exe, pc, &inter->global.variable[code[pc+1]]->value,
+                        &STK(inter, 0),
+                        code[pc] == INCREMENT_GLOBAL_OP ? 1 : -1);
+                inter->stack.stack_pointer++;
+                pc += 2;
+                break;
+            case INCREMENT_VARIABLE_OP:
+            case DECREMENT_VARIABLE_OP:
+                dest = mrsk_get_identifier_lvalue(inter, env,
+                                                  constant[code[pc+1]]
+                                                  .u.identifier);
+                inc_dec(exe, pc, dest, &STK(inter, 0),
+                        code[pc] == INCREMENT_VARIABLE_OP ? 1 : -1);
+                inter->stack.stack_pointer++;
+                pc += 2;
+                break;
+            case INCREMENT_ARRAY_ELEMENT_OP:
+            case DECREMENT_ARRAY_ELEMENT_OP:
+                STK(inter, -2)
+                    = mrsk_inc_dec_array_element(inter, &STK(inter, -2),
+                                                 &STK(inter, -1),
+                                                 code[pc]
+                                                 == INCREMENT_ARRAY_ELEMENT_OP
+                                                 ? 1 : -1,
+                                                 VM_LOCATION(pc));
+                inter->stack.stack_pointer--;
+                pc++;
+                break;
+            case INCREMENT_ARRAY_ELEMENT_N_OP:
+            case DECREMENT_ARRAY_ELEMENT_N_OP:
+                count = code[pc+1];
+                STK(inter, -count-1)
+                    = mrsk_inc_dec_array_element_n(inter,
+                                                   &STK(inter, -count-1),
+                                                   count, &STK(inter, -count),
+                                                   code[pc]
+                                                   == INCREMENT_ARRAY_ELEMENT_N_OP
+                                                   ? 1 : -1,
+                                                   VM_LOCATION(pc));
+                inter->stack.stack_pointer -= count;
+                pc += 2;
+                break;
+            case PUSH_FIELD_OP:
+                STK(inter, -1) = *get_field(exe, pc, &STK(inter, -1));
+                pc += 3;
+                break;
+            case STORE_FIELD_OP:
+                dest = get_field(exe, pc, &STK(inter, -1));
+                mrsk_write_barrier(inter, STK(inter, -1).u.object, dest,
+                                   &STK(inter, -2));
+                *dest = STK(inter, -2);
+                inter->stack.stack_pointer--;
+                pc += 3;
+                break;
+            case INCREMENT_FIELD_OP:
+            case DECREMENT_FIELD_OP:
+                inc_dec(exe, pc, get_field(exe, pc, &STK(inter, -1)),
+                        &STK(inter, -1),
+                        code[pc] == INCREMENT_FIELD_OP ? 1 : -1);
+                pc += 3;
+                break;
+            case ADD_OP:
+                if (STK(inter, -2).type == MRSK_INT_VALUE
+                    && STK(inter, -1).type == MRSK_INT_VALUE) {
+                    STI(inter, -2) += STI(inter, -1);
+                    inter->stack.stack_pointer--;
+                } else {
+                    binary_operation(inter, pc, ADD_EXPRESSION);
+                }
+                pc++;
+                break;
+            case SUB_OP:
+                if (STK(inter, -2).type == MRSK_INT_VALUE
+                    && STK(inter, -1).type == MRSK_INT_VALUE) {
+                    STI(inter, -2) -= STI(inter, -1);
+                    inter->stack.stack_pointer--;
+                } else {
+                    binary_operation(inter, pc, SUB_EXPRESSION);
+                }
+                pc++;
+                break;
+            case MUL_OP:
+                if (STK(inter, -2).type == MRSK_INT_VALUE
+                    && STK(inter, -1).type == MRSK_INT_VALUE) {
+                    STI(inter, -2) *= STI(inter, -1);
+                    inter->stack.stack_pointer--;
+                } else {
+                    binary_operation(inter, pc, MUL_EXPRESSION);
+                }
+                pc++;
+                break;
+            case DIV_OP:
+                binary_operation(inter, pc, DIV_EXPRESSION);
+                pc++;
+                break;
+            case MOD_OP:
+                binary_operation(inter, pc, MOD_EXPRESSION);
+                pc++;
+                break;
+            case EQ_OP:
+                binary_operation(inter, pc, EQ_EXPRESSION);
+                pc++;
+                break;
+            case NE_OP:
+                binary_operation(inter, pc, NE_EXPRESSION);
+                pc++;
+                break;
+            case GT_OP:
+                binary_operation(inter, pc, GT_EXPRESSION);
+                pc++;
+                break;
+            case GE_OP:
+                binary_operation(inter, pc, GE_EXPRESSION);
+                pc++;
+                break;
+            case LT_OP:
+                if (STK(inter, -2).type == MRSK_INT_VALUE
+                    && STK(inter, -1).type == MRSK_INT_VALUE) {
+                    STK(inter, -2).type = MRSK_BOOLEAN_VALUE;
+                    STB(inter, -2) = STI(inter, -2) < STI(inter, -1);
+                    inter->stack.stack_pointer--;
+                } else {
+                    binary_operation(inter, pc, LT_EXPRESSION);
+                }
+                pc++;
+                break;
+            case LE_OP:
+                binary_operation(inter, pc, LE_EXPRESSION);
+                pc++;
+                break;
+            case MINUS_OP:
+                if (STK(inter, -1).type == MRSK_INT_VALUE) {
+                    STI(inter, -1) = -STI(inter, -1);
+                } else if (STK(inter, -1).type == MRSK_DOUBLE_VALUE) {
+                    STD(inter, -1) = -STD(inter, -1);
+                } else {
+                    mrsk_runtime_error(get_line_number(exe, pc),
+                                       MINUS_OPERAND_TYPE_ERR,
+                                       MESSAGE_ARGUMENT_END);
+                }
+                pc++;
+                break;
+            case LOGICAL_AND_OP:
+                check_boolean(exe, pc, &STK(inter, -1));
+                if (!STB(inter, -1)) {
+                    pc = code[pc+1];
+                } else {
+                    inter->stack.stack_pointer--;
+                    pc += 2;
+                }
+                break;
+            case LOGICAL_OR_OP:
+                check_boolean(exe, pc, &STK(inter, -1));
+                if (STB(inter, -1)) {
+                    pc = code[pc+1];
+                } else {
+                    inter->stack.stack_pointer--;
+                    pc += 2;
+                }
+                break;
+            case CREATE_ARRAY_OP:
+                create_array(inter, code[pc+1]);
+                pc += 2;
+                break;
+            case CALL_OP:
+                call_function(inter, pc,
+                              constant[code[pc+1]].u.function_call,
+                              code[pc+2]);
+                pc += 3;
+                break;
+            case METHOD_CALL_OP:
+                invoke_method(inter, exe, pc, code[pc+1], code[pc+2]);
+                pc += 3;
+                break;
+            case POP_OP:
+                inter->stack.stack_pointer--;
+                pc++;
+                break;
+            case JUMP_OP:
+                pc = code[pc+1];
+                break;
+            case JUMP_IF_FALSE_OP:
+                check_boolean(exe, pc, &STK(inter, -1));
+                inter->stack.stack_pointer--;
+                if (!STB(inter, 0)) {
+                    pc = code[pc+1];
+                } else {
+                    pc += 2;
+                }
+                break;
+            case GLOBAL_OP:
+                mrsk_declare_global_variable(inter, env,
+                                             constant[code[pc+1]]
+                                             .u.identifier_list,
+                                             VM_LOCATION(pc));
+                pc += 2;
+                break;
+            case RETURN_OP:
+                ret = STK(inter, -1);
+                inter->stack.stack_pointer = base;
+                inter->current_executable = caller;
+                return ret;
+            case NOT_LVALUE_OP:
+                mrsk_runtime_error(get_line_number(exe, pc), NOT_LVALUE_ERR,
+                                   MESSAGE_ARGUMENT_END);
+                break;
+            case OPCODE_COUNT_PLUS_1:
+            default:
+                DBG_panic(("bad opcode..%d\n", code[pc]));
+        }
+    }
+}